@@ -0,0 +1,128 @@
+/**
+ * @file log_binary.h
+ * @brief 二进制日志编解码头文件
+ *
+ * 定义了延迟格式化（二进制）日志的编码和解码接口。生产者只记录调用点编号、时间戳
+ * 和原始参数，格式化工作推迟到离线解码时完成。
+ *
+ * 文件由若干条目组成，每个条目以一个标记字节开头，整数均为变长编码：
+ *   'B' "LOG" 版本号              文件头，解码器遇到时重置调用点表
+ *   'S' 编号 级别 行号 文件 函数 格式  调用点定义，在该调用点的第一条记录之前写出
+ *   'R' 编号 时间戳 参数长度 参数     一条日志记录
+ *   'T' 级别 时间戳 文件 行号 函数 内容 已格式化的文本记录（无法延迟格式化时使用）
+ */
+ 
+ #ifndef _LOG_BINARY_H_
+ #define _LOG_BINARY_H_
+ 
+ #include <stdio.h>
+ #include <stdarg.h>
+ #include <stddef.h>
+ 
+ /* 二进制日志格式版本 */
+ #define LOG_BINARY_VERSION 1
+ 
+ /**
+  * @brief 编译格式字符串，得到各参数的类型
+  *
+  * @param fmt printf风格的格式字符串
+  * @param types 输出参数，各参数的类型编码
+  * @param max_types types数组容量
+  * 带精度的字符串（%.3s、%.*s）只读取精度个字节，不要求以'\0'结尾。
+  * 常数精度以变长整数紧跟在字符串类型之后，也占用 types 的空间
+  *
+  * @return types 中使用的字节数；格式字符串包含不支持的转换（如 %n、%ls）时返回-1
+  */
+ int log_binary_compile(const char *fmt, unsigned char *types, size_t max_types);
+ 
+ /**
+  * @brief 写出文件头
+  *
+  * @param out 输出缓冲区，至少5个字节
+  * @return 写出的字节数
+  */
+ size_t log_binary_encode_header(unsigned char *out);
+ 
+ /**
+  * @brief 编码调用点定义
+  *
+  * @param out 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @param id 调用点编号
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param fmt 格式字符串
+  * @return 写出的字节数，缓冲区不足时返回0
+  */
+ size_t log_binary_encode_site(unsigned char *out, size_t cap, unsigned int id, int level,
+                               const char *file, int line, const char *func, const char *fmt);
+ 
+ /**
+  * @brief 编码一条日志记录，按类型直接从参数列表中取出原始参数
+  *
+  * 字符串参数过长时会被截断，保证记录不超过缓冲区容量
+  *
+  * @param out 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @param id 调用点编号
+  * @param timestamp_us 时间戳（微秒）
+  * @param types log_binary_compile 得到的参数类型
+  * @param ntypes log_binary_compile 的返回值
+  * @param args 参数列表
+  * @return 写出的字节数，缓冲区不足时返回0
+  */
+ size_t log_binary_encode_record(unsigned char *out, size_t cap, unsigned int id,
+                                 unsigned long long timestamp_us,
+                                 const unsigned char *types, int ntypes, va_list args);
+ 
+ /**
+  * @brief 编码一条已格式化的文本记录
+  *
+  * @param out 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @param level 日志级别
+  * @param timestamp_us 时间戳（微秒）
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param msg 日志内容
+  * @param msg_len 日志内容长度
+  * @return 写出的字节数，缓冲区不足时返回0
+  */
+ size_t log_binary_encode_text(unsigned char *out, size_t cap, int level,
+                               unsigned long long timestamp_us, const char *file, int line,
+                               const char *func, const char *msg, size_t msg_len);
+ 
+ /**
+  * 二进制日志解码器（不透明类型）
+  */
+ typedef struct log_binary_decoder log_binary_decoder_t;
+ 
+ /**
+  * @brief 创建解码器
+  *
+  * @param in 二进制日志输入流
+  * @return 成功返回解码器指针，失败返回NULL
+  */
+ log_binary_decoder_t *log_binary_decoder_open(FILE *in);
+ 
+ /**
+  * @brief 解码下一条日志，还原为文本格式
+  *
+  * @param dec 解码器
+  * @param line 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @return 文本长度；读到文件末尾返回0；数据损坏返回-1
+  */
+ int log_binary_decode_next(log_binary_decoder_t *dec, char *line, size_t cap);
+ 
+ /**
+  * @brief 销毁解码器（不关闭输入流）
+  *
+  * @param dec 解码器
+  */
+ void log_binary_decoder_close(log_binary_decoder_t *dec);
+ 
+ #endif /* _LOG_BINARY_H_ */
\ No newline at end of file
@@ -0,0 +1,39 @@
+/**
+ * @file log_clock.h
+ * @brief 日志时间戳头文件
+ *
+ * 定义了日志系统使用的时钟和时间戳格式化接口。时间取自粗粒度单调时钟加上
+ * 与墙上时间的偏移量，格式化结果按秒缓存，同一秒内只需填写毫秒部分
+ */
+ 
+ #ifndef _LOG_CLOCK_H_
+ #define _LOG_CLOCK_H_
+ 
+ #include <stddef.h>
+ #include <time.h>
+ 
+ /* 格式化后时间戳的长度："YYYY-MM-DD HH:MM:SS.mmm" */
+ #define LOG_CLOCK_TEXT_LEN 23
+ 
+ /**
+  * @brief 获取当前墙上时间
+  *
+  * 基于 CLOCK_MONOTONIC_COARSE 加偏移量，偏移量每秒与 CLOCK_REALTIME 校准一次，
+  * 精度为内核时钟节拍（通常1~4毫秒）
+  *
+  * @param ts 输出参数，当前时间
+  */
+ void log_clock_now(struct timespec *ts);
+ 
+ /**
+  * @brief 将时间格式化为 "YYYY-MM-DD HH:MM:SS.mmm"
+  *
+  * 每个线程缓存最近一秒的格式化结果，秒数不变时只填写毫秒
+  *
+  * @param ts 时间
+  * @param out 输出缓冲区，至少 LOG_CLOCK_TEXT_LEN + 1 字节
+  * @return 写出的长度（不含结尾的'\0'）
+  */
+ size_t log_clock_format(const struct timespec *ts, char *out);
+ 
+ #endif /* _LOG_CLOCK_H_ */
\ No newline at end of file
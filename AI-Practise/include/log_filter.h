@@ -2,13 +2,16 @@
  * @file log_filter.h
  * @brief 日志过滤功能头文件
  * 
- * 定义了日志过滤系统的接口，用于处理日志重复打印和海量日志过滤
+ * 定义了日志过滤系统的接口，用于处理日志重复打印和海量日志过滤。
+ * 检查接口可以被多个线程同时调用；初始化和销毁不能与检查并发进行
  */
-
+ 
  #ifndef _LOG_FILTER_H_
  #define _LOG_FILTER_H_
  
  #include <stdbool.h>
+ #include <stddef.h>
+ #include <stdint.h>
  #include <time.h>
  
  /**
@@ -18,11 +21,83 @@
   */
  int filter_init(void);
  
+ /**
+  * @brief 初始化日志过滤器，可选择只保存日志指纹
+  * 
+  * 记录总是以日志内容的64位哈希值（指纹）为键；不保存内容时每条记录只占几十字节，
+  * 但两条不同日志的指纹和长度都相同时会被当作同一条（概率约为 n^2/2^65）
+  * 
+  * @param store_content 是否保存日志内容，用于校验哈希冲突
+  * @return 成功返回0，失败返回-1
+  */
+ int filter_init_ex(bool store_content);
+ 
  /**
   * @brief 销毁日志过滤器，释放资源
   */
  void filter_destroy(void);
  
+ /**
+  * @brief 立即删除在 now 时刻已经过期的记录
+  * 
+  * 记录在1小时窗口和最近一分钟计数都结束后过期。检查日志时已经会顺带清理少量过期记录，
+  * 此接口用于空闲时一次清理完
+  * 
+  * @param now 当前时间
+  */
+ void filter_expire(time_t now);
+ 
+ /**
+  * @brief 汇总回调，每条在上次汇总之后被过滤过的记录调用一次
+  * 
+  * @param tag 附加键
+  * @param content 日志内容（超过256字节时被截断，不以'\0'结尾），只保存指纹时为NULL
+  * @param content_len 日志内容长度
+  * @param fingerprint 日志的64位指纹
+  * @param count 上次汇总以来被过滤的次数
+  * @param arg 调用者参数
+  */
+ typedef void (*filter_report_fn)(unsigned int tag, const char *content, size_t content_len,
+                                  uint64_t fingerprint, unsigned int count, void *arg);
+ 
+ /**
+  * @brief 汇总被过滤的日志：对每条上次汇总之后被过滤过的记录调用一次回调，并清零其计数
+  * 
+  * 回调在不持有过滤器锁的情况下调用，可以在回调中打印日志
+  * 
+  * @param report 回调函数
+  * @param arg 传给回调函数的参数
+  */
+ void filter_report_suppressed(filter_report_fn report, void *arg);
+ 
+ /**
+  * 过滤器统计（filter_get_stats 的快照）
+  */
+ typedef struct {
+     size_t records;                       /**< 记录数 */
+     size_t capacity;                      /**< 所有分片的槽位数 */
+     size_t max_probe;                     /**< 最长的探测序列（组数）；开放寻址没有链表，相当于最长链 */
+     size_t memory_bytes;                  /**< 哈希表、记录和保存的日志内容占用的内存（字节） */
+     unsigned long long filtered_duplicate; /**< 作为一小时内的重复日志被过滤的次数 */
+     unsigned long long filtered_massive;   /**< 作为海量日志被过滤的次数 */
+ } filter_stats_t;
+ 
+ /**
+  * @brief 获取过滤器统计，计数从初始化开始
+  * 
+  * 需要遍历整个哈希表，只用于监控，不要在打印日志的路径上调用
+  * 
+  * @param stats 输出参数，未初始化时全部为0
+  */
+ void filter_get_stats(filter_stats_t *stats);
+ 
+ /**
+  * @brief 获取过滤器中的记录数
+  * 
+  * @return 记录数，未初始化时返回0
+  */
+ size_t filter_record_count(void);
+ 
  /**
   * @brief 检查日志是否应该被过滤
   * 
@@ -48,4 +123,29 @@
   */
  bool filter_check_massive(const char *log_content, size_t log_len);
  
+ /**
+  * @brief 带附加键的日志过滤检查
+  * 
+  * 与 filter_check 相同，但过滤键为（tag，日志内容），例如以日志级别作为tag，
+  * 调用者无需再把两者拼接成一个字符串
+  * 
+  * @param tag 附加键，tag不同的相同内容视为不同日志
+  * @param log_content 日志内容
+  * @param log_len 日志内容长度
+  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  */
+ bool filter_check_ex(unsigned int tag, const char *log_content, size_t log_len);
+ 
+ /**
+  * @brief 带附加键的海量日志检查
+  * 
+  * 与 filter_check_massive 相同，但过滤键为（tag，日志内容）
+  * 
+  * @param tag 附加键，tag不同的相同内容视为不同日志
+  * @param log_content 日志内容
+  * @param log_len 日志内容长度
+  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  */
+ bool filter_check_massive_ex(unsigned int tag, const char *log_content, size_t log_len);
+ 
  #endif /* _LOG_FILTER_H_ */
\ No newline at end of file
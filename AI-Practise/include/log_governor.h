@@ -0,0 +1,53 @@
+/**
+ * @file log_governor.h
+ * @brief 日志流量控制头文件
+ *
+ * 定义了按字节数和条数限制日志写出速率的令牌桶接口。令牌桶用 GCRA 算法实现：
+ * 每个维度只有一个原子变量（理论到达时间），判断和扣除令牌是一次比较交换，不需要加锁
+ */
+ 
+ #ifndef _LOG_GOVERNOR_H_
+ #define _LOG_GOVERNOR_H_
+ 
+ #include <stddef.h>
+ #include <stdbool.h>
+ 
+ /**
+  * 日志流量控制器（不透明类型）
+  */
+ typedef struct log_governor log_governor_t;
+ 
+ /**
+  * @brief 创建流量控制器
+  *
+  * 令牌桶容量为 burst_ms 毫秒的预算，空闲一段时间后允许短时间的突发
+  *
+  * @param bytes_per_sec 每秒最多写出的字节数，0表示不限制
+  * @param records_per_sec 每秒最多写出的条数，0表示不限制
+  * @param burst_ms 令牌桶容量（毫秒）
+  * @return 成功返回指针，失败返回NULL
+  */
+ log_governor_t *log_governor_create(size_t bytes_per_sec, unsigned int records_per_sec,
+                                     unsigned int burst_ms);
+ 
+ /**
+  * @brief 判断一条日志是否可以写出，可以写出时扣除令牌（可多线程并发调用）
+  *
+  * 低优先级的日志需要为高优先级保留一部分令牌：reserve_pct 为保留的百分比，
+  * 令牌桶剩余量低于该比例时拒绝；reserve_pct 为负数时总是允许，但仍然扣除令牌
+  *
+  * @param gov 流量控制器
+  * @param bytes 日志字节数
+  * @param reserve_pct 需要保留的令牌百分比（0~99），负数表示总是允许
+  * @return 允许写出返回true
+  */
+ bool log_governor_admit(log_governor_t *gov, size_t bytes, int reserve_pct);
+ 
+ /**
+  * @brief 销毁流量控制器
+  *
+  * @param gov 流量控制器
+  */
+ void log_governor_destroy(log_governor_t *gov);
+ 
+ #endif /* _LOG_GOVERNOR_H_ */
@@ -0,0 +1,85 @@
+/**
+ * @file log_index.h
+ * @brief 日志文件时间索引头文件
+ *
+ * 以只读方式映射文本或 JSON 格式的日志文件，按固定间隔抽样建立稀疏的
+ * “时间戳 → 文件偏移”索引（抽样点数有上限，与文件大小无关，不需要扫描整个文件），
+ * 查询时先在索引中二分查找，再在两个抽样点之间按字节二分查找，只扫描时间范围内的日志
+ */
+ 
+ #ifndef _LOG_INDEX_H_
+ #define _LOG_INDEX_H_
+ 
+ #include <stddef.h>
+ #include "logger.h"
+ 
+ /* 允许的时间乱序（毫秒）：多线程写出时，时间戳较晚的日志可能先写入文件 */
+ #define LOG_INDEX_SKEW_MS 1000
+ 
+ /**
+  * 日志文件时间索引（不透明类型）
+  */
+ typedef struct log_index log_index_t;
+ 
+ /**
+  * 查询回调，每条匹配的日志调用一次
+  *
+  * @param line 日志内容（包括换行符，不以'\0'结尾）；多行日志的后续行也包含在内
+  * @param len 日志长度
+  * @param arg 调用者参数
+  */
+ typedef void (*log_index_fn)(const char *line, size_t len, void *arg);
+ 
+ /**
+  * @brief 解析 "YYYY-MM-DD HH:MM:SS[.mmm]" 格式的时间（日期和时间之间也可以是'T'）
+  *
+  * 与日志的时间戳一样按本地时间的字面值比较，不做时区换算
+  *
+  * @param text 时间字符串
+  * @param len 字符串长度
+  * @param ms 输出参数，从1970-01-01 00:00:00起的毫秒数
+  * @return 成功返回0，格式不正确返回-1
+  */
+ int log_index_parse_time(const char *text, size_t len, long long *ms);
+ 
+ /**
+  * @brief 映射日志文件并建立稀疏时间索引
+  *
+  * @param filename 文本或 JSON 格式的日志文件
+  * @return 成功返回索引指针，失败返回NULL
+  */
+ log_index_t *log_index_open(const char *filename);
+ 
+ /**
+  * @brief 解除映射并释放索引
+  *
+  * @param idx 索引
+  */
+ void log_index_close(log_index_t *idx);
+ 
+ /**
+  * @brief 获取索引的抽样点个数
+  *
+  * @param idx 索引
+  * @return 抽样点个数
+  */
+ size_t log_index_entries(const log_index_t *idx);
+ 
+ /**
+  * @brief 按时间范围和级别查询日志
+  *
+  * 从时间早于 from_ms - LOG_INDEX_SKEW_MS 的位置开始扫描，
+  * 遇到时间晚于 to_ms + LOG_INDEX_SKEW_MS 的日志时结束
+  *
+  * @param idx 索引
+  * @param from_ms 开始时间（包含）
+  * @param to_ms 结束时间（包含）
+  * @param min_level 最低日志级别，根据 "[LEVEL]" 标签（JSON 格式为 level 成员）判断
+  * @param fn 查询回调
+  * @param arg 传给回调的参数
+  * @return 匹配的日志条数
+  */
+ size_t log_index_query(const log_index_t *idx, long long from_ms, long long to_ms, log_level_t min_level,
+                        log_index_fn fn, void *arg);
+ 
+ #endif /* _LOG_INDEX_H_ */
@@ -0,0 +1,50 @@
+/**
+ * @file log_kv.h
+ * @brief 键值日志序列化头文件
+ *
+ * 把消息和键值字段按类型直接写成文本或 JSON，不经过 printf 格式化；
+ * 输出空间不足时截断，JSON 输出在截断时丢弃放不下的字段，保证仍是合法的 JSON
+ */
+ 
+ #ifndef _LOG_KV_H_
+ #define _LOG_KV_H_
+ 
+ #include <stddef.h>
+ #include "logger.h"
+ 
+ /**
+  * @brief 写出文本形式 "消息 key=value key=value"，不含换行符
+  *
+  * @param out 输出缓冲区
+  * @param cap 缓冲区大小，至少为1
+  * @param msg 消息
+  * @param fields 字段数组
+  * @param count 字段个数
+  * @return 写出的字节数（不含结尾的'\0'）
+  */
+ size_t log_kv_format_text(char *out, size_t cap, const char *msg,
+                           const log_field_t *fields, size_t count);
+ 
+ /**
+  * @brief 写出一行 JSON 对象，以换行符结束
+  *
+  * 成员依次为 time、level、file、line、func、msg，之后是各个字段
+  *
+  * @param out 输出缓冲区
+  * @param cap 缓冲区大小
+  * @param time_str 时间字符串
+  * @param level 级别名称
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param msg 消息
+  * @param msg_len 消息长度
+  * @param fields 字段数组
+  * @param count 字段个数
+  * @return 写出的字节数，缓冲区连固定成员都放不下时返回0
+  */
+ size_t log_kv_format_json(char *out, size_t cap, const char *time_str, const char *level,
+                           const char *file, int line, const char *func, const char *msg,
+                           size_t msg_len, const log_field_t *fields, size_t count);
+ 
+ #endif /* _LOG_KV_H_ */
@@ -0,0 +1,112 @@
+/**
+ * @file log_lz.h
+ * @brief 日志块压缩头文件
+ *
+ * 定义了不依赖外部库的 LZ 系列块压缩接口，用于压缩轮转后不再写入的日志文件，
+ * 并提供边读边解压的流式读取接口
+ *
+ * 压缩文件格式：4字节魔数 "LGZ1"，之后是若干个块，每块为
+ *   原始长度（4字节小端） 存储长度（4字节小端，最高位为1表示未压缩） 数据
+ */
+ 
+ #ifndef _LOG_LZ_H_
+ #define _LOG_LZ_H_
+ 
+ #include <stdio.h>
+ #include <stddef.h>
+ #include <stdbool.h>
+ 
+ /* 压缩文件的块大小（原始数据） */
+ #define LOG_LZ_BLOCK_SIZE (256 * 1024)
+ 
+ /* 压缩文件扩展名 */
+ #define LOG_LZ_SUFFIX ".lz"
+ 
+ /**
+  * @brief 计算压缩结果的最大长度
+  *
+  * @param len 原始数据长度
+  * @return 压缩结果的最大长度
+  */
+ size_t log_lz_bound(size_t len);
+ 
+ /**
+  * @brief 压缩一块数据
+  *
+  * @param src 原始数据
+  * @param len 原始数据长度
+  * @param dst 输出缓冲区
+  * @param cap 输出缓冲区容量，不小于 log_lz_bound(len) 时一定成功
+  * @return 压缩后的长度，缓冲区不足时返回0
+  */
+ size_t log_lz_compress(const void *src, size_t len, void *dst, size_t cap);
+ 
+ /**
+  * @brief 解压一块数据
+  *
+  * @param src 压缩数据
+  * @param len 压缩数据长度
+  * @param dst 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @return 解压后的长度，数据损坏或缓冲区不足时返回-1
+  */
+ long log_lz_decompress(const void *src, size_t len, void *dst, size_t cap);
+ 
+ /**
+  * @brief 把一个文件压缩为压缩文件格式
+  *
+  * @param src_path 原始文件
+  * @param dst_path 压缩文件
+  * @return 成功返回0，失败返回-1（失败时删除不完整的压缩文件）
+  */
+ int log_lz_compress_file(const char *src_path, const char *dst_path);
+ 
+ /**
+  * @brief 检查输入流是否为压缩文件（读取后恢复读取位置）
+  *
+  * @param in 输入流
+  * @return 是压缩文件返回true
+  */
+ bool log_lz_detect(FILE *in);
+ 
+ /**
+  * 流式解压读取器（不透明类型）
+  */
+ typedef struct log_lz_reader log_lz_reader_t;
+ 
+ /**
+  * @brief 创建流式读取器，校验魔数
+  *
+  * @param in 压缩文件输入流，关闭读取器时不会关闭
+  * @return 成功返回读取器指针，失败返回NULL
+  */
+ log_lz_reader_t *log_lz_reader_open(FILE *in);
+ 
+ /**
+  * @brief 读取解压后的数据，每次最多解压一个块
+  *
+  * @param reader 读取器
+  * @param buf 输出缓冲区
+  * @param len 最多读取的字节数
+  * @return 读取的字节数；读到文件末尾返回0；数据损坏返回-1
+  */
+ long log_lz_read(log_lz_reader_t *reader, void *buf, size_t len);
+ 
+ /**
+  * @brief 销毁读取器（不关闭输入流）
+  *
+  * @param reader 读取器
+  */
+ void log_lz_reader_close(log_lz_reader_t *reader);
+ 
+ /**
+  * @brief 以只读方式打开压缩文件，返回的FILE读出的是解压后的数据
+  *
+  * 可以直接交给只接受FILE的代码使用（如二进制日志解码器）
+  *
+  * @param path 压缩文件
+  * @return 成功返回FILE指针，失败返回NULL；用 fclose 关闭
+  */
+ FILE *log_lz_fopen(const char *path);
+ 
+ #endif /* _LOG_LZ_H_ */
@@ -0,0 +1,50 @@
+/**
+ * @file log_mmap.h
+ * @brief 内存映射日志文件头文件
+ *
+ * 定义了基于内存映射的日志文件写出接口。文件按段预分配并映射到内存，写入者用原子操作
+ * 预留写入位置后直接把日志复制到映射区域，稳定状态下写日志不需要任何系统调用
+ */
+ 
+ #ifndef _LOG_MMAP_H_
+ #define _LOG_MMAP_H_
+ 
+ #include <stddef.h>
+ 
+ /**
+  * 内存映射日志文件（不透明类型）
+  */
+ typedef struct log_mmap log_mmap_t;
+ 
+ /**
+  * @brief 打开日志文件，新日志追加在已有内容之后
+  *
+  * @param filename 日志文件名
+  * @param segment_size 每次预分配并映射的段大小，向上取整为页大小的整数倍
+  * @return 成功返回指针，失败返回NULL
+  */
+ log_mmap_t *log_mmap_open(const char *filename, size_t segment_size);
+ 
+ /**
+  * @brief 写入一段数据（可多线程并发调用）
+  *
+  * 进入新段时需要预分配并映射，由越过上一段中点的写入者提前完成。
+  * 映射失败时未写入的部分填为空格并以换行符结束
+  *
+  * @param map 内存映射日志文件
+  * @param data 数据
+  * @param len 数据长度
+  * @return 成功返回0，失败返回-1
+  */
+ int log_mmap_write(log_mmap_t *map, const void *data, size_t len);
+ 
+ /**
+  * @brief 解除映射，把文件截断为实际写入的长度并关闭
+  *
+  * 调用时不能再有其他线程写入
+  *
+  * @param map 内存映射日志文件
+  */
+ void log_mmap_close(log_mmap_t *map);
+ 
+ #endif /* _LOG_MMAP_H_ */
@@ -0,0 +1,88 @@
+/**
+ * @file log_output.h
+ * @brief 日志批量输出头文件
+ *
+ * 定义了日志输出缓冲接口。待写出的日志先追加到缓冲区中，刷新时整批通过一次
+ * writev 写出，把“每条日志一到两次系统调用”降低为“每批一次系统调用”
+ */
+ 
+ #ifndef _LOG_OUTPUT_H_
+ #define _LOG_OUTPUT_H_
+ 
+ #include <stddef.h>
+ 
+ /**
+  * 输出缓冲（不透明类型），非线程安全，需由调用者加锁或保证只有一个线程使用
+  */
+ typedef struct log_output log_output_t;
+ 
+ /**
+  * @brief 创建输出缓冲
+  *
+  * @param fd 输出的文件描述符，销毁时不会关闭
+  * @param capacity 缓冲区大小（字节），待写数据超过此大小时自动刷新
+  * @return 成功返回输出缓冲指针，失败返回NULL
+  */
+ log_output_t *log_output_create(int fd, size_t capacity);
+ 
+ /**
+  * @brief 刷新剩余数据并销毁输出缓冲（不关闭文件描述符）
+  *
+  * @param out 输出缓冲
+  */
+ void log_output_destroy(log_output_t *out);
+ 
+ /**
+  * @brief 追加一段数据，数据会被复制到缓冲区中
+  *
+  * @param out 输出缓冲
+  * @param data 数据
+  * @param len 数据长度
+  * @return 成功返回0，自动刷新失败时返回-1
+  */
+ int log_output_append(log_output_t *out, const void *data, size_t len);
+ 
+ /**
+  * @brief 追加一段常量数据，只记录地址不复制（如终端颜色代码）
+  *
+  * @param out 输出缓冲
+  * @param data 数据，在下次刷新之前必须保持有效
+  * @param len 数据长度
+  * @return 成功返回0，自动刷新失败时返回-1
+  */
+ int log_output_append_static(log_output_t *out, const void *data, size_t len);
+ 
+ /**
+  * @brief 更换输出的文件描述符，调用者需先写出待写数据
+  *
+  * @param out 输出缓冲
+  * @param fd 新的文件描述符
+  */
+ void log_output_set_fd(log_output_t *out, int fd);
+ 
+ /**
+  * @brief 获取尚未写出的字节数
+  *
+  * @param out 输出缓冲
+  * @return 待写字节数
+  */
+ size_t log_output_pending(const log_output_t *out);
+ 
+ /**
+  * @brief 在信号处理函数中写出待写数据
+  *
+  * 只调用 write，不加锁，也不修改输出缓冲的状态；与正常写出同时进行时可能重复一部分数据
+  *
+  * @param out 输出缓冲
+  */
+ void log_output_emergency_flush(const log_output_t *out);
+ 
+ /**
+  * @brief 用一次（数据很多时为少数几次）writev 写出所有待写数据
+  *
+  * @param out 输出缓冲
+  * @return 成功返回0，失败返回-1（未写出的数据被丢弃）
+  */
+ int log_output_flush(log_output_t *out);
+ 
+ #endif /* _LOG_OUTPUT_H_ */
@@ -0,0 +1,84 @@
+/**
+ * @file log_recorder.h
+ * @brief 日志飞行记录器头文件
+ *
+ * 每个线程一个定长的环形缓冲，保存最近的若干条未格式化日志（调用点信息、时间戳和
+ * 按二进制日志格式编码的原始参数）。只有在需要时才转储，转储时才还原成文本
+ */
+ 
+ #ifndef _LOG_RECORDER_H_
+ #define _LOG_RECORDER_H_
+ 
+ #include <stddef.h>
+ #include <stdarg.h>
+ 
+ /**
+  * 飞行记录器（不透明类型）
+  */
+ typedef struct log_recorder log_recorder_t;
+ 
+ /**
+  * 转储回调，每条日志调用一次
+  *
+  * @param level 日志级别
+  * @param line 还原出的文本（与文本日志格式相同，以换行符结束）
+  * @param len 文本长度
+  * @param arg 调用者参数
+  */
+ typedef void (*log_recorder_emit_fn)(int level, const char *line, size_t len, void *arg);
+ 
+ /**
+  * @brief 获取调用线程的记录器，不存在或大小不同时重新创建
+  *
+  * 记录器按每条256字节划分槽位，在线程退出时销毁
+  *
+  * @param capacity 记录器的字节数
+  * @return 成功返回记录器指针，capacity为0或失败时返回NULL
+  */
+ log_recorder_t *log_recorder_thread(size_t capacity);
+ 
+ /**
+  * @brief 记录一条日志，缓冲区已满时覆盖最早的一条（只由所属线程调用）
+  *
+  * file 和 func 只保存指针，必须在转储之前一直有效（例如 __FILE__、__func__）；
+  * fmt 复制到槽位中，太长时只记录占位格式。字符串参数过长时被截断
+  *
+  * @param rec 记录器
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param fmt 格式字符串
+  * @param types log_binary_compile 得到的参数类型
+  * @param ntypes 参数个数
+  * @param args 参数列表
+  * @return 成功返回0，失败返回-1
+  */
+ int log_recorder_append(log_recorder_t *rec, int level, const char *file, int line, const char *func,
+                         const char *fmt, const unsigned char *types, int ntypes, va_list args);
+ 
+ /**
+  * @brief 按时间顺序还原并转储记录器中的日志，之后清空记录器
+  *
+  * @param rec 记录器
+  * @param emit 转储回调
+  * @param arg 传给回调的参数
+  * @return 转储的条数
+  */
+ size_t log_recorder_dump(log_recorder_t *rec, log_recorder_emit_fn emit, void *arg);
+ 
+ /**
+  * @brief 转储所有线程的记录器
+  *
+  * @param emit 转储回调
+  * @param arg 传给回调的参数
+  * @return 转储的条数
+  */
+ size_t log_recorder_dump_all(log_recorder_emit_fn emit, void *arg);
+ 
+ /**
+  * @brief 清空所有线程的记录器
+  */
+ void log_recorder_reset_all(void);
+ 
+ #endif /* _LOG_RECORDER_H_ */
@@ -0,0 +1,95 @@
+/**
+ * @file log_ring.h
+ * @brief 有界无锁多生产者单消费者环形队列头文件
+ *
+ * 定义了异步日志使用的环形队列接口。生产者先预留槽位，在槽位内直接写入数据后提交；
+ * 唯一的消费者按顺序读取已提交的槽位并在处理完后释放
+ */
+ 
+ #ifndef _LOG_RING_H_
+ #define _LOG_RING_H_
+ 
+ #include <stddef.h>
+ #include <stdbool.h>
+ 
+ /**
+  * 环形队列（不透明类型）
+  */
+ typedef struct log_ring log_ring_t;
+ 
+ /**
+  * @brief 创建环形队列
+  *
+  * @param capacity 槽位数量，向上取整为2的幂
+  * @param slot_size 每个槽位可用的字节数
+  * @return 成功返回队列指针，失败返回NULL
+  */
+ log_ring_t *log_ring_create(size_t capacity, size_t slot_size);
+ 
+ /**
+  * @brief 销毁环形队列，释放资源
+  *
+  * @param ring 环形队列
+  */
+ void log_ring_destroy(log_ring_t *ring);
+ 
+ /**
+  * @brief 生产者预留一个槽位（可多线程并发调用）
+  *
+  * @param ring 环形队列
+  * @param ticket 输出参数，提交时需要传回的票据
+  * @return 槽位数据区指针，队列已满时返回NULL
+  */
+ void *log_ring_reserve(log_ring_t *ring, size_t *ticket);
+ 
+ /**
+  * @brief 生产者提交已写好的槽位，使其对消费者可见
+  *
+  * @param ring 环形队列
+  * @param ticket log_ring_reserve 返回的票据
+  */
+ void log_ring_commit(log_ring_t *ring, size_t ticket);
+ 
+ /**
+  * @brief 消费者查看下一个已提交的槽位（仅限单个消费者线程调用）
+  *
+  * @param ring 环形队列
+  * @return 槽位数据区指针，没有已提交的槽位时返回NULL
+  */
+ void *log_ring_peek(log_ring_t *ring);
+ 
+ /**
+  * @brief 消费者释放 log_ring_peek 返回的槽位，使其可被生产者复用
+  *
+  * @param ring 环形队列
+  */
+ void log_ring_release(log_ring_t *ring);
+ 
+ /**
+  * @brief 查看从读位置起第 index 个已提交的槽位，不释放（仅用于崩溃时的紧急写出）
+  *
+  * 只读取原子变量，可以在信号处理函数中调用；之前的槽位未提交时也返回NULL
+  *
+  * @param ring 环形队列
+  * @param index 从读位置起的序号
+  * @return 槽位数据区指针，该槽位未提交时返回NULL
+  */
+ void *log_ring_peek_at(log_ring_t *ring, size_t index);
+ 
+ /**
+  * @brief 判断队列中是否没有已提交的槽位
+  *
+  * @param ring 环形队列
+  * @return true 表示为空
+  */
+ bool log_ring_empty(log_ring_t *ring);
+ 
+ /**
+  * @brief 获取槽位可用字节数
+  *
+  * @param ring 环形队列
+  * @return 槽位字节数
+  */
+ size_t log_ring_slot_size(const log_ring_t *ring);
+ 
+ #endif /* _LOG_RING_H_ */
\ No newline at end of file
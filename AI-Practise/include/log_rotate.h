@@ -0,0 +1,69 @@
+/**
+ * @file log_rotate.h
+ * @brief 日志文件轮转头文件
+ *
+ * 定义了按大小和按时间轮转日志文件的接口。下一个日志文件由后台线程提前打开，
+ * 写入者切换文件时只需交换文件描述符，改名、删除旧文件和打开文件都在后台线程完成
+ */
+ 
+ #ifndef _LOG_ROTATE_H_
+ #define _LOG_ROTATE_H_
+ 
+ #include <stddef.h>
+ #include <stdbool.h>
+ 
+ /**
+  * 日志轮转器（不透明类型）
+  */
+ typedef struct log_rotate log_rotate_t;
+ 
+ /**
+  * @brief 创建轮转器并启动后台线程
+  *
+  * 轮转后的文件依次命名为 filename.1（最新）到 filename.keep，更早的文件被删除；
+  * 开启压缩时历史文件由后台线程压缩，命名为 filename.N.lz
+  *
+  * @param filename 日志文件名
+  * @param fd 当前日志文件的描述符，用于获取已有内容的大小
+  * @param max_size 单个文件的最大字节数，0表示不按大小轮转
+  * @param interval_sec 按墙上时间轮转的间隔（秒），对齐到间隔的整数倍，0表示不按时间轮转
+  * @param keep 保留的历史文件个数
+  * @param compress 是否压缩历史文件
+  * @return 成功返回轮转器指针，失败返回NULL
+  */
+ log_rotate_t *log_rotate_start(const char *filename, int fd, size_t max_size,
+                                unsigned int interval_sec, unsigned int keep, bool compress);
+ 
+ /**
+  * @brief 写入 len 字节之前检查是否需要切换文件
+  *
+  * 只有在需要轮转并且下一个文件已经打开时才返回true，不会阻塞；
+  * 同一时刻只能有一个线程调用（与写出日志文件的线程相同）
+  *
+  * @param rot 轮转器
+  * @param len 即将写入的字节数
+  * @return 需要切换返回true，此时应先写出缓冲的数据再调用 log_rotate_switch
+  */
+ bool log_rotate_due(log_rotate_t *rot, size_t len);
+ 
+ /**
+  * @brief 切换到预先打开的下一个文件
+  *
+  * 旧文件交给后台线程关闭和改名，调用者不再使用旧的文件描述符
+  *
+  * @param rot 轮转器
+  * @param old_fd 当前日志文件的描述符
+  * @return 新的日志文件描述符
+  */
+ int log_rotate_switch(log_rotate_t *rot, int old_fd);
+ 
+ /**
+  * @brief 停止后台线程并销毁轮转器，完成尚未完成的改名并删除预先打开的文件
+  *
+  * 当前日志文件的描述符由调用者关闭
+  *
+  * @param rot 轮转器
+  */
+ void log_rotate_stop(log_rotate_t *rot);
+ 
+ #endif /* _LOG_ROTATE_H_ */
@@ -0,0 +1,136 @@
+/**
+ * @file log_sink.h
+ * @brief 日志输出目标（sink）头文件
+ *
+ * 每个 sink 有自己的有界队列、后台线程和级别阈值。一条日志只格式化一次，复制到一块
+ * 引用计数的共享记录中，各 sink 的队列只保存指向它的指针；某个 sink 的队列满时只丢弃
+ * 该 sink 的这条日志，不会阻塞调用者和其他 sink
+ */
+ 
+ #ifndef _LOG_SINK_H_
+ #define _LOG_SINK_H_
+ 
+ #include <stddef.h>
+ #include <stdbool.h>
+ #include "logger.h"
+ 
+ /**
+  * sink 的输出操作，均在该 sink 的后台线程中调用
+  */
+ typedef struct {
+     void (*write)(void *ctx, log_level_t level, const char *data, size_t len); /**< 写出一条日志 */
+     void (*flush)(void *ctx);   /**< 写完一批日志后调用，可以为NULL */
+     void (*close)(void *ctx);   /**< 销毁时调用，释放 ctx，可以为NULL */
+ } log_sink_ops_t;
+ 
+ /**
+  * @brief 创建 sink 并启动后台线程
+  *
+  * @param ops 输出操作
+  * @param ctx 传给输出操作的参数，创建失败时也会调用 ops->close 释放
+  * @param min_level 级别阈值，低于此级别的日志不进入该 sink
+  * @param queue_size 队列容量（条数），0表示使用默认值
+  * @return 成功返回 sink 指针，失败返回NULL
+  */
+ log_sink_t *log_sink_create(const log_sink_ops_t *ops, void *ctx, log_level_t min_level,
+                             size_t queue_size);
+ 
+ /**
+  * @brief 创建写到标准输出的 sink（带颜色）
+  *
+  * @param min_level 级别阈值
+  * @param queue_size 队列容量（条数），0表示使用默认值
+  * @return 成功返回 sink 指针，失败返回NULL
+  */
+ log_sink_t *log_sink_stdout(log_level_t min_level, size_t queue_size);
+ 
+ /**
+  * @brief 创建追加写到文件的 sink
+  *
+  * @param filename 文件名
+  * @param min_level 级别阈值
+  * @param queue_size 队列容量（条数），0表示使用默认值
+  * @return 成功返回 sink 指针，失败返回NULL
+  */
+ log_sink_t *log_sink_file(const char *filename, log_level_t min_level, size_t queue_size);
+ 
+ /**
+  * @brief 创建内存环形缓冲 sink，只保留最近 capacity 字节的日志
+  *
+  * @param capacity 缓冲区字节数
+  * @param min_level 级别阈值
+  * @return 成功返回 sink 指针，失败返回NULL
+  */
+ log_sink_t *log_sink_memory(size_t capacity, log_level_t min_level);
+ 
+ /**
+  * @brief 读取内存 sink 中保存的日志，按写入顺序复制
+  *
+  * cap 不够时只复制最近的部分，最早的一条日志可能只剩后半部分；
+  * 只对 log_sink_memory 创建的 sink 有效
+  *
+  * @param sink 内存 sink
+  * @param buf 输出缓冲区
+  * @param cap 缓冲区大小
+  * @return 复制的字节数
+  */
+ size_t log_sink_memory_read(log_sink_t *sink, char *buf, size_t cap);
+ 
+ /**
+  * @brief 创建发送到 Unix 数据报套接字的 sink，每条日志一个数据报
+  *
+  * 对端不存在或接收缓冲区满时丢弃日志
+  *
+  * @param path 套接字路径
+  * @param min_level 级别阈值
+  * @param queue_size 队列容量（条数），0表示使用默认值
+  * @return 成功返回 sink 指针，失败返回NULL
+  */
+ log_sink_t *log_sink_unix(const char *path, log_level_t min_level, size_t queue_size);
+ 
+ /**
+  * @brief 把一条日志分发给多个 sink（可多线程并发调用）
+  *
+  * 数据只复制一次；级别低于阈值或队列已满的 sink 不引用这条日志
+  *
+  * @param sinks sink 数组
+  * @param count sink 个数
+  * @param level 日志级别
+  * @param data 格式化完成的日志
+  * @param len 日志长度
+  */
+ void log_sink_dispatch(log_sink_t *const *sinks, size_t count, log_level_t level,
+                        const char *data, size_t len);
+ 
+ /**
+  * @brief 等待 sink 写完已进入队列的日志
+  *
+  * @param sink sink
+  */
+ void log_sink_flush(log_sink_t *sink);
+ 
+ /**
+  * @brief 崩溃时直接写出 sink 缓冲和队列中的日志（异步信号安全，不加锁、不分配内存）
+  *
+  * 只对 log_sink_stdout 和 log_sink_file 创建的 sink 有效，其他 sink 不做任何事
+  *
+  * @param sink sink
+  */
+ void log_sink_emergency_flush(log_sink_t *sink);
+ 
+ /**
+  * @brief 获取因队列已满被 sink 丢弃的日志条数
+  *
+  * @param sink sink
+  * @return 丢弃的条数
+  */
+ unsigned long long log_sink_dropped(log_sink_t *sink);
+ 
+ /**
+  * @brief 写完队列中的日志后停止后台线程并销毁 sink
+  *
+  * @param sink sink
+  */
+ void log_sink_destroy(log_sink_t *sink);
+ 
+ #endif /* _LOG_SINK_H_ */
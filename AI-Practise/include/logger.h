@@ -4,13 +4,14 @@
  * 
  * 定义了日志系统的接口，包括日志级别、初始化、销毁和日志打印函数
  */
-
+ 
  #ifndef _LOGGER_H_
  #define _LOGGER_H_
  
  #include <stdio.h>
  #include <stdarg.h>
  #include <stdbool.h>
+ #include <string.h>
  
  /**
   * 日志级别枚举
@@ -28,9 +29,149 @@
   */
  typedef enum {
      LOG_MODE_NORMAL = 0,  /**< 普通打印模式 */
-     LOG_MODE_FILTER       /**< 过滤打印模式 */
+     LOG_MODE_FILTER,      /**< 过滤打印模式 */
+     LOG_MODE_CALLSITE     /**< 按调用点过滤模式：LOG_* 宏的调用点1分钟内调用>=60次时，接下来1小时内
+                                在格式化之前直接丢弃；不经过调用点的 log_print 按普通模式处理 */
  } log_mode_t;
  
+ /**
+  * 日志输出格式
+  */
+ typedef enum {
+     LOG_FORMAT_TEXT = 0,  /**< 文本格式 */
+     LOG_FORMAT_BINARY,    /**< 二进制格式：延迟格式化，只写入日志文件且不按内容过滤，需用 log_decode 工具还原 */
+     LOG_FORMAT_JSON       /**< JSON Lines 格式：每条日志为一行 JSON 对象，键值字段作为对象的成员 */
+ } log_format_t;
+ 
+ /**
+  * 日志刷新策略，可按位组合；待写数据在满足任一条件时整批写出
+  */
+ typedef enum {
+     LOG_FLUSH_DEFAULT = 0,         /**< 默认：二进制格式为 LOG_FLUSH_BYTES | LOG_FLUSH_ON_ERROR，
+                                         其他格式为 LOG_FLUSH_RECORD */
+     LOG_FLUSH_BYTES = 1 << 0,      /**< 待写数据达到 flush_bytes 字节时写出 */
+     LOG_FLUSH_INTERVAL = 1 << 1,   /**< 距上次写出超过 flush_interval_ms 毫秒时写出 */
+     LOG_FLUSH_ON_ERROR = 1 << 2,   /**< 遇到 ERROR 及以上级别的日志时立即写出 */
+     LOG_FLUSH_RECORD = 1 << 3      /**< 每条日志立即写出，与其他条件组合时其他条件不起作用 */
+ } log_flush_policy_t;
+ 
+ /**
+  * 日志系统可选配置，所有字段为0时即为默认行为
+  */
+ typedef struct {
+     bool async;                 /**< 异步模式：调用者只格式化并入队，由后台线程负责写出 */
+     size_t async_queue_size;    /**< 异步队列容量（条数），0表示使用默认值 */
+     log_format_t format;        /**< 输出格式 */
+     unsigned int flush_policy;  /**< 刷新策略，log_flush_policy_t 的组合 */
+     size_t flush_bytes;         /**< LOG_FLUSH_BYTES 的阈值（字节），0表示使用默认值 */
+     unsigned int flush_interval_ms; /**< LOG_FLUSH_INTERVAL 的间隔（毫秒），0表示使用默认值 */
+     bool mmap_file;             /**< 日志文件使用内存映射写出：按段预分配，写日志时直接复制到映射区域 */
+     size_t mmap_segment_size;   /**< 内存映射每段的大小（字节），0表示使用默认值 */
+     size_t rotate_size;         /**< 日志文件达到此大小（字节）时轮转，0表示不按大小轮转 */
+     unsigned int rotate_interval_sec; /**< 按墙上时间轮转的间隔（秒），0表示不按时间轮转 */
+     unsigned int rotate_keep;   /**< 轮转后保留的历史文件个数，0表示使用默认值 */
+     bool rotate_compress;       /**< 由后台线程把历史文件压缩为 .lz 格式（见 log_lz.h） */
+     bool filter_fingerprint_only; /**< 日志过滤器只保存日志的64位指纹，不保存日志内容 */
+     size_t governor_bytes_per_sec; /**< 流量控制：每秒最多写出的字节数，0表示不限制 */
+     unsigned int governor_records_per_sec; /**< 流量控制：每秒最多写出的条数，0表示不限制；
+                                                 超出时先丢弃 DEBUG 和 INFO，ERROR 和 FATAL 总是写出 */
+     unsigned int suppress_summary_sec; /**< 每隔多少秒为每条被过滤过的日志输出一行汇总
+                                             "suppressed N occurrences in last Ts: 内容"，0表示不汇总 */
+     bool no_stdout;             /**< 不直接写标准输出，例如改用 log_sink_stdout 由独立的线程写出 */
+     size_t flight_recorder_size; /**< 每个线程的飞行记录器字节数，0表示不启用：低于当前级别的 LOG_* 日志
+                                       不格式化，只记录原始参数；写出 ERROR 及以上的日志之前或调用
+                                       log_flight_dump 时才还原并写出。二进制格式下不启用 */
+     bool crash_handler;         /**< 安装 SIGSEGV、SIGBUS、SIGFPE、SIGILL 和 SIGABRT 的处理函数：崩溃时调用
+                                      log_emergency_flush，再按原来的处理方式重新触发信号 */
+ } log_options_t;
+ 
+ /* 调用点缓存的最大参数个数，超过时退化为格式化后写出 */
+ #define LOG_CALLSITE_MAX_ARGS 16
+ 
+ /**
+  * 日志调用点，每个 LOG_* 宏调用处各有一个静态实例，除前四项外均由日志系统维护
+  */
+ typedef struct {
+     log_level_t level;              /**< 调用处的日志级别 */
+     const char *file;               /**< 调用处的文件名 */
+     int line;                       /**< 调用处的行号 */
+     const char *module;             /**< 调用处所属的模块名（LOG_MODULE），NULL表示不属于任何模块 */
+     unsigned int level_state;       /**< 级别缓存：高位为计算时的级别生成号，低两位为 LOG_SITE_CALL 和 LOG_SITE_EMIT */
+     unsigned long long binary_key;  /**< 二进制模式：高32位为会话号，低32位为调用点编号 */
+     const char *binary_fmt;         /**< 二进制模式：分配编号时的格式字符串 */
+     int binary_argc;                /**< 二进制模式：参数个数，-1表示格式不支持延迟格式化 */
+     unsigned char binary_types[LOG_CALLSITE_MAX_ARGS]; /**< 二进制模式：参数类型 */
+     unsigned int filter_session;    /**< 按调用点过滤：计数所属的会话号 */
+     unsigned int filter_count;      /**< 按调用点过滤：当前一分钟内的调用次数 */
+     long long filter_window;        /**< 按调用点过滤：当前一分钟的开始时间（秒） */
+     long long filter_until;         /**< 按调用点过滤：屏蔽截止时间（秒），0表示未屏蔽 */
+ } log_callsite_t;
+ 
+ /**
+  * 键值字段的类型
+  */
+ typedef enum {
+     LOG_FIELD_INT = 0,    /**< 有符号整数 */
+     LOG_FIELD_DOUBLE,     /**< 浮点数 */
+     LOG_FIELD_STRING,     /**< 字符串（指针加长度，不要求以'\0'结尾） */
+     LOG_FIELD_BOOL        /**< 布尔值 */
+ } log_field_type_t;
+ 
+ /**
+  * 键值字段，用 log_field_int 等函数构造；只在 log_kv 调用期间使用，不复制键和字符串
+  */
+ typedef struct {
+     const char *key;               /**< 字段名 */
+     log_field_type_t type;         /**< 字段类型 */
+     union {
+         long long i;               /**< LOG_FIELD_INT */
+         double d;                  /**< LOG_FIELD_DOUBLE */
+         struct {
+             const char *ptr;
+             size_t len;
+         } s;                       /**< LOG_FIELD_STRING */
+         bool b;                    /**< LOG_FIELD_BOOL */
+     } value;                       /**< 字段值 */
+ } log_field_t;
+ 
+ /* 构造各类型的键值字段，字符串字段只保存指针 */
+ static inline log_field_t log_field_int(const char *key, long long value) {
+     log_field_t field;
+     field.key = key;
+     field.type = LOG_FIELD_INT;
+     field.value.i = value;
+     return field;
+ }
+ 
+ static inline log_field_t log_field_double(const char *key, double value) {
+     log_field_t field;
+     field.key = key;
+     field.type = LOG_FIELD_DOUBLE;
+     field.value.d = value;
+     return field;
+ }
+ 
+ static inline log_field_t log_field_strn(const char *key, const char *value, size_t len) {
+     log_field_t field;
+     field.key = key;
+     field.type = LOG_FIELD_STRING;
+     field.value.s.ptr = value;
+     field.value.s.len = len;
+     return field;
+ }
+ 
+ static inline log_field_t log_field_str(const char *key, const char *value) {
+     return log_field_strn(key, value ? value : "", value ? strlen(value) : 0);
+ }
+ 
+ static inline log_field_t log_field_bool(const char *key, bool value) {
+     log_field_t field;
+     field.key = key;
+     field.type = LOG_FIELD_BOOL;
+     field.value.b = value;
+     return field;
+ }
+ 
  /**
   * @brief 初始化日志系统
   * 
@@ -41,11 +182,103 @@
   */
  int log_init(const char *filename, log_level_t level, log_mode_t mode);
  
+ /**
+  * @brief 使用可选配置初始化日志系统
+  * 
+  * @param filename 日志文件名，如果为NULL则只输出到标准输出
+  * @param level 日志级别，低于此级别的日志不会被打印
+  * @param mode 日志打印模式
+  * @param options 可选配置，为NULL时等同于 log_init
+  * @return 成功返回0，失败返回-1
+  */
+ int log_init_ex(const char *filename, log_level_t level, log_mode_t mode,
+                 const log_options_t *options);
+ 
+ /**
+  * @brief 立即写出所有尚未写出的日志
+  * 
+  * 异步模式下会等待队列中已提交的日志全部写出，并等待各 sink 写完已进入其队列的日志
+  */
+ void log_flush(void);
+ 
  /**
   * @brief 销毁日志系统，释放资源
   */
  void log_destroy(void);
  
+ /**
+  * @brief 获取因超出流量限制被丢弃的日志条数
+  * 
+  * @param level 日志级别
+  * @return 本次初始化以来该级别被丢弃的条数
+  */
+ unsigned long long log_get_dropped(log_level_t level);
+ 
+ /* 写出耗时直方图的桶数 */
+ #define LOG_STATS_LATENCY_BUCKETS 32
+ 
+ /**
+  * 日志系统运行统计（log_get_stats 的快照），计数从本次初始化开始
+  */
+ typedef struct {
+     unsigned long long emitted[LOG_LEVEL_FATAL + 1]; /**< 各级别写出的日志条数 */
+     unsigned long long bytes_written;      /**< 写出的日志字节数，每条日志只计一次，与输出的路数无关 */
+     unsigned long long filtered_duplicate; /**< 作为一小时内的重复日志被过滤的条数 */
+     unsigned long long filtered_massive;   /**< 作为海量日志被屏蔽的条数，包括 LOG_MODE_CALLSITE 按调用点屏蔽的 */
+     unsigned long long dropped;            /**< 超出流量限制被丢弃的条数（各级别之和） */
+     unsigned long long sink_dropped;       /**< 因队列已满被 sink 丢弃的条数（各 sink 之和） */
+     size_t filter_records;                 /**< 过滤表中的记录数 */
+     size_t filter_capacity;                /**< 过滤表的槽位数 */
+     size_t filter_max_probe;               /**< 过滤表最长的探测序列（组数），相当于最长链 */
+     size_t filter_memory;                  /**< 过滤表占用的内存（字节） */
+     unsigned long long write_latency[LOG_STATS_LATENCY_BUCKETS]; /**< 每次写出（writev）耗时的直方图：
+                                                                       第 i 个桶为 [2^i, 2^(i+1)) 纳秒，最后一个桶包括更长的耗时 */
+ } log_stats_t;
+ 
+ /**
+  * @brief 获取日志系统运行统计
+  * 
+  * 计数在打印日志时只做一次线程间基本不争用的原子加法；过滤表的统计需要遍历整个表，
+  * 只用于监控，不要频繁调用
+  * 
+  * @param stats 输出参数，未初始化时全部为0
+  */
+ void log_get_stats(log_stats_t *stats);
+ 
+ /* 最多可添加的 sink 个数 */
+ #define LOG_MAX_SINKS 8
+ 
+ /**
+  * 日志输出目标（不透明类型，见 log_sink.h）
+  */
+ typedef struct log_sink log_sink_t;
+ 
+ /**
+  * @brief 添加一个输出目标，文本和 JSON 格式的日志在写出时同时分发给它
+  * 
+  * 每个 sink 有自己的队列和线程，写得慢的 sink 只会丢弃自己的日志；
+  * 添加后由日志系统负责销毁，log_destroy 时一并销毁
+  * 
+  * @param sink 输出目标
+  * @return 成功返回0，未初始化或 sink 数达到 LOG_MAX_SINKS 时返回-1（此时 sink 仍由调用者销毁）
+  */
+ int log_add_sink(log_sink_t *sink);
+ 
+ /**
+  * @brief 立即写出所有线程飞行记录器中的日志，并清空记录器
+  */
+ void log_flight_dump(void);
+ 
+ /**
+  * @brief 紧急写出输出缓冲和异步队列中尚未写出的日志（异步信号安全）
+  * 
+  * 只调用 write，不加锁也不分配内存，可以在调用者自己的信号处理函数中调用。
+  * 写出期间后台线程暂停从队列取日志，但其他线程同时写出时仍可能重复一部分日志；
+  * 输出目标只写出 log_sink_stdout 和 log_sink_file 的缓冲和队列，
+  * 使用内存映射文件时异步队列中的日志不会写出
+  */
+ void log_emergency_flush(void);
+ 
  /**
   * @brief 设置日志级别
   * 
@@ -53,6 +286,24 @@
   */
  void log_set_level(log_level_t level);
  
+ /**
+  * @brief 设置模块的日志级别，覆盖该模块内 LOG_* 宏的全局日志级别
+  * 
+  * 可以在初始化之前调用，设置在 log_destroy 之后仍然保留
+  * 
+  * @param module 模块名，与调用处的 LOG_MODULE 相同，长度小于 LOG_MODULE_NAME_MAX
+  * @param level 该模块的日志级别
+  * @return 成功返回0，参数无效或模块数超过 LOG_MAX_MODULES 时返回-1
+  */
+ int log_set_module_level(const char *module, log_level_t level);
+ 
+ /**
+  * @brief 清除模块的日志级别，该模块重新使用全局日志级别
+  * 
+  * @param module 模块名
+  */
+ void log_clear_module_level(const char *module);
+ 
  /**
   * @brief 设置日志模式
   * 
@@ -72,13 +323,149 @@
   */
  void log_print(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...);
  
+ /**
+  * @brief 按调用点打印日志，由 LOG_* 宏调用
+  * 
+  * 二进制模式下只记录调用点编号、时间戳和原始参数，不做格式化
+  * 
+  * @param site 调用点
+  * @param func 调用处的函数名
+  * @param fmt 格式化字符串
+  * @param ... 参数列表
+  */
+ void log_print_callsite(log_callsite_t *site, const char *func, const char *fmt, ...)
+     __attribute__((format(printf, 3, 4)));
+ 
+ /**
+  * @brief 打印一条键值日志，字段按类型直接写出，不经过 printf 格式化
+  * 
+  * 文本格式下写为 "消息 key=value ..."（含空格、引号或'='的字符串加引号），
+  * JSON 格式下每个字段是对象的一个成员；过滤按文本形式进行
+  * 
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param msg 消息
+  * @param fields 字段数组
+  * @param count 字段个数
+  */
+ void log_kv(log_level_t level, const char *file, int line, const char *func, const char *msg,
+             const log_field_t *fields, size_t count);
+ 
+ /**
+  * @brief 按调用点打印键值日志，由 LOG_KV 宏调用
+  * 
+  * @param site 调用点
+  * @param func 调用处的函数名
+  * @param msg 消息
+  * @param fields 字段数组
+  * @param count 字段个数
+  */
+ void log_kv_callsite(log_callsite_t *site, const char *func, const char *msg,
+                      const log_field_t *fields, size_t count);
+ 
+ /**
+  * 编译期日志级别（0~4 对应 DEBUG~FATAL），低于此级别的 LOG_* 宏在编译时被整体删除，
+  * 例如发布版本用 -DLOG_COMPILE_LEVEL=1 去掉所有 LOG_DEBUG
+  */
+ #ifndef LOG_COMPILE_LEVEL
+ #define LOG_COMPILE_LEVEL 0
+ #endif
+ 
+ /* 模块名的最大长度（含结尾的'\0'）和最多可设置级别的模块数 */
+ #define LOG_MODULE_NAME_MAX 32
+ #define LOG_MAX_MODULES 256
+ 
+ /**
+  * 调用处所属的模块名，在包含本头文件之前定义，例如 #define LOG_MODULE "net"；
+  * 未定义时不属于任何模块，使用全局日志级别
+  */
+ #ifndef LOG_MODULE
+ #define LOG_MODULE NULL
+ #endif
+ 
+ /**
+  * 级别生成号，只读；全局或任一模块的日志级别改变时递增，使所有调用点的级别缓存失效
+  */
+ extern unsigned int log_level_generation;
+ 
+ /* 调用点级别缓存的标志位：需要调用日志函数（级别打开或飞行记录器需要记录）、级别打开 */
+ #define LOG_SITE_CALL 1u
+ #define LOG_SITE_EMIT 2u
+ #define LOG_SITE_GEN_SHIFT 2
+ 
+ /**
+  * @brief 按调用点的级别和所属模块重新计算缓存，并以 generation 为生成号写入
+  * 
+  * @param site 调用点
+  * @param generation 调用之前读取的级别生成号
+  * @return 需要调用日志函数返回true
+  */
+ bool log_site_resolve(log_callsite_t *site, unsigned int generation);
+ 
+ /**
+  * @brief 判断调用点是否需要调用日志函数
+  * 
+  * 缓存的生成号与当前生成号相同时只需一次比较，无论有多少模块；否则重新计算
+  * 
+  * @param site 调用点
+  * @return 级别打开，或者启用了飞行记录器时返回true
+  */
+ static inline bool log_site_enabled(log_callsite_t *site) {
+     unsigned int generation = __atomic_load_n(&log_level_generation, __ATOMIC_ACQUIRE);
+     unsigned int state = __atomic_load_n(&site->level_state, __ATOMIC_RELAXED);
+     
+     if (__builtin_expect((state >> LOG_SITE_GEN_SHIFT) == generation, 1)) {
+         return state & LOG_SITE_CALL;
+     }
+     return log_site_resolve(site, generation);
+ }
+ 
+ /**
+  * 调用点的静态初始化器，列出全部成员，C++ 中以 -Wextra 编译时不会报缺少初始化的警告
+  */
+ #define LOG_CALLSITE_INIT(lvl) { \
+         .level = (lvl), .file = __FILE__, .line = __LINE__, .module = LOG_MODULE, \
+         .level_state = 0, .binary_key = 0, .binary_fmt = NULL, .binary_argc = 0, .binary_types = { 0 }, \
+         .filter_session = 0, .filter_count = 0, .filter_window = 0, .filter_until = 0 }
+ 
+ /**
+  * 在调用处定义静态调用点并打印日志：先按编译期级别判断（常量，不打开时整条语句被删除），
+  * 再检查调用点的级别缓存；级别未打开时不求值参数、不调用函数
+  */
+ #define LOG_CALLSITE(lvl, fmt, ...) do { \
+         if ((int)(lvl) >= LOG_COMPILE_LEVEL) { \
+             static log_callsite_t log_site_ = LOG_CALLSITE_INIT(lvl); \
+             if (__builtin_expect(log_site_enabled(&log_site_), 0)) { \
+                 log_print_callsite(&log_site_, __func__, fmt, ##__VA_ARGS__); \
+             } \
+         } \
+     } while (0)
+ 
+ /**
+  * 键值日志宏，至少需要一个字段，例如
+  * LOG_KV(LOG_LEVEL_INFO, "request done", log_field_str("path", path), log_field_int("status", 200));
+  * 级别未打开时不构造字段
+  */
+ #define LOG_KV(lvl, msg, ...) do { \
+         if ((int)(lvl) >= LOG_COMPILE_LEVEL) { \
+             static log_callsite_t log_site_ = LOG_CALLSITE_INIT(lvl); \
+             if (__builtin_expect(log_site_enabled(&log_site_), 0)) { \
+                 const log_field_t log_fields_[] = { __VA_ARGS__ }; \
+                 log_kv_callsite(&log_site_, __func__, msg, log_fields_, \
+                                 sizeof(log_fields_) / sizeof(log_fields_[0])); \
+             } \
+         } \
+     } while (0)
+ 
  /**
   * 日志打印宏，方便调用
   */
- #define LOG_DEBUG(fmt, ...) log_print(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
- #define LOG_INFO(fmt, ...)  log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
- #define LOG_WARN(fmt, ...)  log_print(LOG_LEVEL_WARN, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
- #define LOG_ERROR(fmt, ...) log_print(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
- #define LOG_FATAL(fmt, ...) log_print(LOG_LEVEL_FATAL, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+ #define LOG_DEBUG(fmt, ...) LOG_CALLSITE(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+ #define LOG_INFO(fmt, ...)  LOG_CALLSITE(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+ #define LOG_WARN(fmt, ...)  LOG_CALLSITE(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+ #define LOG_ERROR(fmt, ...) LOG_CALLSITE(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+ #define LOG_FATAL(fmt, ...) LOG_CALLSITE(LOG_LEVEL_FATAL, fmt, ##__VA_ARGS__)
  
  #endif /* _LOGGER_H_ */
\ No newline at end of file
@@ -0,0 +1,113 @@
+/**
+ * @file filter_bench.c
+ * @brief 日志过滤器哈希表性能测试
+ *
+ * 分别向过滤器写入不同数量的不重复日志，然后随机查找已有日志，输出每秒查找次数；
+ * 保存日志内容和只保存指纹两种模式各测一遍
+ * 用法: filter_bench [每轮查找次数]
+ */
+ 
+ #include "log_filter.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <time.h>
+ 
+ /* 默认每轮查找次数 */
+ #define DEFAULT_LOOKUPS 4000000
+ 
+ /* 单条日志的最大长度 */
+ #define KEY_MAX_LEN 64
+ 
+ /**
+  * @brief 获取单调时钟时间（秒）
+  */
+ static double now_sec(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+ }
+ 
+ /**
+  * @brief 测试一种键数量下的查找性能
+  *
+  * @param nkeys 不重复日志的条数
+  * @param lookups 查找次数
+  * @param store_content 过滤器是否保存日志内容
+  * @return 成功返回0，失败返回-1
+  */
+ static int bench_keys(size_t nkeys, size_t lookups, bool store_content) {
+     char *keys = malloc(nkeys * KEY_MAX_LEN);
+     size_t *lens = malloc(nkeys * sizeof(size_t));
+     unsigned int rnd = 12345;
+     double start, elapsed;
+     
+     if (!keys || !lens) {
+         perror("malloc failed for bench keys");
+         free(keys);
+         free(lens);
+         return -1;
+     }
+     
+     for (size_t i = 0; i < nkeys; i++) {
+         lens[i] = (size_t)snprintf(keys + i * KEY_MAX_LEN, KEY_MAX_LEN,
+                                    "request %zu from client %zu failed", i, i % 97);
+     }
+     
+     if (filter_init_ex(store_content) != 0) {
+         free(keys);
+         free(lens);
+         return -1;
+     }
+     
+     /* 写入所有日志，期间哈希表会多次扩容 */
+     start = now_sec();
+     for (size_t i = 0; i < nkeys; i++) {
+         filter_check(keys + i * KEY_MAX_LEN, lens[i]);
+     }
+     elapsed = now_sec() - start;
+     printf("%-11s %8zu keys: insert %8.2f M/s", store_content ? "content" : "fingerprint", nkeys, nkeys / elapsed / 1e6);
+     
+     /* 随机查找已有日志 */
+     start = now_sec();
+     for (size_t i = 0; i < lookups; i++) {
+         size_t k;
+         rnd = rnd * 1103515245u + 12345u;
+         k = (rnd >> 4) % nkeys;
+         filter_check(keys + k * KEY_MAX_LEN, lens[k]);
+     }
+     elapsed = now_sec() - start;
+     printf(", lookup %8.2f M/s\n", lookups / elapsed / 1e6);
+     
+     filter_destroy();
+     free(keys);
+     free(lens);
+     return 0;
+ }
+ 
+ int main(int argc, char *argv[]) {
+     static const size_t key_counts[] = {1000, 100000, 1000000};
+     size_t lookups = DEFAULT_LOOKUPS;
+     
+     if (argc > 2) {
+         fprintf(stderr, "用法: %s [每轮查找次数]\n", argv[0]);
+         return 1;
+     }
+     if (argc == 2) {
+         lookups = strtoul(argv[1], NULL, 10);
+         if (lookups == 0) {
+             fprintf(stderr, "查找次数必须大于0\n");
+             return 1;
+         }
+     }
+     
+     for (int mode = 0; mode < 2; mode++) {
+         for (size_t i = 0; i < sizeof(key_counts) / sizeof(key_counts[0]); i++) {
+             if (bench_keys(key_counts[i], lookups, mode == 0) != 0) {
+                 return 1;
+             }
+         }
+     }
+     
+     return 0;
+ }
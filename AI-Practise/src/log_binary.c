@@ -0,0 +1,900 @@
+/**
+ * @file log_binary.c
+ * @brief 二进制日志编解码实现
+ *
+ * 编码端按照格式字符串预先编译出的参数类型，从参数列表中逐个取出原始值并用变长整数
+ * 写出；解码端重新解析格式字符串，对每个转换说明单独调用 snprintf 还原出文本
+ */
+ 
+ #include "log_binary.h"
+ #include "log_clock.h"
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdint.h>
+ #include <limits.h>
+ #include <stdbool.h>
+ #include <time.h>
+ #include <sys/types.h>
+ 
+ /* 参数类型编码 */
+ enum {
+     ARG_INT = 1,   /* int 及更短的整数（按 int 提升） */
+     ARG_LONG,      /* long */
+     ARG_LLONG,     /* long long */
+     ARG_INTMAX,    /* intmax_t */
+     ARG_SIZE,      /* size_t */
+     ARG_PTRDIFF,   /* ptrdiff_t */
+     ARG_DOUBLE,    /* double */
+     ARG_LDOUBLE,   /* long double，按 double 保存 */
+     ARG_STRING,    /* 字符串，保存内容 */
+     ARG_PTR,       /* 指针，保存地址值 */
+     ARG_STRING_PREC, /* 精度由前一个参数给出的字符串，最多读取精度个字节 */
+     ARG_STRING_FIXED /* 常数精度的字符串，类型之后紧跟变长编码的精度，最多读取精度个字节 */
+ };
+ 
+ /* 长度修饰符 */
+ enum {
+     LEN_NONE = 0,
+     LEN_HH,
+     LEN_H,
+     LEN_L,
+     LEN_LL,
+     LEN_J,
+     LEN_Z,
+     LEN_T,
+     LEN_BIG_L
+ };
+ 
+ /* 一个转换说明的解析结果 */
+ typedef struct {
+     const char *start;  /* '%' 的位置 */
+     size_t len;         /* 转换说明长度（包括 '%'） */
+     bool star_width;    /* 宽度由参数给出 */
+     bool has_prec;      /* 带有精度 */
+     bool star_prec;     /* 精度由参数给出 */
+     int prec;           /* 常数精度 */
+     int length;         /* 长度修饰符 */
+     char conv;          /* 转换字符 */
+ } fmt_spec_t;
+ 
+ /* 日志级别名称，与 logger.c 保持一致（解码工具不依赖日志系统本身） */
+ static const char *level_strings[] = {
+     "DEBUG",
+     "INFO",
+     "WARN",
+     "ERROR",
+     "FATAL"
+ };
+ 
+ #define LEVEL_COUNT (sizeof(level_strings) / sizeof(level_strings[0]))
+ 
+ /* 变长整数的最大字节数 */
+ #define VARINT_MAX_BYTES 10
+ 
+ static size_t put_varint(unsigned char *out, uint64_t value);
+ 
+ /* 调用点定义 */
+ typedef struct {
+     bool defined;       /* 是否已读到定义 */
+     int level;          /* 日志级别 */
+     int line;           /* 行号 */
+     char *file;         /* 文件名 */
+     char *func;         /* 函数名 */
+     char *fmt;          /* 格式字符串 */
+ } site_def_t;
+ 
+ struct log_binary_decoder {
+     FILE *in;               /* 输入流 */
+     site_def_t *sites;      /* 调用点表，按编号索引 */
+     size_t site_count;      /* 调用点表容量 */
+     unsigned char *args;    /* 参数缓冲区 */
+     size_t args_cap;        /* 参数缓冲区容量 */
+     char *text;             /* 字符串参数临时缓冲区 */
+ };
+ 
+ /**
+  * @brief 解析一个转换说明
+  *
+  * @param p 指向 '%' 的指针
+  * @param spec 输出参数，解析结果
+  * @return 转换说明之后的位置
+  */
+ static const char *parse_spec(const char *p, fmt_spec_t *spec) {
+     memset(spec, 0, sizeof(*spec));
+     spec->start = p++;
+     
+     /* 标志位 */
+     while (*p && strchr("-+ #0'", *p)) {
+         p++;
+     }
+     
+     /* 宽度 */
+     if (*p == '*') {
+         spec->star_width = true;
+         p++;
+     } else {
+         while (*p >= '0' && *p <= '9') {
+             p++;
+         }
+     }
+     
+     /* 精度 */
+     if (*p == '.') {
+         spec->has_prec = true;
+         p++;
+         if (*p == '*') {
+             spec->star_prec = true;
+             p++;
+         } else {
+             while (*p >= '0' && *p <= '9') {
+                 if (spec->prec < INT_MAX / 10) {
+                     spec->prec = spec->prec * 10 + (*p - '0');
+                 }
+                 p++;
+             }
+         }
+     }
+     
+     /* 长度修饰符 */
+     switch (*p) {
+     case 'h':
+         spec->length = (p[1] == 'h') ? LEN_HH : LEN_H;
+         p += (p[1] == 'h') ? 2 : 1;
+         break;
+     case 'l':
+         spec->length = (p[1] == 'l') ? LEN_LL : LEN_L;
+         p += (p[1] == 'l') ? 2 : 1;
+         break;
+     case 'q':
+         spec->length = LEN_LL;
+         p++;
+         break;
+     case 'j':
+         spec->length = LEN_J;
+         p++;
+         break;
+     case 'z':
+         spec->length = LEN_Z;
+         p++;
+         break;
+     case 't':
+         spec->length = LEN_T;
+         p++;
+         break;
+     case 'L':
+         spec->length = LEN_BIG_L;
+         p++;
+         break;
+     default:
+         break;
+     }
+     
+     spec->conv = *p;
+     if (*p) {
+         p++;
+     }
+     spec->len = (size_t)(p - spec->start);
+     
+     return p;
+ }
+ 
+ /**
+  * @brief 获取转换说明对应的参数类型
+  *
+  * @param spec 转换说明
+  * @return 参数类型；0表示不消耗参数（%%）；-1表示不支持
+  */
+ static int spec_arg_type(const fmt_spec_t *spec) {
+     switch (spec->conv) {
+     case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+         switch (spec->length) {
+         case LEN_L:     return ARG_LONG;
+         case LEN_LL:    return ARG_LLONG;
+         case LEN_J:     return ARG_INTMAX;
+         case LEN_Z:     return ARG_SIZE;
+         case LEN_T:     return ARG_PTRDIFF;
+         case LEN_BIG_L: return -1;
+         default:        return ARG_INT;
+         }
+     case 'c':
+         return spec->length == LEN_NONE ? ARG_INT : -1;
+     case 's':
+         return spec->length == LEN_NONE ? ARG_STRING : -1;
+     case 'p':
+         return ARG_PTR;
+     case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+         return spec->length == LEN_BIG_L ? ARG_LDOUBLE : ARG_DOUBLE;
+     case '%':
+         return 0;
+     default:
+         return -1;
+     }
+ }
+ 
+ int log_binary_compile(const char *fmt, unsigned char *types, size_t max_types) {
+     const char *p = fmt;
+     size_t count = 0;
+     
+     if (!fmt) {
+         return -1;
+     }
+     
+     while ((p = strchr(p, '%')) != NULL) {
+         unsigned char prec_buf[VARINT_MAX_BYTES];
+         size_t prec_len;
+         fmt_spec_t spec;
+         int type;
+         
+         p = parse_spec(p, &spec);
+         type = spec_arg_type(&spec);
+         if (type < 0) {
+             return -1;
+         }
+         if (type == 0) {
+             continue;
+         }
+         /* 带精度的字符串可以没有'\0'结尾，只能读取精度个字节 */
+         if (type == ARG_STRING && spec.has_prec) {
+             type = spec.star_prec ? ARG_STRING_PREC : ARG_STRING_FIXED;
+         }
+         if (type == ARG_STRING_FIXED) {
+             prec_len = put_varint(prec_buf, (uint64_t)spec.prec);
+         } else {
+             prec_len = 0;
+         }
+         
+         if (count + spec.star_width + spec.star_prec + 1 + prec_len > max_types) {
+             return -1;
+         }
+         if (spec.star_width) {
+             types[count++] = ARG_INT;
+         }
+         if (spec.star_prec) {
+             types[count++] = ARG_INT;
+         }
+         types[count++] = (unsigned char)type;
+         memcpy(types + count, prec_buf, prec_len);
+         count += prec_len;
+     }
+     
+     return (int)count;
+ }
+ 
+ /**
+  * @brief 写出变长整数（LEB128）
+  *
+  * @param out 输出位置，至少 VARINT_MAX_BYTES 字节
+  * @param value 数值
+  * @return 写出的字节数
+  */
+ static size_t put_varint(unsigned char *out, uint64_t value) {
+     size_t n = 0;
+     
+     while (value >= 0x80) {
+         out[n++] = (unsigned char)(value | 0x80);
+         value >>= 7;
+     }
+     out[n++] = (unsigned char)value;
+     
+     return n;
+ }
+ 
+ /**
+  * @brief 从内存中读取变长整数
+  *
+  * @param p 读取位置，读取后向后移动
+  * @param end 数据结束位置
+  * @param value 输出参数，数值
+  * @return 成功返回0，数据不完整返回-1
+  */
+ static int get_varint(const unsigned char **p, const unsigned char *end, uint64_t *value) {
+     uint64_t result = 0;
+     
+     for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+         unsigned char byte = *(*p)++;
+         result |= (uint64_t)(byte & 0x7f) << shift;
+         if (!(byte & 0x80)) {
+             *value = result;
+             return 0;
+         }
+     }
+     
+     return -1;
+ }
+ 
+ /* 有符号整数的 zigzag 编码，使绝对值小的负数也只占少量字节 */
+ static inline uint64_t zigzag_encode(int64_t value) {
+     return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+ }
+ 
+ static inline int64_t zigzag_decode(uint64_t value) {
+     return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+ }
+ 
+ /**
+  * @brief 写出带长度前缀的字节串
+  *
+  * @param out 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @param pos 当前写位置
+  * @param data 数据
+  * @param len 数据长度
+  * @return 新的写位置，空间不足时返回0
+  */
+ static size_t put_bytes(unsigned char *out, size_t cap, size_t pos, const void *data, size_t len) {
+     if (pos + VARINT_MAX_BYTES + len > cap) {
+         return 0;
+     }
+     
+     pos += put_varint(out + pos, len);
+     memcpy(out + pos, data, len);
+     
+     return pos + len;
+ }
+ 
+ size_t log_binary_encode_header(unsigned char *out) {
+     out[0] = 'B';
+     out[1] = 'L';
+     out[2] = 'O';
+     out[3] = 'G';
+     out[4] = LOG_BINARY_VERSION;
+     
+     return 5;
+ }
+ 
+ size_t log_binary_encode_site(unsigned char *out, size_t cap, unsigned int id, int level,
+                               const char *file, int line, const char *func, const char *fmt) {
+     size_t pos = 0;
+     
+     if (cap < 1 + 3 * VARINT_MAX_BYTES) {
+         return 0;
+     }
+     
+     out[pos++] = 'S';
+     pos += put_varint(out + pos, id);
+     pos += put_varint(out + pos, (uint64_t)level);
+     pos += put_varint(out + pos, (uint64_t)line);
+     
+     if ((pos = put_bytes(out, cap, pos, file, strlen(file))) == 0 ||
+         (pos = put_bytes(out, cap, pos, func, strlen(func))) == 0 ||
+         (pos = put_bytes(out, cap, pos, fmt, strlen(fmt))) == 0) {
+         return 0;
+     }
+     
+     return pos;
+ }
+ 
+ size_t log_binary_encode_record(unsigned char *out, size_t cap, unsigned int id,
+                                 unsigned long long timestamp_us,
+                                 const unsigned char *types, int ntypes, va_list args) {
+     /* 参数先写在预留的头部空间之后，长度确定后再把头部补在前面 */
+     const size_t header_max = 1 + 3 * VARINT_MAX_BYTES;
+     unsigned char header[1 + 3 * VARINT_MAX_BYTES];
+     size_t pos = header_max;
+     size_t header_len = 0;
+     int prec = -1;
+     
+     if (cap <= header_max) {
+         return 0;
+     }
+     
+     for (int i = 0; i < ntypes; i++) {
+         /* 为后面的参数保留足够空间，字符串按剩余空间截断 */
+         size_t reserve = (size_t)(ntypes - i) * VARINT_MAX_BYTES;
+         const char *str;
+         double dval;
+         size_t len;
+         
+         if (pos + reserve > cap) {
+             return 0;
+         }
+         
+         switch (types[i]) {
+         case ARG_INT:
+             /* 记下最近的整数参数，它可能是后面字符串的 '*' 精度 */
+             prec = va_arg(args, int);
+             pos += put_varint(out + pos, zigzag_encode(prec));
+             break;
+         case ARG_LONG:
+             pos += put_varint(out + pos, zigzag_encode(va_arg(args, long)));
+             break;
+         case ARG_LLONG:
+             pos += put_varint(out + pos, zigzag_encode(va_arg(args, long long)));
+             break;
+         case ARG_INTMAX:
+             pos += put_varint(out + pos, zigzag_encode(va_arg(args, intmax_t)));
+             break;
+         case ARG_SIZE:
+             pos += put_varint(out + pos, va_arg(args, size_t));
+             break;
+         case ARG_PTRDIFF:
+             pos += put_varint(out + pos, zigzag_encode(va_arg(args, ptrdiff_t)));
+             break;
+         case ARG_DOUBLE:
+         case ARG_LDOUBLE:
+             dval = (types[i] == ARG_DOUBLE) ? va_arg(args, double)
+                                             : (double)va_arg(args, long double);
+             memcpy(out + pos, &dval, sizeof(dval));
+             pos += sizeof(dval);
+             break;
+         case ARG_STRING:
+         case ARG_STRING_PREC:
+         case ARG_STRING_FIXED:
+             str = va_arg(args, const char *);
+             if (!str) {
+                 str = "(null)";
+             }
+             if (types[i] == ARG_STRING_FIXED) {
+                 /* 取出紧跟在类型之后的精度 */
+                 const unsigned char *tp = types + i + 1;
+                 uint64_t fixed;
+                 if (get_varint(&tp, types + ntypes, &fixed) != 0) {
+                     return 0;
+                 }
+                 i = (int)(tp - types) - 1;
+                 len = strnlen(str, (size_t)fixed);
+             } else if (types[i] == ARG_STRING_PREC && prec >= 0) {
+                 len = strnlen(str, (size_t)prec);
+             } else {
+                 /* 与 printf 一样，负数精度视为没有精度 */
+                 len = strlen(str);
+             }
+             if (pos + reserve + len > cap) {
+                 len = cap - pos - reserve;
+             }
+             pos = put_bytes(out, cap, pos, str, len);
+             break;
+         case ARG_PTR:
+             pos += put_varint(out + pos, (uintptr_t)va_arg(args, void *));
+             break;
+         default:
+             return 0;
+         }
+     }
+     
+     /* 写出头部：标记、调用点编号、时间戳、参数长度 */
+     header[header_len++] = 'R';
+     header_len += put_varint(header + header_len, id);
+     header_len += put_varint(header + header_len, timestamp_us);
+     header_len += put_varint(header + header_len, pos - header_max);
+     
+     memcpy(out + header_max - header_len, header, header_len);
+     memmove(out, out + header_max - header_len, pos - header_max + header_len);
+     
+     return pos - header_max + header_len;
+ }
+ 
+ size_t log_binary_encode_text(unsigned char *out, size_t cap, int level,
+                               unsigned long long timestamp_us, const char *file, int line,
+                               const char *func, const char *msg, size_t msg_len) {
+     size_t pos = 0;
+     
+     if (cap < 1 + 3 * VARINT_MAX_BYTES) {
+         return 0;
+     }
+     
+     out[pos++] = 'T';
+     pos += put_varint(out + pos, (uint64_t)level);
+     pos += put_varint(out + pos, timestamp_us);
+     if ((pos = put_bytes(out, cap, pos, file, strlen(file))) == 0 ||
+         pos + VARINT_MAX_BYTES > cap) {
+         return 0;
+     }
+     pos += put_varint(out + pos, (uint64_t)line);
+     if ((pos = put_bytes(out, cap, pos, func, strlen(func))) == 0 ||
+         (pos = put_bytes(out, cap, pos, msg, msg_len)) == 0) {
+         return 0;
+     }
+     
+     return pos;
+ }
+ 
+ log_binary_decoder_t *log_binary_decoder_open(FILE *in) {
+     log_binary_decoder_t *dec;
+     
+     if (!in) {
+         return NULL;
+     }
+     
+     dec = (log_binary_decoder_t *)calloc(1, sizeof(log_binary_decoder_t));
+     if (!dec) {
+         perror("malloc failed for log_binary_decoder");
+         return NULL;
+     }
+     dec->in = in;
+     
+     return dec;
+ }
+ 
+ /**
+  * @brief 清空调用点表
+  *
+  * @param dec 解码器
+  */
+ static void reset_sites(log_binary_decoder_t *dec) {
+     for (size_t i = 0; i < dec->site_count; i++) {
+         free(dec->sites[i].file);
+         free(dec->sites[i].func);
+         free(dec->sites[i].fmt);
+     }
+     free(dec->sites);
+     dec->sites = NULL;
+     dec->site_count = 0;
+ }
+ 
+ void log_binary_decoder_close(log_binary_decoder_t *dec) {
+     if (!dec) {
+         return;
+     }
+     
+     reset_sites(dec);
+     free(dec->args);
+     free(dec->text);
+     free(dec);
+ }
+ 
+ /**
+  * @brief 从输入流读取变长整数
+  *
+  * @param in 输入流
+  * @param value 输出参数，数值
+  * @return 成功返回0，失败返回-1
+  */
+ static int read_varint(FILE *in, uint64_t *value) {
+     uint64_t result = 0;
+     
+     for (int shift = 0; shift < 64; shift += 7) {
+         int byte = getc(in);
+         if (byte == EOF) {
+             return -1;
+         }
+         result |= (uint64_t)(byte & 0x7f) << shift;
+         if (!(byte & 0x80)) {
+             *value = result;
+             return 0;
+         }
+     }
+     
+     return -1;
+ }
+ 
+ /**
+  * @brief 从输入流读取带长度前缀的字符串
+  *
+  * @param in 输入流
+  * @return 新分配的字符串，失败返回NULL
+  */
+ static char *read_string(FILE *in) {
+     uint64_t len;
+     char *str;
+     
+     if (read_varint(in, &len) != 0 || len > (1u << 24)) {
+         return NULL;
+     }
+     
+     str = (char *)malloc(len + 1);
+     if (!str) {
+         return NULL;
+     }
+     if (fread(str, 1, len, in) != len) {
+         free(str);
+         return NULL;
+     }
+     str[len] = '\0';
+     
+     return str;
+ }
+ 
+ /**
+  * @brief 确保参数缓冲区足够大
+  *
+  * @param dec 解码器
+  * @param size 需要的字节数
+  * @return 成功返回0，失败返回-1
+  */
+ static int reserve_args(log_binary_decoder_t *dec, size_t size) {
+     unsigned char *args;
+     char *text;
+     
+     if (size <= dec->args_cap) {
+         return 0;
+     }
+     
+     args = (unsigned char *)realloc(dec->args, size);
+     if (!args) {
+         return -1;
+     }
+     dec->args = args;
+     
+     text = (char *)realloc(dec->text, size + 1);
+     if (!text) {
+         return -1;
+     }
+     dec->text = text;
+     dec->args_cap = size;
+     
+     return 0;
+ }
+ 
+ /**
+  * @brief 格式化日志前缀，与文本模式的前缀一致
+  *
+  * @param out 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @param level 日志级别
+  * @param timestamp_us 时间戳（微秒）
+  * @param file 文件名
+  * @param line 行号
+  * @param func 函数名
+  * @return 前缀长度
+  */
+ static size_t format_prefix(char *out, size_t cap, int level, uint64_t timestamp_us,
+                             const char *file, int line, const char *func) {
+     struct timespec ts;
+     char time_str[LOG_CLOCK_TEXT_LEN + 1];
+     int len;
+     
+     ts.tv_sec = (time_t)(timestamp_us / 1000000);
+     ts.tv_nsec = (long)(timestamp_us % 1000000) * 1000;
+     log_clock_format(&ts, time_str);
+     
+     len = snprintf(out, cap, "%s [%s] [%s:%d %s] ",
+                    time_str,
+                    (level >= 0 && (size_t)level < LEVEL_COUNT) ? level_strings[level] : "?",
+                    file, line, func);
+     if (len < 0) {
+         return 0;
+     }
+     
+     return (size_t)len < cap ? (size_t)len : cap - 1;
+ }
+ 
+ /**
+  * @brief 按格式字符串和原始参数还原日志内容
+  *
+  * @param dec 解码器（提供字符串临时缓冲区）
+  * @param fmt 格式字符串
+  * @param args 原始参数
+  * @param args_len 原始参数长度
+  * @param out 输出缓冲区
+  * @param cap 输出缓冲区容量
+  * @return 写出的长度，参数数据损坏时返回-1
+  */
+ static int render_message(log_binary_decoder_t *dec, const char *fmt,
+                           const unsigned char *args, size_t args_len,
+                           char *out, size_t cap) {
+     const unsigned char *p = args;
+     const unsigned char *end = args + args_len;
+     const char *f = fmt;
+     size_t pos = 0;
+     
+     while (*f && pos + 1 < cap) {
+         fmt_spec_t spec;
+         char spec_buf[64];
+         size_t spec_len = 0;
+         uint64_t raw;
+         int type;
+         int n = 0;
+         
+         if (*f != '%') {
+             out[pos++] = *f++;
+             continue;
+         }
+         
+         f = parse_spec(f, &spec);
+         type = spec_arg_type(&spec);
+         if (type < 0 || spec.len + 2 * 24 >= sizeof(spec_buf)) {
+             return -1;
+         }
+         if (type == 0) {
+             out[pos++] = '%';
+             continue;
+         }
+         
+         /* 复制转换说明，把 '*' 替换为实际的宽度或精度 */
+         for (size_t i = 0; i < spec.len; i++) {
+             if (spec.start[i] == '*') {
+                 int value;
+                 if (get_varint(&p, end, &raw) != 0) {
+                     return -1;
+                 }
+                 value = (int)zigzag_decode(raw);
+                 /* 负数精度视为没有精度，连同 '.' 一起去掉 */
+                 if (value < 0 && i > 0 && spec.start[i - 1] == '.') {
+                     spec_len--;
+                     continue;
+                 }
+                 spec_len += (size_t)snprintf(spec_buf + spec_len, sizeof(spec_buf) - spec_len,
+                                              "%d", value);
+             } else {
+                 spec_buf[spec_len++] = spec.start[i];
+             }
+         }
+         spec_buf[spec_len] = '\0';
+         
+         if (type == ARG_DOUBLE || type == ARG_LDOUBLE) {
+             double dval;
+             if ((size_t)(end - p) < sizeof(dval)) {
+                 return -1;
+             }
+             memcpy(&dval, p, sizeof(dval));
+             p += sizeof(dval);
+             if (type == ARG_DOUBLE) {
+                 n = snprintf(out + pos, cap - pos, spec_buf, dval);
+             } else {
+                 n = snprintf(out + pos, cap - pos, spec_buf, (long double)dval);
+             }
+         } else if (type == ARG_STRING) {
+             if (get_varint(&p, end, &raw) != 0 || raw > (uint64_t)(end - p)) {
+                 return -1;
+             }
+             memcpy(dec->text, p, raw);
+             dec->text[raw] = '\0';
+             p += raw;
+             n = snprintf(out + pos, cap - pos, spec_buf, dec->text);
+         } else {
+             int64_t ival;
+             if (get_varint(&p, end, &raw) != 0) {
+                 return -1;
+             }
+             ival = zigzag_decode(raw);
+             switch (type) {
+             case ARG_INT:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (int)ival);
+                 break;
+             case ARG_LONG:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (long)ival);
+                 break;
+             case ARG_LLONG:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (long long)ival);
+                 break;
+             case ARG_INTMAX:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (intmax_t)ival);
+                 break;
+             case ARG_SIZE:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (size_t)raw);
+                 break;
+             case ARG_PTRDIFF:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (ptrdiff_t)ival);
+                 break;
+             case ARG_PTR:
+                 n = snprintf(out + pos, cap - pos, spec_buf, (void *)(uintptr_t)raw);
+                 break;
+             default:
+                 return -1;
+             }
+         }
+         
+         if (n > 0) {
+             pos += ((size_t)n < cap - pos) ? (size_t)n : cap - pos - 1;
+         }
+     }
+     
+     out[pos] = '\0';
+     return (int)pos;
+ }
+ 
+ /**
+  * @brief 确保文本以换行符结束
+  *
+  * @param line 文本
+  * @param len 文本长度
+  * @param cap 缓冲区容量
+  * @return 新的文本长度
+  */
+ static size_t finish_line(char *line, size_t len, size_t cap) {
+     if (len > 0 && len < cap - 1 && line[len - 1] != '\n') {
+         line[len++] = '\n';
+         line[len] = '\0';
+     }
+     return len;
+ }
+ 
+ int log_binary_decode_next(log_binary_decoder_t *dec, char *line, size_t cap) {
+     uint64_t id, level, line_no, timestamp, args_len;
+     unsigned char magic[4];
+     site_def_t *site;
+     size_t len;
+     int tag;
+     int n;
+     
+     if (!dec || !line || cap < 2) {
+         return -1;
+     }
+     
+     for (;;) {
+         tag = getc(dec->in);
+         switch (tag) {
+         case EOF:
+             return 0;
+         
+         case 'B':
+             /* 文件头：新的日志会话，调用点编号重新开始 */
+             if (fread(magic, 1, 4, dec->in) != 4 || memcmp(magic, "LOG", 3) != 0 ||
+                 magic[3] != LOG_BINARY_VERSION) {
+                 return -1;
+             }
+             reset_sites(dec);
+             break;
+         
+         case 'S':
+             if (read_varint(dec->in, &id) != 0 || id > (1u << 24) ||
+                 read_varint(dec->in, &level) != 0 || read_varint(dec->in, &line_no) != 0) {
+                 return -1;
+             }
+             if (id >= dec->site_count) {
+                 size_t count = (size_t)id + 64;
+                 site_def_t *sites = (site_def_t *)realloc(dec->sites, count * sizeof(site_def_t));
+                 if (!sites) {
+                     return -1;
+                 }
+                 memset(sites + dec->site_count, 0, (count - dec->site_count) * sizeof(site_def_t));
+                 dec->sites = sites;
+                 dec->site_count = count;
+             }
+             site = &dec->sites[id];
+             free(site->file);
+             free(site->func);
+             free(site->fmt);
+             site->level = (int)level;
+             site->line = (int)line_no;
+             site->file = read_string(dec->in);
+             site->func = read_string(dec->in);
+             site->fmt = read_string(dec->in);
+             site->defined = site->file && site->func && site->fmt;
+             if (!site->defined) {
+                 return -1;
+             }
+             break;
+         
+         case 'R':
+             if (read_varint(dec->in, &id) != 0 || read_varint(dec->in, &timestamp) != 0 ||
+                 read_varint(dec->in, &args_len) != 0 || args_len > (1u << 24) ||
+                 reserve_args(dec, (size_t)args_len + 1) != 0 ||
+                 fread(dec->args, 1, args_len, dec->in) != args_len) {
+                 return -1;
+             }
+             if (id >= dec->site_count || !dec->sites[id].defined) {
+                 return -1;
+             }
+             site = &dec->sites[id];
+             len = format_prefix(line, cap, site->level, timestamp, site->file, site->line, site->func);
+             n = render_message(dec, site->fmt, dec->args, (size_t)args_len, line + len, cap - len);
+             if (n < 0) {
+                 return -1;
+             }
+             return (int)finish_line(line, len + (size_t)n, cap);
+         
+         case 'T': {
+             char *file, *func, *msg;
+             if (read_varint(dec->in, &level) != 0 || read_varint(dec->in, &timestamp) != 0) {
+                 return -1;
+             }
+             file = read_string(dec->in);
+             func = NULL;
+             msg = NULL;
+             if (file && read_varint(dec->in, &line_no) == 0) {
+                 func = read_string(dec->in);
+                 msg = func ? read_string(dec->in) : NULL;
+             }
+             if (!msg) {
+                 free(file);
+                 free(func);
+                 return -1;
+             }
+             len = format_prefix(line, cap, (int)level, timestamp, file, (int)line_no, func);
+             n = snprintf(line + len, cap - len, "%s", msg);
+             if (n > 0) {
+                 len += ((size_t)n < cap - len) ? (size_t)n : cap - len - 1;
+             }
+             free(file);
+             free(func);
+             free(msg);
+             return (int)finish_line(line, len, cap);
+         }
+         
+         default:
+             return -1;
+         }
+     }
+ }
\ No newline at end of file
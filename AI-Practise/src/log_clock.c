@@ -0,0 +1,84 @@
+/**
+ * @file log_clock.c
+ * @brief 日志时间戳实现
+ *
+ * 避免每条日志都调用 gettimeofday + localtime + strftime：时间取自粗粒度单调时钟
+ * 加偏移量（vDSO读取，无系统调用），日期时间字符串只在秒数变化时重新生成
+ */
+ 
+ #include "log_clock.h"
+ #include <string.h>
+ #include <stdatomic.h>
+ 
+ /* 优先使用粗粒度单调时钟，读取开销只有普通时钟的几分之一 */
+ #ifdef CLOCK_MONOTONIC_COARSE
+ #define LOG_CLOCK_SOURCE CLOCK_MONOTONIC_COARSE
+ #else
+ #define LOG_CLOCK_SOURCE CLOCK_MONOTONIC
+ #endif
+ 
+ #define NSEC_PER_SEC 1000000000LL
+ 
+ /* 墙上时间与单调时间的差值（纳秒） */
+ static atomic_llong clock_offset_ns = 0;
+ /* 上次校准偏移量时单调时钟的秒数 */
+ static atomic_llong clock_sync_sec = -1;
+ 
+ /* 线程私有的时间字符串缓存 */
+ static _Thread_local struct {
+     time_t sec;                           /* 缓存对应的秒数 */
+     char text[LOG_CLOCK_TEXT_LEN + 1];    /* "YYYY-MM-DD HH:MM:SS." */
+ } tls_cache = {
+     .sec = (time_t)-1
+ };
+ 
+ void log_clock_now(struct timespec *ts) {
+     struct timespec mono;
+     long long mono_ns;
+     long long last_sync;
+     long long now_ns;
+     
+     clock_gettime(LOG_CLOCK_SOURCE, &mono);
+     mono_ns = (long long)mono.tv_sec * NSEC_PER_SEC + mono.tv_nsec;
+     
+     /* 每秒由一个线程与墙上时间校准一次，跟上NTP等对系统时间的调整 */
+     last_sync = atomic_load_explicit(&clock_sync_sec, memory_order_relaxed);
+     if (last_sync != (long long)mono.tv_sec &&
+         atomic_compare_exchange_strong(&clock_sync_sec, &last_sync, (long long)mono.tv_sec)) {
+         struct timespec real;
+         clock_gettime(CLOCK_REALTIME, &real);
+         atomic_store_explicit(&clock_offset_ns,
+                               (long long)real.tv_sec * NSEC_PER_SEC + real.tv_nsec - mono_ns,
+                               memory_order_relaxed);
+         if (last_sync < 0) {
+             /* 首次校准，直接使用墙上时间 */
+             *ts = real;
+             return;
+         }
+     }
+     
+     now_ns = mono_ns + atomic_load_explicit(&clock_offset_ns, memory_order_relaxed);
+     ts->tv_sec = (time_t)(now_ns / NSEC_PER_SEC);
+     ts->tv_nsec = (long)(now_ns % NSEC_PER_SEC);
+ }
+ 
+ size_t log_clock_format(const struct timespec *ts, char *out) {
+     unsigned int ms = (unsigned int)(ts->tv_nsec / 1000000);
+     
+     /* 秒数变化时才重新生成日期时间部分 */
+     if (ts->tv_sec != tls_cache.sec) {
+         struct tm tm_info;
+         localtime_r(&ts->tv_sec, &tm_info);
+         strftime(tls_cache.text, sizeof(tls_cache.text), "%Y-%m-%d %H:%M:%S", &tm_info);
+         tls_cache.text[19] = '.';
+         tls_cache.sec = ts->tv_sec;
+     }
+     
+     memcpy(out, tls_cache.text, 20);
+     out[20] = (char)('0' + ms / 100);
+     out[21] = (char)('0' + ms / 10 % 10);
+     out[22] = (char)('0' + ms % 10);
+     out[LOG_CLOCK_TEXT_LEN] = '\0';
+     
+     return LOG_CLOCK_TEXT_LEN;
+ }
\ No newline at end of file
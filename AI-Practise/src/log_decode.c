@@ -0,0 +1,80 @@
+/**
+ * @file log_decode.c
+ * @brief 二进制日志解码工具
+ *
+ * 将二进制格式（LOG_FORMAT_BINARY）的日志文件还原为文本格式，
+ * 也可以直接读取轮转后压缩的二进制日志文件
+ * 用法: log_decode <二进制日志文件> [输出文件]
+ */
+ 
+ #include "log_binary.h"
+ #include "log_lz.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ 
+ /* 单行日志缓冲区大小 */
+ #define LINE_BUFFER_SIZE 8192
+ 
+ int main(int argc, char *argv[]) {
+     FILE *in;
+     FILE *out = stdout;
+     log_binary_decoder_t *dec;
+     char line[LINE_BUFFER_SIZE];
+     int len;
+     int ret = 0;
+     
+     if (argc < 2 || argc > 3) {
+         fprintf(stderr, "用法: %s <二进制日志文件> [输出文件]\n", argv[0]);
+         return 1;
+     }
+     
+     in = fopen(argv[1], "rb");
+     if (!in) {
+         perror("Failed to open binary log file");
+         return 1;
+     }
+     
+     /* 压缩文件边读边解压 */
+     if (log_lz_detect(in)) {
+         fclose(in);
+         in = log_lz_fopen(argv[1]);
+         if (!in) {
+             return 1;
+         }
+     }
+     
+     if (argc == 3) {
+         out = fopen(argv[2], "w");
+         if (!out) {
+             perror("Failed to open output file");
+             fclose(in);
+             return 1;
+         }
+     }
+     
+     dec = log_binary_decoder_open(in);
+     if (!dec) {
+         fclose(in);
+         if (out != stdout) {
+             fclose(out);
+         }
+         return 1;
+     }
+     
+     while ((len = log_binary_decode_next(dec, line, sizeof(line))) > 0) {
+         fwrite(line, 1, (size_t)len, out);
+     }
+     
+     if (len < 0) {
+         fprintf(stderr, "Corrupted binary log at offset %ld\n", ftell(in));
+         ret = 1;
+     }
+     
+     log_binary_decoder_close(dec);
+     fclose(in);
+     if (out != stdout) {
+         fclose(out);
+     }
+     
+     return ret;
+ }
\ No newline at end of file
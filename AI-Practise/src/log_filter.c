@@ -2,80 +2,539 @@
  * @file log_filter.c
  * @brief 日志过滤功能实现
  * 
- * 实现了基于哈希表的日志过滤机制，用于处理日志重复打印和海量日志过滤
+ * 实现了基于哈希表的日志过滤机制，用于处理日志重复打印和海量日志过滤。
+ * 哈希表采用开放寻址：每个槽位有一个控制字节（空槽位或哈希值低7位），
+ * 查找时每次用一条SIMD指令比较一组16个控制字节，装载因子超过7/8时自动扩容。
+ * 记录以64位指纹为键，可选择不保存日志内容，只按指纹判断是否重复。
+ * 哈希表按哈希值高位分为多个分片，每个分片有自己的读写锁；查找只加读锁，
+ * 记录的计数用原子操作更新，多个线程可以同时检查日志而不需要外部加锁。
+ * 每个分片用一个时间轮记录各条记录的过期时间，检查日志时顺带清理少量已过期的记录，
+ * 长时间运行时内存不会随不同日志的数量无限增长
  */
-
+ 
  #include "log_filter.h"
  #include <stdlib.h>
  #include <string.h>
  #include <stdio.h>
+ #include <stdint.h>
+ #include <stdatomic.h>
+ #include <pthread.h>
+ #ifdef __SSE2__
+ #include <emmintrin.h>
+ #endif
  
- /* 哈希表大小，选择一个合适的质数 */
- #define HASH_TABLE_SIZE 997
+ /* 分片数的位数，分片由哈希值的最高几位选择 */
+ #define FILTER_SHARD_BITS 4
+ /* 分片数 */
+ #define FILTER_SHARD_COUNT (1 << FILTER_SHARD_BITS)
+ /* 每个分片的初始槽位数，必须是2的幂且不小于一组 */
+ #define FILTER_INITIAL_CAPACITY 128
+ /* 缓存行大小，分片按缓存行对齐避免伪共享 */
+ #define CACHE_LINE_SIZE 64
+ /* 每组的槽位数，一组控制字节可以用一条SIMD指令比较 */
+ #define FILTER_GROUP_SIZE 16
+ /* 控制字节：空槽位（其余取值为哈希值的低7位） */
+ #define CTRL_EMPTY 0x80
+ /* 控制字节：已删除的槽位，查找时需要越过，插入时可以复用 */
+ #define CTRL_DELETED 0xFE
+ /* 时间轮每格的时间跨度（秒） */
+ #define FILTER_WHEEL_TICK 64
+ /* 时间轮的格数，总跨度需要大于记录的最长有效期（1小时加1分钟） */
+ #define FILTER_WHEEL_SIZE 64
+ /* 每次检查日志时最多处理的时间轮记录数和格数 */
+ #define FILTER_SWEEP_BUDGET 16
+ /* 汇总被过滤日志时每次持锁收集的记录数 */
+ #define FILTER_REPORT_BATCH 32
+ /* 汇总时每条记录最多复制的日志内容长度 */
+ #define FILTER_REPORT_TEXT 256
  
- /* 定义日志记录的结构 */
+ /* 定义日志记录的结构：键在创建后不再改变，计数和时间用原子操作更新 */
  typedef struct log_record {
-     char *content;                /* 日志内容 */
+     uint64_t hash;                /* 完整哈希值，删除记录时用于定位槽位 */
+     struct log_record *wheel_next; /* 时间轮同一格中的下一条记录 */
+     char *content;                /* 日志内容，只保存指纹时为NULL */
      size_t content_len;           /* 日志内容长度 */
-     time_t first_time;            /* 首次出现时间 */
-     time_t last_time;             /* 最近出现时间 */
-     unsigned int count_total;     /* 总计出现次数 */
-     unsigned int count_last_min;  /* 最近一分钟出现次数 */
-     time_t last_min_start;        /* 当前"一分钟"的开始时间 */
-     bool is_massive;              /* 是否被标记为海量日志 */
-     struct log_record *next;      /* 链表下一个节点 */
+     unsigned int tag;             /* 附加键（如日志级别） */
+     atomic_llong first_time;      /* 首次出现时间 */
+     atomic_llong last_time;       /* 最近出现时间 */
+     atomic_uint count_total;      /* 总计出现次数 */
+     atomic_uint count_last_min;   /* 最近一分钟出现次数 */
+     atomic_llong last_min_start;  /* 当前"一分钟"的开始时间 */
+     atomic_bool is_massive;       /* 是否被标记为海量日志 */
+     atomic_uint suppressed;       /* 上次汇总以来被过滤的次数 */
  } log_record_t;
  
+ /* 哈希表槽位：保存完整哈希值，扩容时无需重新计算，查找时先比较哈希值再比较内容 */
+ typedef struct {
+     uint64_t hash;                /* 完整哈希值（指纹） */
+     log_record_t *record;         /* 日志记录 */
+ } filter_slot_t;
+ 
+ /* 汇总时在锁外回调的一条记录 */
+ typedef struct {
+     unsigned int tag;             /* 附加键 */
+     uint64_t fingerprint;         /* 指纹 */
+     unsigned int count;           /* 被过滤的次数 */
+     bool has_content;             /* 是否保存了日志内容 */
+     size_t len;                   /* 复制的内容长度 */
+     char text[FILTER_REPORT_TEXT]; /* 日志内容（可能被截断） */
+ } report_entry_t;
+ 
+ /* 哈希表分片：查找加读锁，插入、扩容和清理过期记录加写锁 */
+ typedef struct {
+     pthread_rwlock_t lock;        /* 分片读写锁 */
+     unsigned char *ctrl;          /* 控制字节数组，每个槽位一个字节 */
+     filter_slot_t *slots;         /* 槽位数组 */
+     size_t capacity;              /* 槽位数（2的幂） */
+     size_t count;                 /* 有效记录数 */
+     size_t used;                  /* 有效记录数加已删除的槽位数 */
+     log_record_t *wheel[FILTER_WHEEL_SIZE]; /* 时间轮，每格是一个按过期时间归入的记录链表 */
+     long long wheel_tick;         /* 时间轮下一个待处理的格（以 FILTER_WHEEL_TICK 为单位的时间） */
+     atomic_llong sweep_after;     /* 到达此时间后才需要尝试清理 */
+     atomic_ullong filtered_duplicate; /* 作为重复日志被过滤的次数，按分片计数避免线程间争用 */
+     atomic_ullong filtered_massive;   /* 作为海量日志被过滤的次数 */
+ } __attribute__((aligned(CACHE_LINE_SIZE))) filter_shard_t;
+ 
  /* 过滤器状态 */
  static struct {
-     log_record_t *hash_table[HASH_TABLE_SIZE]; /* 哈希表 */
-     bool initialized;                           /* 初始化标志 */
+     filter_shard_t shards[FILTER_SHARD_COUNT]; /* 哈希表分片 */
+     bool store_content;           /* 是否保存日志内容用于校验哈希冲突 */
+     atomic_bool initialized;      /* 初始化标志 */
  } filter_state = {
-     .hash_table = {NULL},
+     .store_content = true,
      .initialized = false
  };
  
+ /* XXH64 使用的素数 */
+ #define PRIME64_1 0x9E3779B185EBCA87ULL
+ #define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+ #define PRIME64_3 0x165667B19E3779F9ULL
+ #define PRIME64_4 0x85EBCA77C2B2AE63ULL
+ #define PRIME64_5 0x27D4EB2F165667C5ULL
+ 
+ static inline uint64_t rotl64(uint64_t x, int r) {
+     return (x << r) | (x >> (64 - r));
+ }
+ 
+ static inline uint64_t read64(const unsigned char *p) {
+     uint64_t v;
+     memcpy(&v, p, sizeof(v));
+     return v;
+ }
+ 
+ static inline uint32_t read32(const unsigned char *p) {
+     uint32_t v;
+     memcpy(&v, p, sizeof(v));
+     return v;
+ }
+ 
+ static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+     acc += input * PRIME64_2;
+     acc = rotl64(acc, 31);
+     return acc * PRIME64_1;
+ }
+ 
+ static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+     acc ^= xxh64_round(0, val);
+     return acc * PRIME64_1 + PRIME64_4;
+ }
+ 
  /**
-  * @brief 计算字符串的哈希值
+  * @brief 计算字符串的64位哈希值（指纹）
   * 
-  * 使用简单的BKDR哈希算法
+  * 使用XXH64算法（小端机器上与参考实现结果一致），每次处理8字节，
+  * 长日志用4路并行累加；附加键作为种子
   * 
+  * @param tag 附加键
   * @param str 字符串
   * @param len 字符串长度
   * @return 哈希值
   */
- static unsigned int hash_string(const char *str, size_t len) {
-     unsigned int seed = 131; /* 31, 131, 1313, 13131... 都是不错的种子 */
-     unsigned int hash = 0;
+ static uint64_t hash_string(unsigned int tag, const char *str, size_t len) {
+     const unsigned char *p = (const unsigned char *)str;
+     const unsigned char *end = p + len;
+     uint64_t seed = tag;
+     uint64_t hash;
+     
+     if (len >= 32) {
+         const unsigned char *limit = end - 32;
+         uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+         uint64_t v2 = seed + PRIME64_2;
+         uint64_t v3 = seed;
+         uint64_t v4 = seed - PRIME64_1;
+         
+         do {
+             v1 = xxh64_round(v1, read64(p));
+             v2 = xxh64_round(v2, read64(p + 8));
+             v3 = xxh64_round(v3, read64(p + 16));
+             v4 = xxh64_round(v4, read64(p + 24));
+             p += 32;
+         } while (p <= limit);
+         
+         hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+         hash = xxh64_merge(hash, v1);
+         hash = xxh64_merge(hash, v2);
+         hash = xxh64_merge(hash, v3);
+         hash = xxh64_merge(hash, v4);
+     } else {
+         hash = seed + PRIME64_5;
+     }
+     
+     hash += len;
+     
+     while (p + 8 <= end) {
+         hash ^= xxh64_round(0, read64(p));
+         hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+         p += 8;
+     }
+     
+     if (p + 4 <= end) {
+         hash ^= (uint64_t)read32(p) * PRIME64_1;
+         hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+         p += 4;
+     }
+     
+     while (p < end) {
+         hash ^= (*p) * PRIME64_5;
+         hash = rotl64(hash, 11) * PRIME64_1;
+         p++;
+     }
+     
+     /* 最终混合 */
+     hash ^= hash >> 33;
+     hash *= PRIME64_2;
+     hash ^= hash >> 29;
+     hash *= PRIME64_3;
+     hash ^= hash >> 32;
+     
+     return hash;
+ }
+ 
+ /**
+  * @brief 在一组控制字节中查找等于 h2 的位置
+  * 
+  * @param ctrl 一组控制字节的起始位置
+  * @param h2 要查找的控制字节
+  * @return 位图，第i位为1表示第i个槽位匹配
+  */
+ static inline unsigned int group_match(const unsigned char *ctrl, unsigned char h2) {
+ #ifdef __SSE2__
+     __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+     return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+ #else
+     unsigned int bits = 0;
+     for (int i = 0; i < FILTER_GROUP_SIZE; i++) {
+         if (ctrl[i] == h2) {
+             bits |= 1u << i;
+         }
+     }
+     return bits;
+ #endif
+ }
+ 
+ /**
+  * @brief 在一组控制字节中查找空槽位（不包括已删除的槽位）
+  * 
+  * @param ctrl 一组控制字节的起始位置
+  * @return 位图，第i位为1表示第i个槽位为空
+  */
+ static inline unsigned int group_match_empty(const unsigned char *ctrl) {
+     return group_match(ctrl, CTRL_EMPTY);
+ }
+ 
+ /**
+  * @brief 在一组控制字节中查找可以插入的槽位（空槽位或已删除的槽位）
+  * 
+  * @param ctrl 一组控制字节的起始位置
+  * @return 位图，第i位为1表示第i个槽位可以插入
+  */
+ static inline unsigned int group_match_free(const unsigned char *ctrl) {
+ #ifdef __SSE2__
+     /* 只有空槽位和已删除槽位的最高位为1 */
+     return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+ #else
+     unsigned int bits = 0;
+     for (int i = 0; i < FILTER_GROUP_SIZE; i++) {
+         if (ctrl[i] & 0x80) {
+             bits |= 1u << i;
+         }
+     }
+     return bits;
+ #endif
+ }
+ 
+ /**
+  * @brief 找到哈希值对应的第一个可插入槽位（调用者保证键不存在且表未满）
+  * 
+  * 按组做三角数探测：组数为2的幂时可以遍历所有组
+  * 
+  * @param ctrl 控制字节数组
+  * @param capacity 槽位数
+  * @param hash 哈希值
+  * @return 槽位下标
+  */
+ static size_t find_free_slot(const unsigned char *ctrl, size_t capacity, uint64_t hash) {
+     size_t group_mask = capacity / FILTER_GROUP_SIZE - 1;
+     size_t group = (hash >> 7) & group_mask;
+     
+     for (size_t step = 1; ; step++) {
+         unsigned int free_bits = group_match_free(ctrl + group * FILTER_GROUP_SIZE);
+         if (free_bits) {
+             return group * FILTER_GROUP_SIZE + (size_t)__builtin_ctz(free_bits);
+         }
+         group = (group + step) & group_mask;
+     }
+ }
+ 
+ /**
+  * @brief 分配指定容量的空哈希表
+  * 
+  * @param capacity 槽位数
+  * @param ctrl 输出参数，控制字节数组
+  * @param slots 输出参数，槽位数组
+  * @return 成功返回0，失败返回-1
+  */
+ static int alloc_table(size_t capacity, unsigned char **ctrl, filter_slot_t **slots) {
+     *ctrl = (unsigned char *)malloc(capacity);
+     *slots = (filter_slot_t *)malloc(capacity * sizeof(filter_slot_t));
+     if (!*ctrl || !*slots) {
+         perror("malloc failed for filter table");
+         free(*ctrl);
+         free(*slots);
+         return -1;
+     }
+     
+     memset(*ctrl, CTRL_EMPTY, capacity);
+     return 0;
+ }
+ 
+ /**
+  * @brief 重建分片：用保存的哈希值把所有有效记录放入新表，同时去掉已删除的槽位
+  * 
+  * 有效记录超过一半时容量翻倍，否则保持容量不变（调用者持有写锁）
+  * 
+  * @param shard 分片
+  * @return 成功返回0，失败返回-1
+  */
+ static int grow_table(filter_shard_t *shard) {
+     size_t capacity = (shard->count + 1) * 2 > shard->capacity ? shard->capacity * 2 : shard->capacity;
+     unsigned char *ctrl;
+     filter_slot_t *slots;
      
-     for (size_t i = 0; i < len; i++) {
-         hash = hash * seed + (unsigned char)str[i];
+     if (alloc_table(capacity, &ctrl, &slots) != 0) {
+         return -1;
+     }
+     
+     for (size_t i = 0; i < shard->capacity; i++) {
+         if (!(shard->ctrl[i] & 0x80)) {
+             uint64_t hash = shard->slots[i].hash;
+             size_t pos = find_free_slot(ctrl, capacity, hash);
+             ctrl[pos] = (unsigned char)(hash & 0x7f);
+             slots[pos] = shard->slots[i];
+         }
      }
      
-     return hash % HASH_TABLE_SIZE;
+     free(shard->ctrl);
+     free(shard->slots);
+     shard->ctrl = ctrl;
+     shard->slots = slots;
+     shard->capacity = capacity;
+     shard->used = shard->count;
+     
+     return 0;
  }
  
  /**
-  * @brief 在哈希表中查找或创建日志记录
+  * @brief 在分片中查找日志记录（调用者持有读锁或写锁）
   * 
+  * @param shard 分片
+  * @param hash 哈希值
+  * @param tag 附加键
   * @param content 日志内容
   * @param content_len 日志内容长度
-  * @return 日志记录指针，如果是新创建的，则需要初始化
+  * @return 日志记录指针，不存在时返回NULL
+  */
+ static log_record_t *find_record(const filter_shard_t *shard, uint64_t hash, unsigned int tag,
+                                  const char *content, size_t content_len) {
+     unsigned char h2 = (unsigned char)(hash & 0x7f);
+     size_t group_mask = shard->capacity / FILTER_GROUP_SIZE - 1;
+     size_t group = (hash >> 7) & group_mask;
+     
+     /* 逐组查找：先用控制字节筛选候选槽位，遇到含空槽位的组即可确定不存在 */
+     for (size_t step = 1; ; step++) {
+         const unsigned char *ctrl = shard->ctrl + group * FILTER_GROUP_SIZE;
+         unsigned int bits = group_match(ctrl, h2);
+         
+         while (bits) {
+             const filter_slot_t *slot = &shard->slots[group * FILTER_GROUP_SIZE + (size_t)__builtin_ctz(bits)];
+             log_record_t *record = slot->record;
+             /* 只保存指纹时，64位哈希值与长度都相同即视为同一条日志 */
+             if (slot->hash == hash && record->tag == tag && record->content_len == content_len &&
+                 (!record->content || memcmp(record->content, content, content_len) == 0)) {
+                 return record; /* 找到匹配的记录 */
+             }
+             bits &= bits - 1;
+         }
+         
+         if (group_match_empty(ctrl)) {
+             return NULL;
+         }
+         group = (group + step) & group_mask;
+     }
+ }
+ 
+ /**
+  * @brief 计算记录的过期时间：1小时窗口和最近一分钟计数都结束之后
+  * 
+  * @param record 日志记录
+  * @return 过期时间
+  */
+ static time_t record_deadline(const log_record_t *record) {
+     time_t window_end = (time_t)atomic_load_explicit(&record->first_time, memory_order_relaxed) + 3600;
+     time_t minute_end = (time_t)atomic_load_explicit(&record->last_min_start, memory_order_relaxed) + 60;
+     
+     return window_end > minute_end ? window_end : minute_end;
+ }
+ 
+ /**
+  * @brief 按过期时间把记录放入时间轮（调用者持有写锁）
+  * 
+  * 超出时间轮跨度的记录放在最远的一格，到时再检查一次；早于当前格的记录放在当前格
+  * 
+  * @param shard 分片
+  * @param record 日志记录
+  * @param deadline 过期时间
+  */
+ static void wheel_insert(filter_shard_t *shard, log_record_t *record, time_t deadline) {
+     long long tick = (long long)deadline / FILTER_WHEEL_TICK;
+     log_record_t **head;
+     
+     if (tick < shard->wheel_tick) {
+         tick = shard->wheel_tick;
+     } else if (tick > shard->wheel_tick + FILTER_WHEEL_SIZE - 1) {
+         tick = shard->wheel_tick + FILTER_WHEEL_SIZE - 1;
+     }
+     
+     head = &shard->wheel[tick % FILTER_WHEEL_SIZE];
+     record->wheel_next = *head;
+     *head = record;
+ }
+ 
+ /**
+  * @brief 从分片中删除记录并释放内存（调用者持有写锁，记录已不在时间轮中）
+  * 
+  * @param shard 分片
+  * @param record 日志记录
+  */
+ static void remove_record(filter_shard_t *shard, log_record_t *record) {
+     unsigned char h2 = (unsigned char)(record->hash & 0x7f);
+     size_t group_mask = shard->capacity / FILTER_GROUP_SIZE - 1;
+     size_t group = (record->hash >> 7) & group_mask;
+     
+     for (size_t step = 1; ; step++) {
+         unsigned int bits = group_match(shard->ctrl + group * FILTER_GROUP_SIZE, h2);
+         
+         while (bits) {
+             size_t pos = group * FILTER_GROUP_SIZE + (size_t)__builtin_ctz(bits);
+             if (shard->slots[pos].record == record) {
+                 /* 标记为已删除而不是空，后面的记录仍然可以被探测到 */
+                 shard->ctrl[pos] = CTRL_DELETED;
+                 shard->count--;
+                 free(record->content);
+                 free(record);
+                 return;
+             }
+             bits &= bits - 1;
+         }
+         group = (group + step) & group_mask;
+     }
+ }
+ 
+ /**
+  * @brief 处理时间轮中已经到期的格，删除过期记录（调用者持有写锁）
+  * 
+  * 取出的记录如果在入轮之后又被重置，过期时间已经推后，重新放入时间轮
+  * 
+  * @param shard 分片
+  * @param now 当前时间
+  * @param budget 最多处理的记录数和格数，用完时下次继续
   */
- static log_record_t *find_or_create_record(const char *content, size_t content_len) {
-     unsigned int hash = hash_string(content, content_len);
-     log_record_t *record = filter_state.hash_table[hash];
-     
-     /* 在链表中查找记录 */
-     while (record) {
-         if (record->content_len == content_len && 
-             memcmp(record->content, content, content_len) == 0) {
-             return record; /* 找到匹配的记录 */
+ static void sweep_shard(filter_shard_t *shard, time_t now, size_t budget) {
+     long long now_tick = (long long)now / FILTER_WHEEL_TICK;
+     
+     /* 一格的时间完全过去之后才处理，格中的记录此时都已到达入轮时的过期时间 */
+     while (shard->wheel_tick < now_tick && budget > 0) {
+         log_record_t **head = &shard->wheel[shard->wheel_tick % FILTER_WHEEL_SIZE];
+         
+         while (*head && budget > 0) {
+             log_record_t *record = *head;
+             time_t deadline = record_deadline(record);
+             
+             *head = record->wheel_next;
+             budget--;
+             
+             if (now >= deadline) {
+                 remove_record(shard, record);
+             } else {
+                 wheel_insert(shard, record, deadline);
+             }
+         }
+         
+         if (*head) {
+             break; /* 本格还没处理完 */
+         }
+         shard->wheel_tick++;
+         if (budget > 0) {
+             budget--;
          }
-         record = record->next;
      }
      
-     /* 未找到匹配记录，创建新记录 */
+     /* 全部处理完时等到下一格结束再来；否则下次检查时继续 */
+     if (shard->wheel_tick >= now_tick) {
+         atomic_store_explicit(&shard->sweep_after, (shard->wheel_tick + 1) * FILTER_WHEEL_TICK,
+                               memory_order_relaxed);
+     }
+ }
+ 
+ /**
+  * @brief 需要时顺带清理分片中的过期记录，获取不到写锁时跳过，不会等待
+  * 
+  * @param shard 分片
+  * @param now 当前时间
+  */
+ static void maybe_sweep_shard(filter_shard_t *shard, time_t now) {
+     if ((long long)now < atomic_load_explicit(&shard->sweep_after, memory_order_relaxed)) {
+         return;
+     }
+     
+     if (pthread_rwlock_trywrlock(&shard->lock) != 0) {
+         return;
+     }
+     sweep_shard(shard, now, FILTER_SWEEP_BUDGET);
+     pthread_rwlock_unlock(&shard->lock);
+ }
+ 
+ /**
+  * @brief 创建日志记录并放入分片（调用者持有写锁且已确认记录不存在）
+  * 
+  * @param shard 分片
+  * @param hash 哈希值
+  * @param tag 附加键
+  * @param content 日志内容
+  * @param content_len 日志内容长度
+  * @param now 当前时间
+  * @return 日志记录指针，失败返回NULL
+  */
+ static log_record_t *insert_record(filter_shard_t *shard, uint64_t hash, unsigned int tag,
+                                    const char *content, size_t content_len, time_t now) {
+     log_record_t *record;
+     size_t pos;
+     
+     /* 装载因子（包括已删除的槽位）超过7/8时扩容或重建 */
+     if ((shard->used + 1) * 8 > shard->capacity * 7 && grow_table(shard) != 0) {
+         return NULL;
+     }
+     
      record = (log_record_t *)malloc(sizeof(log_record_t));
      if (!record) {
          perror("malloc failed for log_record");
@@ -83,193 +542,525 @@
      }
      
      /* 申请内存保存日志内容 */
-     record->content = (char *)malloc(content_len + 1);
-     if (!record->content) {
-         perror("malloc failed for log content");
-         free(record);
-         return NULL;
+     record->content = NULL;
+     if (filter_state.store_content) {
+         record->content = (char *)malloc(content_len + 1);
+         if (!record->content) {
+             perror("malloc failed for log content");
+             free(record);
+             return NULL;
+         }
+         memcpy(record->content, content, content_len);
+         record->content[content_len] = '\0';
      }
      
      /* 初始化新记录 */
-     memcpy(record->content, content, content_len);
-     record->content[content_len] = '\0';
+     record->hash = hash;
      record->content_len = content_len;
-     record->first_time = time(NULL);
-     record->last_time = record->first_time;
-     record->count_total = 0; /* 初始化为0，在filter_check中增加 */
-     record->count_last_min = 0;
-     record->last_min_start = record->first_time;
-     record->is_massive = false;
+     record->tag = tag;
+     atomic_init(&record->first_time, now);
+     atomic_init(&record->last_time, now);
+     atomic_init(&record->count_total, 0); /* 初始化为0，在filter_check中增加 */
+     atomic_init(&record->count_last_min, 0);
+     atomic_init(&record->last_min_start, now);
+     atomic_init(&record->is_massive, false);
+     atomic_init(&record->suppressed, 0);
      
-     /* 将新记录插入链表头部 */
-     record->next = filter_state.hash_table[hash];
-     filter_state.hash_table[hash] = record;
+     /* 放入第一个可插入的槽位 */
+     pos = find_free_slot(shard->ctrl, shard->capacity, hash);
+     if (shard->ctrl[pos] == CTRL_EMPTY) {
+         shard->used++;
+     }
+     shard->ctrl[pos] = (unsigned char)(hash & 0x7f);
+     shard->slots[pos].hash = hash;
+     shard->slots[pos].record = record;
+     shard->count++;
+     
+     wheel_insert(shard, record, record_deadline(record));
+     
+     return record;
+ }
+ 
+ /**
+  * @brief 在哈希表中查找或创建日志记录，返回时持有记录所在分片的锁
+  * 
+  * 先在读锁下查找，不存在时加写锁再查找一次并创建。过期记录只在写锁下删除，
+  * 调用者在使用完记录之后解锁
+  * 
+  * @param tag 附加键
+  * @param content 日志内容
+  * @param content_len 日志内容长度
+  * @param now 当前时间
+  * @param shard_out 输出参数，记录所在的分片
+  * @return 日志记录指针，如果是新创建的，则需要初始化；失败返回NULL，此时不持有锁
+  */
+ static log_record_t *acquire_record(unsigned int tag, const char *content, size_t content_len,
+                                     time_t now, filter_shard_t **shard_out) {
+     uint64_t hash = hash_string(tag, content, content_len);
+     filter_shard_t *shard = &filter_state.shards[hash >> (64 - FILTER_SHARD_BITS)];
+     log_record_t *record;
+     
+     /* 每次检查顺带清理少量过期记录 */
+     maybe_sweep_shard(shard, now);
+     *shard_out = shard;
+     
+     pthread_rwlock_rdlock(&shard->lock);
+     record = find_record(shard, hash, tag, content, content_len);
+     if (record) {
+         return record;
+     }
+     pthread_rwlock_unlock(&shard->lock);
+     
+     /* 未找到匹配记录，其他线程可能同时在创建，持有写锁后再查一次 */
+     pthread_rwlock_wrlock(&shard->lock);
+     record = find_record(shard, hash, tag, content, content_len);
+     if (!record) {
+         record = insert_record(shard, hash, tag, content, content_len, now);
+     }
+     if (!record) {
+         pthread_rwlock_unlock(&shard->lock);
+     }
      
      return record;
  }
  
  /**
-  * @brief 清理日志记录，释放内存
+  * @brief 清理日志记录，释放内存并销毁分片的锁
   */
  static void clean_records(void) {
-     for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-         log_record_t *record = filter_state.hash_table[i];
-         while (record) {
-             log_record_t *next = record->next;
-             if (record->content) {
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         filter_shard_t *shard = &filter_state.shards[i];
+         
+         for (size_t j = 0; j < shard->capacity; j++) {
+             if (!(shard->ctrl[j] & 0x80)) {
+                 log_record_t *record = shard->slots[j].record;
                  free(record->content);
+                 free(record);
              }
-             free(record);
-             record = next;
          }
-         filter_state.hash_table[i] = NULL;
+         
+         free(shard->ctrl);
+         free(shard->slots);
+         shard->ctrl = NULL;
+         shard->slots = NULL;
+         shard->capacity = 0;
+         shard->count = 0;
+         shard->used = 0;
+         memset(shard->wheel, 0, sizeof(shard->wheel));
+         pthread_rwlock_destroy(&shard->lock);
      }
  }
+ /**
+  * @brief 更新记录的最近一分钟计数
+  * 
+  * 超过一分钟时只有一个线程能重置计数窗口
+  * 
+  * @param record 日志记录
+  * @param now 当前时间
+  * @param window_reset 输出参数，是否开始了新的一分钟
+  * @return 更新后最近一分钟的出现次数
+  */
+ static unsigned int update_minute_count(log_record_t *record, time_t now, bool *window_reset) {
+     long long start = atomic_load_explicit(&record->last_min_start, memory_order_relaxed);
+     
+     if (now - start >= 60 &&
+         atomic_compare_exchange_strong(&record->last_min_start, &start, (long long)now)) {
+         atomic_store_explicit(&record->count_last_min, 1, memory_order_relaxed);
+         *window_reset = true;
+         return 1;
+     }
+     
+     *window_reset = false;
+     return atomic_fetch_add_explicit(&record->count_last_min, 1, memory_order_relaxed) + 1;
+ }
+ 
+ /**
+  * @brief 超过一小时后重置记录，只有一个线程能重置成功
+  * 
+  * @param record 日志记录
+  * @param first_time 读到的首次出现时间
+  * @param now 当前时间
+  * @return 重置成功返回true
+  */
+ static bool reset_record(log_record_t *record, long long first_time, time_t now) {
+     if (!atomic_compare_exchange_strong(&record->first_time, &first_time, (long long)now)) {
+         return false;
+     }
+     
+     atomic_store(&record->count_total, 1);
+     atomic_store(&record->count_last_min, 1);
+     atomic_store(&record->last_min_start, (long long)now);
+     atomic_store(&record->is_massive, false);
+     return true;
+ }
  
  int filter_init(void) {
+     return filter_init_ex(true);
+ }
+ 
+ int filter_init_ex(bool store_content) {
+     long long now_tick = (long long)time(NULL) / FILTER_WHEEL_TICK;
+     
      /* 已经初始化则直接返回 */
-     if (filter_state.initialized) {
+     if (atomic_load(&filter_state.initialized)) {
          return 0;
      }
      
-     /* 初始化哈希表 */
-     memset(filter_state.hash_table, 0, sizeof(filter_state.hash_table));
-     filter_state.initialized = true;
+     /* 初始化各个分片 */
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         pthread_rwlock_init(&filter_state.shards[i].lock, NULL);
+     }
+     
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         filter_shard_t *shard = &filter_state.shards[i];
+         
+         if (alloc_table(FILTER_INITIAL_CAPACITY, &shard->ctrl, &shard->slots) != 0) {
+             clean_records();
+             return -1;
+         }
+         shard->capacity = FILTER_INITIAL_CAPACITY;
+         shard->count = 0;
+         shard->used = 0;
+         shard->wheel_tick = now_tick;
+         atomic_init(&shard->sweep_after, (now_tick + 1) * FILTER_WHEEL_TICK);
+         atomic_init(&shard->filtered_duplicate, 0);
+         atomic_init(&shard->filtered_massive, 0);
+     }
+     
+     filter_state.store_content = store_content;
+     atomic_store(&filter_state.initialized, true);
      
      return 0;
  }
  
  void filter_destroy(void) {
-     if (!filter_state.initialized) {
+     if (!atomic_load(&filter_state.initialized)) {
          return;
      }
      
+     atomic_store(&filter_state.initialized, false);
      clean_records();
-     filter_state.initialized = false;
+ }
+ 
+ void filter_expire(time_t now) {
+     if (!atomic_load(&filter_state.initialized)) {
+         return;
+     }
+     
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         filter_shard_t *shard = &filter_state.shards[i];
+         
+         pthread_rwlock_wrlock(&shard->lock);
+         sweep_shard(shard, now, SIZE_MAX);
+         pthread_rwlock_unlock(&shard->lock);
+     }
+ }
+ 
+ size_t filter_record_count(void) {
+     size_t count = 0;
+     
+     if (!atomic_load(&filter_state.initialized)) {
+         return 0;
+     }
+     
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         filter_shard_t *shard = &filter_state.shards[i];
+         
+         pthread_rwlock_rdlock(&shard->lock);
+         count += shard->count;
+         pthread_rwlock_unlock(&shard->lock);
+     }
+     
+     return count;
  }
  
  /**
-  * @brief 检查日志是否为海量日志或重复日志，并决定是否过滤
+  * @brief 计算槽位所在的组距离哈希值对应的第一个组的探测步数
   * 
-  * @param log_content 日志内容
-  * @param log_len 日志内容长度
-  * @param filter_mode 是否开启过滤模式
-  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  * @param capacity 槽位数
+  * @param hash 哈希值
+  * @param pos 槽位下标
+  * @return 探测过的组数（从1开始）
   */
- bool filter_check_massive(const char *log_content, size_t log_len) {
-     time_t now;
-     log_record_t *record;
+ static size_t probe_length(size_t capacity, uint64_t hash, size_t pos) {
+     size_t group_mask = capacity / FILTER_GROUP_SIZE - 1;
+     size_t group = (hash >> 7) & group_mask;
+     size_t target = pos / FILTER_GROUP_SIZE;
+     size_t step = 1;
      
-     if (!filter_state.initialized || !log_content || log_len == 0) {
-         return false; /* 不过滤 */
+     /* 与 find_free_slot 相同的三角数探测，组数为2的幂时一定能到达 */
+     while (group != target) {
+         group = (group + step) & group_mask;
+         step++;
      }
      
-     now = time(NULL);
+     return step;
+ }
+ 
+ void filter_get_stats(filter_stats_t *stats) {
+     memset(stats, 0, sizeof(*stats));
      
-     /* 查找或创建日志记录 */
-     record = find_or_create_record(log_content, log_len);
-     if (!record) {
-         return false; /* 创建记录失败，不过滤 */
+     if (!atomic_load(&filter_state.initialized)) {
+         return;
      }
      
-     /* 更新计数和时间 */
-     record->count_total++;
-     record->last_time = now;
-     
-     /* 更新最近一分钟计数器 */
-     if (now - record->last_min_start >= 60) {
-         /* 重置一分钟计数 */
-         record->count_last_min = 1;
-         record->last_min_start = now;
-     } else {
-         record->count_last_min++;
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         filter_shard_t *shard = &filter_state.shards[i];
          
-         /* 检查是否达到海量日志阈值 (1分钟内>=60条) */
-         if (record->count_last_min >= 60 && !record->is_massive) {
-             /* 首次检测到海量日志，标记并允许打印一条提示 */
-             record->is_massive = true;
-             return false; /* 打印一条提示日志 */
+         pthread_rwlock_rdlock(&shard->lock);
+         stats->records += shard->count;
+         stats->capacity += shard->capacity;
+         stats->memory_bytes += shard->capacity * (1 + sizeof(filter_slot_t)) +
+                                shard->count * sizeof(log_record_t);
+         for (size_t pos = 0; pos < shard->capacity; pos++) {
+             if (!(shard->ctrl[pos] & 0x80)) {
+                 size_t probe = probe_length(shard->capacity, shard->slots[pos].hash, pos);
+                 if (probe > stats->max_probe) {
+                     stats->max_probe = probe;
+                 }
+                 if (shard->slots[pos].record->content) {
+                     stats->memory_bytes += shard->slots[pos].record->content_len + 1;
+                 }
+             }
+         }
+         pthread_rwlock_unlock(&shard->lock);
+         
+         stats->filtered_duplicate += atomic_load_explicit(&shard->filtered_duplicate, memory_order_relaxed);
+         stats->filtered_massive += atomic_load_explicit(&shard->filtered_massive, memory_order_relaxed);
+     }
+     stats->memory_bytes += sizeof(filter_state);
+ }
+ 
+ /**
+  * @brief 收集分片中一批被过滤过的记录并清零其计数（持有读锁）
+  * 
+  * @param shard 分片
+  * @param pos 输入输出参数，开始扫描的槽位下标
+  * @param batch 输出缓冲区，至少 FILTER_REPORT_BATCH 项
+  * @param done 输出参数，是否已经扫描完整个分片
+  * @return 收集的记录数
+  */
+ static size_t collect_batch(filter_shard_t *shard, size_t *pos, report_entry_t *batch, bool *done) {
+     size_t n = 0;
+     
+     pthread_rwlock_rdlock(&shard->lock);
+     while (*pos < shard->capacity && n < FILTER_REPORT_BATCH) {
+         if (!(shard->ctrl[*pos] & 0x80)) {
+             log_record_t *record = shard->slots[*pos].record;
+             unsigned int count = atomic_exchange_explicit(&record->suppressed, 0, memory_order_relaxed);
+             
+             if (count > 0) {
+                 report_entry_t *entry = &batch[n++];
+                 entry->tag = record->tag;
+                 entry->fingerprint = record->hash;
+                 entry->count = count;
+                 entry->has_content = record->content != NULL;
+                 entry->len = 0;
+                 if (record->content) {
+                     entry->len = record->content_len < FILTER_REPORT_TEXT ?
+                                  record->content_len : FILTER_REPORT_TEXT;
+                     memcpy(entry->text, record->content, entry->len);
+                 }
+             }
          }
+         (*pos)++;
+     }
+     *done = *pos >= shard->capacity;
+     pthread_rwlock_unlock(&shard->lock);
+     
+     return n;
+ }
+ 
+ void filter_report_suppressed(filter_report_fn report, void *arg) {
+     report_entry_t *batch;
+     
+     if (!atomic_load(&filter_state.initialized)) {
+         return;
+     }
+     
+     batch = (report_entry_t *)malloc(FILTER_REPORT_BATCH * sizeof(report_entry_t));
+     if (!batch) {
+         perror("malloc failed for filter report");
+         return;
+     }
+     
+     /* 分批持锁收集，回调在锁外进行；扫描期间分片被重建时本轮可能漏掉少数记录，计数留到下一轮 */
+     for (int i = 0; i < FILTER_SHARD_COUNT; i++) {
+         filter_shard_t *shard = &filter_state.shards[i];
+         size_t pos = 0;
+         bool done;
+         
+         do {
+             size_t n = collect_batch(shard, &pos, batch, &done);
+             
+             for (size_t j = 0; j < n; j++) {
+                 report(batch[j].tag, batch[j].has_content ? batch[j].text : NULL, batch[j].len,
+                        batch[j].fingerprint, batch[j].count, arg);
+             }
+         } while (!done);
+     }
+     
+     free(batch);
+ }
+ 
+ /**
+  * @brief 海量日志判断（调用者持有记录所在分片的锁）
+  * 
+  * @param record 日志记录
+  * @param now 当前时间
+  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  */
+ static bool decide_massive(log_record_t *record, time_t now) {
+     bool window_reset;
+     unsigned int count_last_min;
+     long long first_time;
+     
+     /* 更新计数和时间 */
+     atomic_fetch_add_explicit(&record->count_total, 1, memory_order_relaxed);
+     atomic_store_explicit(&record->last_time, (long long)now, memory_order_relaxed);
+     
+     /* 更新最近一分钟计数器，检查是否达到海量日志阈值 (1分钟内>=60条) */
+     count_last_min = update_minute_count(record, now, &window_reset);
+     if (!window_reset && count_last_min >= 60 && !atomic_exchange(&record->is_massive, true)) {
+         /* 首次检测到海量日志，标记并允许打印一条提示 */
+         return false; /* 打印一条提示日志 */
      }
      
      /* 检查是否是已标记的海量日志 */
-     if (record->is_massive) {
+     if (atomic_load(&record->is_massive)) {
          /* 检查是否超过一小时需要重置 */
-         if (now - record->first_time >= 3600) {
-             /* 超过一小时，重置记录 */
-             record->first_time = now;
-             record->count_total = 1;
-             record->count_last_min = 1;
-             record->last_min_start = now;
-             record->is_massive = false;
+         first_time = atomic_load(&record->first_time);
+         if (now - first_time >= 3600 && reset_record(record, first_time, now)) {
              return false; /* 重置后不过滤 */
          }
          
          /* 是海量日志且在一小时内，应该过滤 */
+         atomic_fetch_add_explicit(&record->suppressed, 1, memory_order_relaxed);
          return true;
      }
      
      return false; /* 不是海量日志，不过滤 */
  }
-
- bool filter_check(const char *log_content, size_t log_len) {
+ 
+ /**
+  * @brief 重复日志和海量日志判断（调用者持有记录所在分片的锁）
+  * 
+  * @param record 日志记录
+  * @param now 当前时间
+  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  */
+ static bool decide_repeat(log_record_t *record, time_t now) {
+     bool window_reset;
+     unsigned int count_total;
+     unsigned int count_last_min;
+     long long first_time;
+     
+     /* 更新计数和时间 */
+     count_total = atomic_fetch_add_explicit(&record->count_total, 1, memory_order_relaxed) + 1;
+     atomic_store_explicit(&record->last_time, (long long)now, memory_order_relaxed);
+     
+     /* 更新最近一分钟计数器 */
+     count_last_min = update_minute_count(record, now, &window_reset);
+     
+     /* 检查是否是首次出现，并发时只有一个线程看到计数为1 */
+     if (count_total == 1) {
+         /* 首次出现，不过滤 */
+         return false;
+     }
+     
+     /* 检查是否是重复日志（计数>1且在一小时内） */
+     first_time = atomic_load(&record->first_time);
+     if ((now - first_time) < 3600) {
+         /* 检查是否达到海量日志阈值，只有一个线程能完成标记 */
+         if (count_last_min >= 60 && !atomic_exchange(&record->is_massive, true)) {
+             /* 第一次检测到海量日志时允许打印一条警告 */
+             return false;
+         }
+         
+         /* 一小时内的重复日志（包括已经警告过的海量日志），应该过滤 */
+         atomic_fetch_add_explicit(&record->suppressed, 1, memory_order_relaxed);
+         return true;
+     }
+     
+     /* 超过一小时，重置记录；同时重置的其他线程视为重复日志 */
+     if (reset_record(record, first_time, now)) {
+         return false;
+     }
+     atomic_fetch_add_explicit(&record->suppressed, 1, memory_order_relaxed);
+     return true;
+ }
+ 
+ /**
+  * @brief 检查日志是否为海量日志或重复日志，并决定是否过滤
+  * 
+  * @param tag 附加键
+  * @param log_content 日志内容
+  * @param log_len 日志内容长度
+  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  */
+ bool filter_check_massive_ex(unsigned int tag, const char *log_content, size_t log_len) {
      time_t now;
      log_record_t *record;
+     filter_shard_t *shard;
+     bool should_filter;
      
-     if (!filter_state.initialized || !log_content || log_len == 0) {
+     if (!atomic_load_explicit(&filter_state.initialized, memory_order_acquire) ||
+         !log_content || log_len == 0) {
          return false; /* 不过滤 */
      }
      
      now = time(NULL);
      
      /* 查找或创建日志记录 */
-     record = find_or_create_record(log_content, log_len);
+     record = acquire_record(tag, log_content, log_len, now, &shard);
      if (!record) {
          return false; /* 创建记录失败，不过滤 */
      }
      
-     /* 更新计数和时间 */
-     record->count_total++;
-     record->last_time = now;
+     should_filter = decide_massive(record, now);
+     if (should_filter) {
+         atomic_fetch_add_explicit(&shard->filtered_massive, 1, memory_order_relaxed);
+     }
+     pthread_rwlock_unlock(&shard->lock);
      
-     /* 更新最近一分钟计数器 */
-     if (now - record->last_min_start >= 60) {
-         record->count_last_min = 1;
-         record->last_min_start = now;
-     } else {
-         record->count_last_min++;
+     return should_filter;
+ }
+ 
+ bool filter_check_massive(const char *log_content, size_t log_len) {
+     return filter_check_massive_ex(0, log_content, log_len);
+ }
+ 
+ bool filter_check(const char *log_content, size_t log_len) {
+     return filter_check_ex(0, log_content, log_len);
+ }
+ 
+ bool filter_check_ex(unsigned int tag, const char *log_content, size_t log_len) {
+     time_t now;
+     log_record_t *record;
+     filter_shard_t *shard;
+     bool should_filter;
+     
+     if (!atomic_load_explicit(&filter_state.initialized, memory_order_acquire) ||
+         !log_content || log_len == 0) {
+         return false; /* 不过滤 */
      }
      
-     /* 检查是否是首次出现 */
-     if (record->count_total == 1) {
-         /* 首次出现，不过滤 */
-         return false;
+     now = time(NULL);
+     
+     /* 查找或创建日志记录 */
+     record = acquire_record(tag, log_content, log_len, now, &shard);
+     if (!record) {
+         return false; /* 创建记录失败，不过滤 */
      }
      
-     /* 检查是否是重复日志（计数>1且在一小时内） */
-     if ((now - record->first_time) < 3600) {
-         /* 检查是否达到海量日志阈值 */
-         if (record->count_last_min >= 60 && !record->is_massive) {
-             record->is_massive = true;
-             /* 第一次检测到海量日志时允许打印一条警告 */
-             return false;
-         }
-         
-         /* 如果是海量日志且已经警告过，继续过滤 */
-         if (record->is_massive) {
-             return true;
-         }
-         
-         /* 一小时内的重复日志，应该过滤 */
-         return true;
-     } else {
-         /* 超过一小时，重置记录 */
-         record->first_time = now;
-         record->last_time = now;
-         record->count_total = 1;
-         record->count_last_min = 1;
-         record->last_min_start = now;
-         record->is_massive = false;
-         return false; /* 不过滤 */
+     should_filter = decide_repeat(record, now);
+     if (should_filter) {
+         /* 已标记为海量日志的重复日志计为海量日志 */
+         atomic_fetch_add_explicit(atomic_load_explicit(&record->is_massive, memory_order_relaxed) ?
+                                   &shard->filtered_massive : &shard->filtered_duplicate,
+                                   1, memory_order_relaxed);
      }
- }
\ No newline at end of file
+     pthread_rwlock_unlock(&shard->lock);
+     
+     return should_filter;
+ }
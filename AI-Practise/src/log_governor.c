@@ -0,0 +1,118 @@
+/**
+ * @file log_governor.c
+ * @brief 日志流量控制实现
+ *
+ * GCRA 算法与令牌桶等价：每个维度保存"理论到达时间" tat，每写出一个单位 tat 前进
+ * 固定的时间；tat 超出当前时间的部分就是已经用掉的令牌，超过令牌桶容量时拒绝
+ */
+ 
+ #include "log_governor.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <time.h>
+ #include <stdatomic.h>
+ 
+ struct log_governor {
+     long long burst_ns;           /* 令牌桶容量（纳秒） */
+     size_t bytes_per_sec;         /* 每秒字节数，0表示不限制 */
+     long long record_cost_ns;     /* 每条日志占用的时间，0表示不限制 */
+     atomic_llong byte_tat;        /* 字节维度的理论到达时间 */
+     atomic_llong record_tat;      /* 条数维度的理论到达时间 */
+ };
+ 
+ /**
+  * @brief 获取单调时钟（纳秒）
+  *
+  * @return 纳秒数
+  */
+ static long long monotonic_ns(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+ }
+ 
+ /**
+  * @brief 在一个维度上扣除令牌
+  *
+  * @param tat 理论到达时间
+  * @param now 当前时间
+  * @param cost 本次占用的时间
+  * @param limit 允许的最大欠账（纳秒）
+  * @param force 是否总是允许
+  * @return 允许返回true
+  */
+ static bool cell_admit(atomic_llong *tat, long long now, long long cost, long long limit, bool force) {
+     long long old = atomic_load_explicit(tat, memory_order_relaxed);
+     
+     for (;;) {
+         long long next = (old > now ? old : now) + cost;
+         
+         if (next - now > limit) {
+             if (!force) {
+                 return false;
+             }
+             /* 总是允许的日志最多把令牌桶用空，不会无限透支 */
+             next = now + limit;
+             if (next <= old) {
+                 return true;
+             }
+         }
+         
+         if (atomic_compare_exchange_weak_explicit(tat, &old, next, memory_order_relaxed,
+                                                   memory_order_relaxed)) {
+             return true;
+         }
+     }
+ }
+ 
+ log_governor_t *log_governor_create(size_t bytes_per_sec, unsigned int records_per_sec,
+                                     unsigned int burst_ms) {
+     log_governor_t *gov = calloc(1, sizeof(log_governor_t));
+     
+     if (!gov) {
+         perror("calloc failed for log governor");
+         return NULL;
+     }
+     
+     gov->burst_ns = (long long)burst_ms * 1000000LL;
+     gov->bytes_per_sec = bytes_per_sec;
+     if (records_per_sec > 0) {
+         gov->record_cost_ns = 1000000000LL / records_per_sec;
+         if (gov->record_cost_ns == 0) {
+             gov->record_cost_ns = 1;
+         }
+     }
+     atomic_init(&gov->byte_tat, 0);
+     atomic_init(&gov->record_tat, 0);
+     
+     return gov;
+ }
+ 
+ bool log_governor_admit(log_governor_t *gov, size_t bytes, int reserve_pct) {
+     long long now = monotonic_ns();
+     bool force = reserve_pct < 0;
+     long long limit = force ? gov->burst_ns : gov->burst_ns / 100 * (100 - reserve_pct);
+     long long byte_cost;
+     
+     if (gov->record_cost_ns > 0 &&
+         !cell_admit(&gov->record_tat, now, gov->record_cost_ns, limit, force)) {
+         return false;
+     }
+     
+     if (gov->bytes_per_sec > 0) {
+         byte_cost = (long long)((unsigned long long)bytes * 1000000000ULL / gov->bytes_per_sec);
+         if (!cell_admit(&gov->byte_tat, now, byte_cost, limit, force)) {
+             /* 退还条数维度已经扣除的令牌 */
+             if (gov->record_cost_ns > 0) {
+                 atomic_fetch_sub_explicit(&gov->record_tat, gov->record_cost_ns, memory_order_relaxed);
+             }
+             return false;
+         }
+     }
+     
+     return true;
+ }
+ 
+ void log_governor_destroy(log_governor_t *gov) {
+     free(gov);
+ }
@@ -0,0 +1,380 @@
+/**
+ * @file log_index.c
+ * @brief 日志文件时间索引实现
+ *
+ * 每条日志的第一行以时间戳开头（JSON 格式为 {"time":"..."}），因此不必逐行扫描：
+ * 从任意偏移跳到下一个行首，就能读出该处的时间。建立索引时按文件大小均匀抽样至多
+ * INDEX_MAX_ENTRIES 个点，只读取抽样点附近的页；查询时在两个抽样点之间继续按字节二分，
+ * 直到剩余范围很小，再顺序扫描输出。不以时间戳开头的行视为上一条日志的后续行
+ */
+ 
+ #include "log_index.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdbool.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ 
+ /* 抽样点个数的上限 */
+ #define INDEX_MAX_ENTRIES 1024
+ /* 抽样的最小间隔（字节） */
+ #define INDEX_MIN_STRIDE (64 * 1024)
+ /* 剩余范围小于此字节数时停止二分，改为顺序扫描 */
+ #define INDEX_SCAN_BYTES 4096
+ /* 时间戳 "YYYY-MM-DD HH:MM:SS.mmm" 的长度 */
+ #define TIME_TEXT_LEN 23
+ /* JSON 格式日志的开头 */
+ #define JSON_TIME_PREFIX "{\"time\":\""
+ /* JSON 格式中时间戳与级别之间的内容 */
+ #define JSON_LEVEL_PREFIX "\",\"level\":\""
+ 
+ /* 索引的一个抽样点 */
+ typedef struct {
+     long long time_ms;          /* 日志的时间 */
+     size_t offset;              /* 日志第一行在文件中的偏移 */
+ } index_entry_t;
+ 
+ struct log_index {
+     const char *data;           /* 映射的文件内容 */
+     size_t size;                /* 文件大小 */
+     index_entry_t *entries;     /* 按偏移递增的抽样点 */
+     size_t count;               /* 抽样点个数 */
+ };
+ 
+ /* 日志级别对应的字符串表示 */
+ static const char *level_names[] = { "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+ 
+ /**
+  * @brief 计算公历日期距1970-01-01的天数
+  *
+  * @param y 年
+  * @param m 月（1-12）
+  * @param d 日（1-31）
+  * @return 天数
+  */
+ static long long days_from_civil(int y, int m, int d) {
+     long long era;
+     unsigned int yoe, doy, doe;
+     
+     /* 以3月为一年的开始，闰日落在一年的最后 */
+     y -= m <= 2;
+     era = (y >= 0 ? y : y - 399) / 400;
+     yoe = (unsigned int)(y - era * 400);
+     doy = (unsigned int)((153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1);
+     doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+     return era * 146097 + (long long)doe - 719468;
+ }
+ 
+ /**
+  * @brief 解析固定位数的十进制数
+  *
+  * @param p 字符串
+  * @param n 位数
+  * @param out 输出参数，数值
+  * @return 成功返回0，含有非数字字符返回-1
+  */
+ static int parse_digits(const char *p, int n, int *out) {
+     int value = 0;
+     
+     for (int i = 0; i < n; i++) {
+         if (p[i] < '0' || p[i] > '9') {
+             return -1;
+         }
+         value = value * 10 + (p[i] - '0');
+     }
+     
+     *out = value;
+     return 0;
+ }
+ 
+ int log_index_parse_time(const char *text, size_t len, long long *ms) {
+     int year, mon, day, hour, min, sec;
+     int milli = 0;
+     
+     if (len != 19 && len != TIME_TEXT_LEN) {
+         return -1;
+     }
+     if (parse_digits(text, 4, &year) != 0 || text[4] != '-' ||
+         parse_digits(text + 5, 2, &mon) != 0 || text[7] != '-' ||
+         parse_digits(text + 8, 2, &day) != 0 || (text[10] != ' ' && text[10] != 'T') ||
+         parse_digits(text + 11, 2, &hour) != 0 || text[13] != ':' ||
+         parse_digits(text + 14, 2, &min) != 0 || text[16] != ':' ||
+         parse_digits(text + 17, 2, &sec) != 0) {
+         return -1;
+     }
+     if (len == TIME_TEXT_LEN && (text[19] != '.' || parse_digits(text + 20, 3, &milli) != 0)) {
+         return -1;
+     }
+     if (mon < 1 || mon > 12 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 60) {
+         return -1;
+     }
+     
+     *ms = (((days_from_civil(year, mon, day) * 24 + hour) * 60 + min) * 60 + sec) * 1000 + milli;
+     return 0;
+ }
+ 
+ /**
+  * @brief 解析一行开头的时间戳和级别
+  *
+  * @param line 行的内容
+  * @param len 行的长度
+  * @param time_ms 输出参数，日志的时间
+  * @param level 输出参数，日志级别，无法识别时为-1
+  * @return 是一条日志的第一行返回true，否则返回false
+  */
+ static bool parse_record(const char *line, size_t len, long long *time_ms, int *level) {
+     const char *level_prefix = " [";
+     char level_end = ']';
+     
+     if (len > sizeof(JSON_TIME_PREFIX) - 1 && memcmp(line, JSON_TIME_PREFIX, sizeof(JSON_TIME_PREFIX) - 1) == 0) {
+         line += sizeof(JSON_TIME_PREFIX) - 1;
+         len -= sizeof(JSON_TIME_PREFIX) - 1;
+         level_prefix = JSON_LEVEL_PREFIX;
+         level_end = '"';
+     }
+     if (len < TIME_TEXT_LEN || log_index_parse_time(line, TIME_TEXT_LEN, time_ms) != 0) {
+         return false;
+     }
+     line += TIME_TEXT_LEN;
+     len -= TIME_TEXT_LEN;
+     
+     /* 级别紧跟在时间戳之后 */
+     *level = -1;
+     if (len > strlen(level_prefix) && memcmp(line, level_prefix, strlen(level_prefix)) == 0) {
+         line += strlen(level_prefix);
+         len -= strlen(level_prefix);
+         for (int i = 0; i < (int)(sizeof(level_names) / sizeof(level_names[0])); i++) {
+             size_t name_len = strlen(level_names[i]);
+             if (len > name_len && memcmp(line, level_names[i], name_len) == 0 && line[name_len] == level_end) {
+                 *level = i;
+                 break;
+             }
+         }
+     }
+     
+     return true;
+ }
+ 
+ /**
+  * @brief 获取从 pos 开始的一行的长度（包括换行符）
+  *
+  * @param idx 索引
+  * @param pos 行首偏移
+  * @return 行的长度
+  */
+ static size_t line_length(const log_index_t *idx, size_t pos) {
+     const char *nl = memchr(idx->data + pos, '\n', idx->size - pos);
+     
+     return nl ? (size_t)(nl - (idx->data + pos)) + 1 : idx->size - pos;
+ }
+ 
+ /**
+  * @brief 找到偏移 pos 处或之后的第一条日志
+  *
+  * @param idx 索引
+  * @param pos 开始位置，可以在一行的中间
+  * @param time_ms 输出参数，日志的时间
+  * @return 日志第一行的偏移，之后没有日志时返回文件大小
+  */
+ static size_t next_record(const log_index_t *idx, size_t pos, long long *time_ms) {
+     int level;
+     
+     /* 先跳到下一个行首 */
+     if (pos > 0 && pos < idx->size && idx->data[pos - 1] != '\n') {
+         pos += line_length(idx, pos);
+     }
+     
+     while (pos < idx->size) {
+         size_t len = line_length(idx, pos);
+         if (parse_record(idx->data + pos, len, time_ms, &level)) {
+             return pos;
+         }
+         pos += len;
+     }
+     
+     return idx->size;
+ }
+ 
+ /**
+  * @brief 按文件大小均匀抽样建立索引
+  *
+  * @param idx 索引
+  * @return 成功返回0，失败返回-1
+  */
+ static int build_entries(log_index_t *idx) {
+     size_t stride = idx->size / INDEX_MAX_ENTRIES;
+     
+     if (stride < INDEX_MIN_STRIDE) {
+         stride = INDEX_MIN_STRIDE;
+     }
+     
+     idx->entries = malloc((idx->size / stride + 1) * sizeof(index_entry_t));
+     if (!idx->entries) {
+         perror("malloc failed for log index");
+         return -1;
+     }
+     
+     for (size_t pos = 0; pos < idx->size; pos += stride) {
+         long long time_ms;
+         size_t offset = next_record(idx, pos, &time_ms);
+         
+         if (offset >= idx->size) {
+             break;
+         }
+         /* 间隔内没有新的日志时跳过 */
+         if (idx->count > 0 && offset <= idx->entries[idx->count - 1].offset) {
+             continue;
+         }
+         idx->entries[idx->count].time_ms = time_ms;
+         idx->entries[idx->count].offset = offset;
+         idx->count++;
+     }
+     
+     return 0;
+ }
+ 
+ log_index_t *log_index_open(const char *filename) {
+     log_index_t *idx;
+     struct stat st;
+     int fd;
+     
+     fd = open(filename, O_RDONLY);
+     if (fd < 0) {
+         perror("Failed to open log file");
+         return NULL;
+     }
+     if (fstat(fd, &st) != 0) {
+         perror("fstat failed for log file");
+         close(fd);
+         return NULL;
+     }
+     
+     idx = calloc(1, sizeof(log_index_t));
+     if (!idx) {
+         perror("malloc failed for log index");
+         close(fd);
+         return NULL;
+     }
+     
+     idx->size = (size_t)st.st_size;
+     if (idx->size > 0) {
+         void *data = mmap(NULL, idx->size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (data == MAP_FAILED) {
+             perror("mmap failed for log file");
+             free(idx);
+             close(fd);
+             return NULL;
+         }
+         idx->data = data;
+     }
+     close(fd);
+     
+     if (build_entries(idx) != 0) {
+         log_index_close(idx);
+         return NULL;
+     }
+     
+     return idx;
+ }
+ 
+ void log_index_close(log_index_t *idx) {
+     if (!idx) {
+         return;
+     }
+     
+     if (idx->data) {
+         munmap((void *)idx->data, idx->size);
+     }
+     free(idx->entries);
+     free(idx);
+ }
+ 
+ size_t log_index_entries(const log_index_t *idx) {
+     return idx->count;
+ }
+ 
+ /**
+  * @brief 找到开始扫描的位置：其后第一条时间不早于 start_ms 的日志之前的某条日志
+  *
+  * @param idx 索引
+  * @param start_ms 时间下限
+  * @return 开始扫描的偏移
+  */
+ static size_t find_start(const log_index_t *idx, long long start_ms) {
+     size_t left = 0;
+     size_t right = idx->count;
+     size_t lo;
+     size_t hi;
+     
+     /* 在索引中找到第一个时间不早于 start_ms 的抽样点 */
+     while (left < right) {
+         size_t mid = left + (right - left) / 2;
+         if (idx->entries[mid].time_ms < start_ms) {
+             left = mid + 1;
+         } else {
+             right = mid;
+         }
+     }
+     lo = left > 0 ? idx->entries[left - 1].offset : 0;
+     hi = left < idx->count ? idx->entries[left].offset : idx->size;
+     
+     /* 在两个抽样点之间按字节二分，lo 始终是一条早于 start_ms 的日志（或文件开头） */
+     while (hi - lo > INDEX_SCAN_BYTES) {
+         size_t mid = lo + (hi - lo) / 2;
+         long long time_ms;
+         size_t offset = next_record(idx, mid, &time_ms);
+         
+         if (offset < hi && time_ms < start_ms) {
+             lo = offset;
+         } else {
+             hi = mid;
+         }
+     }
+     
+     return lo;
+ }
+ 
+ size_t log_index_query(const log_index_t *idx, long long from_ms, long long to_ms, log_level_t min_level,
+                        log_index_fn fn, void *arg) {
+     size_t pos;
+     size_t record_start = 0;
+     size_t matches = 0;
+     bool matched = false;
+     
+     if (idx->size == 0 || from_ms > to_ms) {
+         return 0;
+     }
+     
+     pos = find_start(idx, from_ms - LOG_INDEX_SKEW_MS);
+     while (pos < idx->size) {
+         size_t len = line_length(idx, pos);
+         long long time_ms;
+         int level;
+         
+         /* 新的一条日志开始时输出上一条（包括其后续行） */
+         if (parse_record(idx->data + pos, len, &time_ms, &level)) {
+             if (matched) {
+                 fn(idx->data + record_start, pos - record_start, arg);
+                 matched = false;
+             }
+             if (time_ms > to_ms + LOG_INDEX_SKEW_MS) {
+                 break;
+             }
+             matched = time_ms >= from_ms && time_ms <= to_ms &&
+                       (level >= 0 ? level >= (int)min_level : min_level == LOG_LEVEL_DEBUG);
+             if (matched) {
+                 matches++;
+                 record_start = pos;
+             }
+         }
+         pos += len;
+     }
+     if (matched) {
+         fn(idx->data + record_start, pos - record_start, arg);
+     }
+     
+     return matches;
+ }
@@ -0,0 +1,348 @@
+/**
+ * @file log_kv.c
+ * @brief 键值日志序列化实现
+ *
+ * 整数逐位写出；浮点数能用6位以内的小数精确还原时逐位写出，否则用 snprintf 写出能还原的最短形式；
+ * 字符串按 JSON 规则转义，文本格式下只有含空格、引号、'='或控制字符时才加引号
+ */
+ 
+ #include "log_kv.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdbool.h>
+ #include <float.h>
+ 
+ /* 写入位置，空间不足时截断并记录 */
+ typedef struct {
+     char *p;      /* 当前写入位置 */
+     char *end;    /* 可写入区域的末尾 */
+     bool full;    /* 是否因空间不足丢弃过内容 */
+ } kv_writer_t;
+ 
+ /**
+  * @brief 写入一段数据，放不下的部分被丢弃
+  *
+  * @param w 写入位置
+  * @param data 数据
+  * @param len 数据长度
+  */
+ static void put(kv_writer_t *w, const char *data, size_t len) {
+     size_t room = (size_t)(w->end - w->p);
+     
+     if (len > room) {
+         len = room;
+         w->full = true;
+     }
+     memcpy(w->p, data, len);
+     w->p += len;
+ }
+ 
+ /**
+  * @brief 把无符号整数写成十进制
+  *
+  * @param buf 输出缓冲区，至少20字节
+  * @param value 整数
+  * @return 写出的字节数
+  */
+ static size_t format_uint(char *buf, unsigned long long value) {
+     char digits[20];
+     size_t len = 0;
+     
+     /* 倒序写入再翻转 */
+     do {
+         digits[len++] = (char)('0' + value % 10);
+         value /= 10;
+     } while (value > 0);
+     for (size_t i = 0; i < len; i++) {
+         buf[i] = digits[len - 1 - i];
+     }
+     return len;
+ }
+ 
+ /**
+  * @brief 写入有符号整数
+  *
+  * @param w 写入位置
+  * @param value 整数
+  */
+ static void put_int(kv_writer_t *w, long long value) {
+     char buf[24];
+     size_t len = 0;
+     unsigned long long magnitude = (unsigned long long)value;
+     
+     if (value < 0) {
+         buf[len++] = '-';
+         magnitude = 0ULL - magnitude;
+     }
+     len += format_uint(buf + len, magnitude);
+     put(w, buf, len);
+ }
+ 
+ /**
+  * @brief 写入浮点数
+  *
+  * JSON 不能表示 NaN 和无穷大，此时写为 null。写出的文本总能解析回原来的值
+  *
+  * @param w 写入位置
+  * @param value 浮点数
+  * @param json 是否按 JSON 规则写出
+  */
+ static void put_double(kv_writer_t *w, double value, bool json) {
+     char buf[40];
+     size_t len = 0;
+     double magnitude = value < 0 ? -value : value;
+     unsigned long long int_part;
+     unsigned long long frac_part = 0;
+     bool exact = false;
+     
+     if (value != value) {
+         put(w, json ? "null" : "nan", json ? 4 : 3);
+         return;
+     }
+     if (magnitude > DBL_MAX) {
+         if (json) {
+             put(w, "null", 4);
+         } else {
+             put(w, value < 0 ? "-inf" : "inf", value < 0 ? 4 : 3);
+         }
+         return;
+     }
+     
+     /* 小于1e9时 int_part * 1e6 + frac_part 小于2^53，转换和除法都只舍入一次，
+        结果与解析6位小数文本得到的值相同，可以据此判断是否丢失精度 */
+     if (magnitude < 1e9) {
+         int_part = (unsigned long long)magnitude;
+         frac_part = (unsigned long long)((magnitude - (double)int_part) * 1e6 + 0.5);
+         if (frac_part >= 1000000) {
+             int_part++;
+             frac_part -= 1000000;
+         }
+         exact = (double)(int_part * 1000000ULL + frac_part) / 1e6 == magnitude;
+     }
+     
+     /* 6位小数不能还原的数值交给 snprintf，从15位有效数字起找能还原的最短形式 */
+     if (!exact) {
+         int ret = 0;
+         for (int precision = 15; precision <= 17; precision++) {
+             ret = snprintf(buf, sizeof(buf), "%.*g", precision, value);
+             if (strtod(buf, NULL) == value) {
+                 break;
+             }
+         }
+         if (ret > 0) {
+             put(w, buf, (size_t)ret < sizeof(buf) ? (size_t)ret : sizeof(buf) - 1);
+         }
+         return;
+     }
+     
+     if (value < 0) {
+         buf[len++] = '-';
+     }
+     len += format_uint(buf + len, int_part);
+     if (frac_part != 0) {
+         buf[len++] = '.';
+         for (int i = 5; i >= 0; i--) {
+             buf[len + (size_t)i] = (char)('0' + frac_part % 10);
+             frac_part /= 10;
+         }
+         len += 6;
+         while (buf[len - 1] == '0') {
+             len--;
+         }
+     }
+     put(w, buf, len);
+ }
+ 
+ /**
+  * @brief 按 JSON 规则转义写入字符串
+  *
+  * 空间不足时不会拆开转义序列，并退回到完整的 UTF-8 字符边界
+  *
+  * @param w 写入位置
+  * @param s 字符串
+  * @param len 字符串长度
+  */
+ static void put_escaped(kv_writer_t *w, const char *s, size_t len) {
+     static const char hex[] = "0123456789abcdef";
+     char *start = w->p;
+     
+     for (size_t i = 0; i < len; i++) {
+         unsigned char c = (unsigned char)s[i];
+         char esc[6];
+         size_t esc_len = 2;
+         
+         esc[0] = '\\';
+         if (c == '"' || c == '\\') {
+             esc[1] = (char)c;
+         } else if (c == '\n') {
+             esc[1] = 'n';
+         } else if (c == '\r') {
+             esc[1] = 'r';
+         } else if (c == '\t') {
+             esc[1] = 't';
+         } else if (c < 0x20) {
+             memcpy(esc + 1, "u00", 3);
+             esc[4] = hex[c >> 4];
+             esc[5] = hex[c & 0xF];
+             esc_len = 6;
+         } else {
+             esc[0] = (char)c;
+             esc_len = 1;
+         }
+         
+         if (esc_len > (size_t)(w->end - w->p)) {
+             w->full = true;
+             /* 去掉被截断的多字节字符 */
+             while (w->p > start && ((unsigned char)w->p[-1] & 0xC0) == 0x80) {
+                 w->p--;
+             }
+             if (w->p > start && (unsigned char)w->p[-1] >= 0xC0) {
+                 w->p--;
+             }
+             return;
+         }
+         put(w, esc, esc_len);
+     }
+ }
+ 
+ /**
+  * @brief 写入带引号的 JSON 字符串
+  *
+  * @param w 写入位置
+  * @param s 字符串
+  * @param len 字符串长度
+  */
+ static void put_json_string(kv_writer_t *w, const char *s, size_t len) {
+     put(w, "\"", 1);
+     put_escaped(w, s, len);
+     put(w, "\"", 1);
+ }
+ 
+ /**
+  * @brief 判断文本格式下字符串值是否需要加引号
+  *
+  * @param s 字符串
+  * @param len 字符串长度
+  * @return 需要加引号返回true
+  */
+ static bool needs_quotes(const char *s, size_t len) {
+     if (len == 0) {
+         return true;
+     }
+     for (size_t i = 0; i < len; i++) {
+         unsigned char c = (unsigned char)s[i];
+         if (c <= ' ' || c == '"' || c == '=' || c == '\\' || c == 0x7F) {
+             return true;
+         }
+     }
+     return false;
+ }
+ 
+ /**
+  * @brief 写入字段值
+  *
+  * @param w 写入位置
+  * @param field 字段
+  * @param json 是否按 JSON 规则写出
+  */
+ static void put_value(kv_writer_t *w, const log_field_t *field, bool json) {
+     switch (field->type) {
+         case LOG_FIELD_INT:
+             put_int(w, field->value.i);
+             break;
+         case LOG_FIELD_DOUBLE:
+             put_double(w, field->value.d, json);
+             break;
+         case LOG_FIELD_STRING:
+             if (json || needs_quotes(field->value.s.ptr, field->value.s.len)) {
+                 put_json_string(w, field->value.s.ptr, field->value.s.len);
+             } else {
+                 put(w, field->value.s.ptr, field->value.s.len);
+             }
+             break;
+         case LOG_FIELD_BOOL:
+             put(w, field->value.b ? "true" : "false", field->value.b ? 4 : 5);
+             break;
+         default:
+             put(w, json ? "null" : "?", json ? 4 : 1);
+             break;
+     }
+ }
+ 
+ size_t log_kv_format_text(char *out, size_t cap, const char *msg,
+                           const log_field_t *fields, size_t count) {
+     kv_writer_t w = { out, out + cap - 1, false };
+     
+     put(&w, msg, strlen(msg));
+     
+     /* 放不下的字段整个丢弃 */
+     for (size_t i = 0; i < count && !w.full; i++) {
+         char *field_start = w.p;
+         
+         put(&w, " ", 1);
+         put(&w, fields[i].key, strlen(fields[i].key));
+         put(&w, "=", 1);
+         put_value(&w, &fields[i], false);
+         if (w.full) {
+             w.p = field_start;
+         }
+     }
+     
+     *w.p = '\0';
+     return (size_t)(w.p - out);
+ }
+ 
+ size_t log_kv_format_json(char *out, size_t cap, const char *time_str, const char *level,
+                           const char *file, int line, const char *func, const char *msg,
+                           size_t msg_len, const log_field_t *fields, size_t count) {
+     kv_writer_t w;
+     
+     if (cap < 3) {
+         return 0;
+     }
+     
+     /* 结尾的 "}\n" 和 '\0' 预先留出 */
+     w.p = out;
+     w.end = out + cap - 3;
+     w.full = false;
+     
+     put(&w, "{\"time\":", 8);
+     put_json_string(&w, time_str, strlen(time_str));
+     put(&w, ",\"level\":", 9);
+     put_json_string(&w, level, strlen(level));
+     put(&w, ",\"file\":", 8);
+     put_json_string(&w, file, strlen(file));
+     put(&w, ",\"line\":", 8);
+     put_int(&w, line);
+     put(&w, ",\"func\":", 8);
+     put_json_string(&w, func, strlen(func));
+     put(&w, ",\"msg\":\"", 8);
+     if (w.full || w.p == w.end) {
+         return 0;
+     }
+     
+     /* 消息可以截断，为结束引号留出一个字节 */
+     w.end--;
+     put_escaped(&w, msg, msg_len);
+     w.end++;
+     put(&w, "\"", 1);
+     
+     /* 放不下的字段整个丢弃 */
+     for (size_t i = 0; i < count && !w.full; i++) {
+         char *field_start = w.p;
+         
+         put(&w, ",", 1);
+         put_json_string(&w, fields[i].key, strlen(fields[i].key));
+         put(&w, ":", 1);
+         put_value(&w, &fields[i], true);
+         if (w.full) {
+             w.p = field_start;
+         }
+     }
+     
+     *w.p++ = '}';
+     *w.p++ = '\n';
+     *w.p = '\0';
+     return (size_t)(w.p - out);
+ }
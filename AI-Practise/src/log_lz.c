@@ -0,0 +1,492 @@
+/**
+ * @file log_lz.c
+ * @brief 日志块压缩实现
+ *
+ * 压缩数据由若干个序列组成，每个序列为“一段字面量 + 一次向前引用”：
+ *   标记字节（高4位字面量长度，低4位匹配长度-4，为15时后跟扩展长度字节）
+ *   字面量  偏移（2字节小端）  匹配长度扩展字节
+ * 最后一个序列只有字面量。匹配查找使用单路哈希表，窗口为64KB，
+ * 日志文本中大量重复的前缀和格式串可以被有效消除
+ */
+ 
+ #define _GNU_SOURCE
+ #include "log_lz.h"
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdint.h>
+ #include <unistd.h>
+ #include <sys/types.h>
+ 
+ /* 最短匹配长度 */
+ #define LZ_MIN_MATCH 4
+ /* 哈希表大小（位数） */
+ #define LZ_HASH_BITS 14
+ /* 最大向前引用距离 */
+ #define LZ_MAX_OFFSET 65535
+ /* 块头中存储长度的最高位：块未压缩 */
+ #define LZ_STORED_FLAG 0x80000000u
+ /* 块头长度 */
+ #define LZ_BLOCK_HEADER_SIZE 8
+ 
+ /* 压缩文件魔数 */
+ static const unsigned char lz_magic[4] = { 'L', 'G', 'Z', '1' };
+ 
+ struct log_lz_reader {
+     FILE *in;                     /* 压缩文件输入流 */
+     unsigned char *comp;          /* 压缩数据缓冲区 */
+     unsigned char *block;         /* 当前块解压后的数据 */
+     size_t block_len;             /* 当前块长度 */
+     size_t block_pos;             /* 当前块已读取的位置 */
+ };
+ 
+ static inline uint32_t read32(const unsigned char *p) {
+     uint32_t v;
+     memcpy(&v, p, sizeof(v));
+     return v;
+ }
+ 
+ static inline uint32_t lz_hash(uint32_t v) {
+     return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+ }
+ 
+ static void put_le32(unsigned char *p, uint32_t v) {
+     p[0] = (unsigned char)v;
+     p[1] = (unsigned char)(v >> 8);
+     p[2] = (unsigned char)(v >> 16);
+     p[3] = (unsigned char)(v >> 24);
+ }
+ 
+ static uint32_t get_le32(const unsigned char *p) {
+     return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+ }
+ 
+ size_t log_lz_bound(size_t len) {
+     return len + len / 255 + 16;
+ }
+ 
+ /**
+  * @brief 写出扩展长度：每个255字节表示再加255，最后一个字节小于255
+  *
+  * @param op 输出位置
+  * @param len 超出15的部分
+  * @return 新的输出位置
+  */
+ static unsigned char *put_length(unsigned char *op, size_t len) {
+     while (len >= 255) {
+         *op++ = 255;
+         len -= 255;
+     }
+     *op++ = (unsigned char)len;
+     return op;
+ }
+ 
+ /**
+  * @brief 写出一个序列
+  *
+  * @param op 输出位置
+  * @param op_end 输出缓冲区末尾
+  * @param lit 字面量
+  * @param lit_len 字面量长度
+  * @param offset 向前引用距离
+  * @param match_len 匹配长度，0表示最后一个序列
+  * @return 新的输出位置，缓冲区不足时返回NULL
+  */
+ static unsigned char *put_sequence(unsigned char *op, unsigned char *op_end,
+                                    const unsigned char *lit, size_t lit_len,
+                                    size_t offset, size_t match_len) {
+     size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+     size_t need = 1 + lit_len / 255 + 1 + lit_len + 2 + ml / 255 + 1;
+     unsigned char *token;
+     
+     if ((size_t)(op_end - op) < need) {
+         return NULL;
+     }
+     
+     token = op++;
+     *token = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+     if (lit_len >= 15) {
+         op = put_length(op, lit_len - 15);
+     }
+     memcpy(op, lit, lit_len);
+     op += lit_len;
+     
+     if (match_len) {
+         *op++ = (unsigned char)offset;
+         *op++ = (unsigned char)(offset >> 8);
+         if (ml >= 15) {
+             op = put_length(op, ml - 15);
+         }
+     }
+     
+     return op;
+ }
+ 
+ size_t log_lz_compress(const void *src, size_t len, void *dst, size_t cap) {
+     const unsigned char *base = src;
+     const unsigned char *ip = base;
+     const unsigned char *anchor = base;
+     const unsigned char *end = base + len;
+     const unsigned char *match_limit = len >= LZ_MIN_MATCH ? end - LZ_MIN_MATCH : base;
+     unsigned char *op = dst;
+     unsigned char *op_end = op + cap;
+     uint32_t table[1 << LZ_HASH_BITS];
+     
+     memset(table, 0, sizeof(table));
+     
+     while (ip < match_limit) {
+         uint32_t seq = read32(ip);
+         uint32_t h = lz_hash(seq);
+         const unsigned char *ref = base + table[h];
+         
+         table[h] = (uint32_t)(ip - base);
+         
+         if (ref < ip && ip - ref <= LZ_MAX_OFFSET && read32(ref) == seq) {
+             const unsigned char *mp = ip + LZ_MIN_MATCH;
+             const unsigned char *rp = ref + LZ_MIN_MATCH;
+             
+             while (mp < end && *mp == *rp) {
+                 mp++;
+                 rp++;
+             }
+             
+             op = put_sequence(op, op_end, anchor, (size_t)(ip - anchor),
+                               (size_t)(ip - ref), (size_t)(mp - ip));
+             if (!op) {
+                 return 0;
+             }
+             ip = anchor = mp;
+         } else {
+             /* 长时间找不到匹配时加大步长，不可压缩的数据也能快速通过 */
+             ip += 1 + ((size_t)(ip - anchor) >> 6);
+         }
+     }
+     
+     op = put_sequence(op, op_end, anchor, (size_t)(end - anchor), 0, 0);
+     return op ? (size_t)(op - (unsigned char *)dst) : 0;
+ }
+ 
+ /**
+  * @brief 读取扩展长度
+  *
+  * @param ip 输入位置，读取后前移
+  * @param end 输入末尾
+  * @param len 输出参数，累加扩展长度
+  * @return 成功返回0，数据不完整返回-1
+  */
+ static int get_length(const unsigned char **ip, const unsigned char *end, size_t *len) {
+     unsigned char b;
+     
+     do {
+         if (*ip >= end) {
+             return -1;
+         }
+         b = *(*ip)++;
+         *len += b;
+     } while (b == 255);
+     
+     return 0;
+ }
+ 
+ long log_lz_decompress(const void *src, size_t len, void *dst, size_t cap) {
+     const unsigned char *ip = src;
+     const unsigned char *end = ip + len;
+     unsigned char *op = dst;
+     unsigned char *op_start = dst;
+     unsigned char *op_end = op + cap;
+     
+     while (ip < end) {
+         unsigned int token = *ip++;
+         size_t lit_len = token >> 4;
+         size_t match_len = token & 15;
+         size_t offset;
+         const unsigned char *mp;
+         
+         if (lit_len == 15 && get_length(&ip, end, &lit_len) != 0) {
+             return -1;
+         }
+         if ((size_t)(end - ip) < lit_len || (size_t)(op_end - op) < lit_len) {
+             return -1;
+         }
+         memcpy(op, ip, lit_len);
+         ip += lit_len;
+         op += lit_len;
+         
+         /* 最后一个序列没有匹配部分 */
+         if (ip == end) {
+             break;
+         }
+         
+         if (end - ip < 2) {
+             return -1;
+         }
+         offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+         ip += 2;
+         if (offset == 0 || offset > (size_t)(op - op_start)) {
+             return -1;
+         }
+         
+         if (match_len == 15 && get_length(&ip, end, &match_len) != 0) {
+             return -1;
+         }
+         match_len += LZ_MIN_MATCH;
+         if ((size_t)(op_end - op) < match_len) {
+             return -1;
+         }
+         
+         mp = op - offset;
+         if (offset >= match_len) {
+             memcpy(op, mp, match_len);
+             op += match_len;
+         } else {
+             /* 与输出重叠（重复模式），逐字节复制 */
+             while (match_len--) {
+                 *op++ = *mp++;
+             }
+         }
+     }
+     
+     return (long)(op - op_start);
+ }
+ 
+ /**
+  * @brief 按块压缩输入流，写出压缩文件格式
+  *
+  * @param in 原始数据输入流
+  * @param out 压缩文件输出流
+  * @return 成功返回0，失败返回-1
+  */
+ static int compress_stream(FILE *in, FILE *out) {
+     size_t bound = log_lz_bound(LOG_LZ_BLOCK_SIZE);
+     unsigned char header[LZ_BLOCK_HEADER_SIZE];
+     unsigned char *raw = malloc(LOG_LZ_BLOCK_SIZE);
+     unsigned char *comp = malloc(bound);
+     size_t n;
+     int ret = 0;
+     
+     if (!raw || !comp) {
+         perror("malloc failed for log compression");
+         free(raw);
+         free(comp);
+         return -1;
+     }
+     
+     fwrite(lz_magic, 1, sizeof(lz_magic), out);
+     
+     while ((n = fread(raw, 1, LOG_LZ_BLOCK_SIZE, in)) > 0) {
+         size_t c = log_lz_compress(raw, n, comp, bound);
+         
+         put_le32(header, (uint32_t)n);
+         if (c == 0 || c >= n) {
+             /* 压缩后没有变小，原样存储 */
+             put_le32(header + 4, (uint32_t)n | LZ_STORED_FLAG);
+             fwrite(header, 1, sizeof(header), out);
+             fwrite(raw, 1, n, out);
+         } else {
+             put_le32(header + 4, (uint32_t)c);
+             fwrite(header, 1, sizeof(header), out);
+             fwrite(comp, 1, c, out);
+         }
+     }
+     
+     if (ferror(in) || ferror(out)) {
+         ret = -1;
+     }
+     
+     free(raw);
+     free(comp);
+     
+     return ret;
+ }
+ 
+ int log_lz_compress_file(const char *src_path, const char *dst_path) {
+     FILE *in;
+     FILE *out;
+     int ret;
+     
+     in = fopen(src_path, "rb");
+     if (!in) {
+         perror("Failed to open log file for compression");
+         return -1;
+     }
+     
+     out = fopen(dst_path, "wb");
+     if (!out) {
+         perror("Failed to create compressed log file");
+         fclose(in);
+         return -1;
+     }
+     
+     ret = compress_stream(in, out);
+     fclose(in);
+     if (fclose(out) != 0) {
+         ret = -1;
+     }
+     
+     /* 失败时不留下不完整的压缩文件 */
+     if (ret != 0) {
+         fprintf(stderr, "Failed to compress log file %s\n", src_path);
+         unlink(dst_path);
+     }
+     
+     return ret;
+ }
+ 
+ bool log_lz_detect(FILE *in) {
+     unsigned char magic[sizeof(lz_magic)];
+     long pos = ftell(in);
+     bool ret;
+     
+     ret = fread(magic, 1, sizeof(magic), in) == sizeof(magic) &&
+           memcmp(magic, lz_magic, sizeof(magic)) == 0;
+     fseek(in, pos, SEEK_SET);
+     
+     return ret;
+ }
+ 
+ log_lz_reader_t *log_lz_reader_open(FILE *in) {
+     unsigned char magic[sizeof(lz_magic)];
+     log_lz_reader_t *reader;
+     
+     if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+         memcmp(magic, lz_magic, sizeof(magic)) != 0) {
+         fprintf(stderr, "Not a compressed log file\n");
+         return NULL;
+     }
+     
+     reader = calloc(1, sizeof(log_lz_reader_t));
+     if (!reader) {
+         perror("calloc failed for log lz reader");
+         return NULL;
+     }
+     
+     reader->in = in;
+     reader->comp = malloc(log_lz_bound(LOG_LZ_BLOCK_SIZE));
+     reader->block = malloc(LOG_LZ_BLOCK_SIZE);
+     if (!reader->comp || !reader->block) {
+         perror("malloc failed for log lz reader");
+         log_lz_reader_close(reader);
+         return NULL;
+     }
+     
+     return reader;
+ }
+ 
+ /**
+  * @brief 读取并解压下一个块
+  *
+  * @param reader 读取器
+  * @return 成功返回1，文件末尾返回0，数据损坏返回-1
+  */
+ static int load_block(log_lz_reader_t *reader) {
+     unsigned char header[LZ_BLOCK_HEADER_SIZE];
+     size_t n = fread(header, 1, sizeof(header), reader->in);
+     uint32_t raw_len;
+     uint32_t stored_len;
+     
+     if (n == 0 && feof(reader->in)) {
+         return 0;
+     }
+     if (n != sizeof(header)) {
+         return -1;
+     }
+     
+     raw_len = get_le32(header);
+     stored_len = get_le32(header + 4);
+     if (raw_len > LOG_LZ_BLOCK_SIZE) {
+         return -1;
+     }
+     
+     if (stored_len & LZ_STORED_FLAG) {
+         if ((stored_len & ~LZ_STORED_FLAG) != raw_len ||
+             fread(reader->block, 1, raw_len, reader->in) != raw_len) {
+             return -1;
+         }
+     } else {
+         if (stored_len > log_lz_bound(LOG_LZ_BLOCK_SIZE) ||
+             fread(reader->comp, 1, stored_len, reader->in) != stored_len ||
+             log_lz_decompress(reader->comp, stored_len, reader->block, LOG_LZ_BLOCK_SIZE) != (long)raw_len) {
+             return -1;
+         }
+     }
+     
+     reader->block_len = raw_len;
+     reader->block_pos = 0;
+     
+     return 1;
+ }
+ 
+ long log_lz_read(log_lz_reader_t *reader, void *buf, size_t len) {
+     size_t avail;
+     
+     while (reader->block_pos == reader->block_len) {
+         int ret = load_block(reader);
+         if (ret <= 0) {
+             return ret;
+         }
+     }
+     
+     avail = reader->block_len - reader->block_pos;
+     if (len > avail) {
+         len = avail;
+     }
+     memcpy(buf, reader->block + reader->block_pos, len);
+     reader->block_pos += len;
+     
+     return (long)len;
+ }
+ 
+ void log_lz_reader_close(log_lz_reader_t *reader) {
+     if (!reader) {
+         return;
+     }
+     
+     free(reader->comp);
+     free(reader->block);
+     free(reader);
+ }
+ 
+ static ssize_t cookie_read(void *cookie, char *buf, size_t size) {
+     long n = log_lz_read(cookie, buf, size);
+     return n < 0 ? -1 : (ssize_t)n;
+ }
+ 
+ static int cookie_close(void *cookie) {
+     log_lz_reader_t *reader = cookie;
+     FILE *in = reader->in;
+     
+     log_lz_reader_close(reader);
+     return fclose(in);
+ }
+ 
+ FILE *log_lz_fopen(const char *path) {
+     cookie_io_functions_t io = {
+         .read = cookie_read,
+         .write = NULL,
+         .seek = NULL,
+         .close = cookie_close
+     };
+     log_lz_reader_t *reader;
+     FILE *in;
+     FILE *f;
+     
+     in = fopen(path, "rb");
+     if (!in) {
+         perror("Failed to open compressed log file");
+         return NULL;
+     }
+     
+     reader = log_lz_reader_open(in);
+     if (!reader) {
+         fclose(in);
+         return NULL;
+     }
+     
+     f = fopencookie(reader, "r", io);
+     if (!f) {
+         perror("fopencookie failed for compressed log file");
+         log_lz_reader_close(reader);
+         fclose(in);
+     }
+     
+     return f;
+ }
@@ -0,0 +1,268 @@
+/**
+ * @file log_mmap.c
+ * @brief 内存映射日志文件实现
+ *
+ * 文件从打开时的末尾（向下对齐到页）开始按固定大小分段，每段用 posix_fallocate
+ * 预分配后单独映射。写入位置是一个原子计数器，写入者用 fetch_add 预留区间后各自复制，
+ * 跨段的数据分两次复制。每段记录已写完的字节数，写满后由最后一个写入者解除映射
+ */
+ 
+ #include "log_mmap.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include <stdatomic.h>
+ #include <pthread.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ 
+ /* 一次会话最多使用的段数 */
+ #define MMAP_MAX_SEGMENTS 16384
+ 
+ /* 一个映射段 */
+ typedef struct {
+     _Atomic(char *) addr;         /* 映射地址，未映射或已解除映射时为NULL */
+     atomic_size_t written;        /* 已写完的字节数，等于段大小时解除映射 */
+ } mmap_segment_t;
+ 
+ struct log_mmap {
+     int fd;                       /* 文件描述符 */
+     size_t segment_size;          /* 段大小（页大小的整数倍） */
+     off_t base;                   /* 第0段在文件中的偏移 */
+     atomic_size_t tail;           /* 下一次写入的位置（相对 base） */
+     pthread_mutex_t map_mutex;    /* 映射新段时使用的互斥锁 */
+     mmap_segment_t segments[MMAP_MAX_SEGMENTS]; /* 各段状态 */
+ };
+ 
+ /**
+  * @brief 预分配并映射一段，调用者需持有 map_mutex
+  *
+  * @param map 内存映射日志文件
+  * @param index 段序号
+  * @return 映射地址，失败返回NULL
+  */
+ static char *segment_map_locked(log_mmap_t *map, size_t index) {
+     off_t offset = map->base + (off_t)(index * map->segment_size);
+     char *addr;
+     
+     /* 预分配磁盘空间，避免写入映射区域时因磁盘已满收到 SIGBUS */
+     if (posix_fallocate(map->fd, offset, (off_t)map->segment_size) != 0) {
+         fprintf(stderr, "posix_fallocate failed for log file segment %zu\n", index);
+         return NULL;
+     }
+     
+     addr = mmap(NULL, map->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, offset);
+     if (addr == MAP_FAILED) {
+         perror("mmap failed for log file segment");
+         return NULL;
+     }
+     
+     atomic_store_explicit(&map->segments[index].addr, addr, memory_order_release);
+     return addr;
+ }
+ 
+ /**
+  * @brief 获取指定段的映射地址，尚未映射时先映射
+  *
+  * @param map 内存映射日志文件
+  * @param index 段序号
+  * @return 映射地址，失败返回NULL
+  */
+ static char *segment_get(log_mmap_t *map, size_t index) {
+     char *addr;
+     
+     if (index >= MMAP_MAX_SEGMENTS) {
+         return NULL;
+     }
+     
+     addr = atomic_load_explicit(&map->segments[index].addr, memory_order_acquire);
+     if (addr) {
+         return addr;
+     }
+     
+     pthread_mutex_lock(&map->map_mutex);
+     addr = atomic_load_explicit(&map->segments[index].addr, memory_order_acquire);
+     if (!addr) {
+         addr = segment_map_locked(map, index);
+     }
+     pthread_mutex_unlock(&map->map_mutex);
+     
+     return addr;
+ }
+ 
+ /**
+  * @brief 记录某段写完了一部分数据，整段写满时解除映射
+  *
+  * @param map 内存映射日志文件
+  * @param index 段序号
+  * @param len 本次写完的字节数
+  */
+ static void segment_done(log_mmap_t *map, size_t index, size_t len) {
+     mmap_segment_t *seg = &map->segments[index];
+     
+     if (atomic_fetch_add(&seg->written, len) + len == map->segment_size) {
+         char *addr = atomic_exchange(&seg->addr, NULL);
+         if (addr) {
+             munmap(addr, map->segment_size);
+         }
+     }
+ }
+ 
+ /**
+  * @brief 把预留区间中无法写入的部分填成空格，并以换行符结束
+  *
+  * 映射失败时写入位置已经预留，其他写入者可能已在其后写入，无法退回。
+  * 用 pwrite 填充后文件中不会留下一串'\0'，仍可按行解析；
+  * 填充的字节照常计入各段已写完的字节数，使该段之后映射成功时能在写满后解除映射
+  *
+  * @param map 内存映射日志文件
+  * @param pos 未写入部分的开始位置（相对 base）
+  * @param len 未写入部分的长度
+  */
+ static void segment_fill(log_mmap_t *map, size_t pos, size_t len) {
+     char blanks[256];
+     off_t end = map->base + (off_t)(pos + len);
+     
+     memset(blanks, ' ', sizeof(blanks));
+     
+     while (len > 0) {
+         size_t index = pos / map->segment_size;
+         size_t chunk = map->segment_size - pos % map->segment_size;
+         
+         /* 超出最大段数的部分在关闭时被截掉 */
+         if (index >= MMAP_MAX_SEGMENTS) {
+             return;
+         }
+         if (chunk > len) {
+             chunk = len;
+         }
+         
+         for (size_t done = 0; done < chunk; ) {
+             size_t n = chunk - done < sizeof(blanks) ? chunk - done : sizeof(blanks);
+             ssize_t ret = pwrite(map->fd, blanks, n, map->base + (off_t)(pos + done));
+             if (ret <= 0) {
+                 break;
+             }
+             done += (size_t)ret;
+         }
+         segment_done(map, index, chunk);
+         
+         pos += chunk;
+         len -= chunk;
+     }
+     
+     if (pwrite(map->fd, "\n", 1, end - 1) != 1) {
+         perror("pwrite failed for log file");
+     }
+ }
+ 
+ log_mmap_t *log_mmap_open(const char *filename, size_t segment_size) {
+     size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+     log_mmap_t *map;
+     struct stat st;
+     
+     map = calloc(1, sizeof(log_mmap_t));
+     if (!map) {
+         perror("calloc failed for log mmap");
+         return NULL;
+     }
+     
+     /* 映射需要可读写打开，不能使用 O_APPEND */
+     map->fd = open(filename, O_RDWR | O_CREAT, 0644);
+     if (map->fd < 0) {
+         perror("Failed to open log file");
+         free(map);
+         return NULL;
+     }
+     
+     if (fstat(map->fd, &st) != 0) {
+         perror("fstat failed for log file");
+         close(map->fd);
+         free(map);
+         return NULL;
+     }
+     
+     /* 段大小和映射起点都必须按页对齐，已有内容所在的那部分视为第0段中已写完的数据 */
+     map->segment_size = (segment_size + page_size - 1) / page_size * page_size;
+     map->base = st.st_size / (off_t)page_size * (off_t)page_size;
+     atomic_init(&map->tail, (size_t)(st.st_size - map->base));
+     atomic_init(&map->segments[0].written, (size_t)(st.st_size - map->base));
+     pthread_mutex_init(&map->map_mutex, NULL);
+     
+     /* 第0段在打开时映射好 */
+     if (!segment_map_locked(map, 0)) {
+         pthread_mutex_destroy(&map->map_mutex);
+         close(map->fd);
+         free(map);
+         return NULL;
+     }
+     
+     return map;
+ }
+ 
+ int log_mmap_write(log_mmap_t *map, const void *data, size_t len) {
+     const char *src = data;
+     size_t pos = atomic_fetch_add(&map->tail, len);
+     
+     while (len > 0) {
+         size_t index = pos / map->segment_size;
+         size_t offset = pos % map->segment_size;
+         size_t half = map->segment_size / 2;
+         size_t chunk = map->segment_size - offset;
+         char *addr;
+         
+         if (chunk > len) {
+             chunk = len;
+         }
+         
+         addr = segment_get(map, index);
+         if (!addr) {
+             segment_fill(map, pos, len);
+             return -1;
+         }
+         
+         /* 越过段中点的写入者提前映射下一段，其他写入者进入下一段时无需等待 */
+         if (offset < half && offset + chunk >= half) {
+             segment_get(map, index + 1);
+         }
+         
+         memcpy(addr + offset, src, chunk);
+         segment_done(map, index, chunk);
+         
+         pos += chunk;
+         src += chunk;
+         len -= chunk;
+     }
+     
+     return 0;
+ }
+ 
+ void log_mmap_close(log_mmap_t *map) {
+     size_t tail;
+     
+     if (!map) {
+         return;
+     }
+     
+     for (size_t i = 0; i < MMAP_MAX_SEGMENTS; i++) {
+         char *addr = atomic_load(&map->segments[i].addr);
+         if (addr) {
+             munmap(addr, map->segment_size);
+         }
+     }
+     
+     /* 去掉预分配但未写入的部分 */
+     tail = atomic_load(&map->tail);
+     if (tail > MMAP_MAX_SEGMENTS * map->segment_size) {
+         tail = MMAP_MAX_SEGMENTS * map->segment_size;
+     }
+     if (ftruncate(map->fd, map->base + (off_t)tail) != 0) {
+         perror("ftruncate failed for log file");
+     }
+     
+     close(map->fd);
+     pthread_mutex_destroy(&map->map_mutex);
+     free(map);
+ }
@@ -0,0 +1,183 @@
+/**
+ * @file log_output.c
+ * @brief 日志批量输出实现
+ *
+ * 待写数据由一组 iovec 描述：复制进缓冲区的数据首尾相接时合并为同一个 iovec，
+ * 常量数据（颜色代码等）直接引用原地址，刷新时一次 writev 全部写出
+ */
+ 
+ #include "log_output.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <unistd.h>
+ #include <sys/uio.h>
+ 
+ /* 每批最多的 iovec 个数，远小于系统的 IOV_MAX */
+ #define OUTPUT_MAX_IOV 256
+ 
+ struct log_output {
+     int fd;                           /* 输出的文件描述符 */
+     char *buffer;                     /* 数据缓冲区 */
+     size_t capacity;                  /* 缓冲区大小 */
+     size_t used;                      /* 缓冲区已用字节数 */
+     size_t pending;                   /* 待写字节数（包括常量数据） */
+     int iov_count;                    /* 已使用的 iovec 个数 */
+     struct iovec iov[OUTPUT_MAX_IOV]; /* 待写数据描述 */
+ };
+ 
+ log_output_t *log_output_create(int fd, size_t capacity) {
+     log_output_t *out = malloc(sizeof(log_output_t));
+     if (!out) {
+         perror("malloc failed for log output");
+         return NULL;
+     }
+     
+     out->buffer = malloc(capacity);
+     if (!out->buffer) {
+         perror("malloc failed for log output buffer");
+         free(out);
+         return NULL;
+     }
+     
+     out->fd = fd;
+     out->capacity = capacity;
+     out->used = 0;
+     out->pending = 0;
+     out->iov_count = 0;
+     
+     return out;
+ }
+ 
+ void log_output_destroy(log_output_t *out) {
+     if (!out) {
+         return;
+     }
+     
+     log_output_flush(out);
+     free(out->buffer);
+     free(out);
+ }
+ 
+ /**
+  * @brief 添加一个 iovec，与上一个 iovec 首尾相接时直接合并
+  *
+  * @param out 输出缓冲
+  * @param base 数据地址
+  * @param len 数据长度
+  */
+ static void push_iov(log_output_t *out, const void *base, size_t len) {
+     struct iovec *last = out->iov_count > 0 ? &out->iov[out->iov_count - 1] : NULL;
+     
+     if (last && (const char *)last->iov_base + last->iov_len == (const char *)base) {
+         last->iov_len += len;
+     } else {
+         out->iov[out->iov_count].iov_base = (void *)base;
+         out->iov[out->iov_count].iov_len = len;
+         out->iov_count++;
+     }
+     out->pending += len;
+ }
+ 
+ int log_output_append(log_output_t *out, const void *data, size_t len) {
+     if (len == 0) {
+         return 0;
+     }
+     
+     /* 缓冲区或 iovec 不够用时先写出已有数据 */
+     if (out->used + len > out->capacity || out->iov_count == OUTPUT_MAX_IOV) {
+         if (log_output_flush(out) != 0) {
+             return -1;
+         }
+     }
+     
+     /* 超过缓冲区大小的数据直接写出 */
+     if (len > out->capacity) {
+         push_iov(out, data, len);
+         return log_output_flush(out);
+     }
+     
+     memcpy(out->buffer + out->used, data, len);
+     push_iov(out, out->buffer + out->used, len);
+     out->used += len;
+     
+     return 0;
+ }
+ 
+ int log_output_append_static(log_output_t *out, const void *data, size_t len) {
+     if (len == 0) {
+         return 0;
+     }
+     
+     if (out->iov_count == OUTPUT_MAX_IOV && log_output_flush(out) != 0) {
+         return -1;
+     }
+     
+     push_iov(out, data, len);
+     return 0;
+ }
+ 
+ void log_output_set_fd(log_output_t *out, int fd) {
+     out->fd = fd;
+ }
+ 
+ size_t log_output_pending(const log_output_t *out) {
+     return out->pending;
+ }
+ 
+ void log_output_emergency_flush(const log_output_t *out) {
+     int count = out->iov_count;
+     
+     for (int i = 0; i < count && i < OUTPUT_MAX_IOV; i++) {
+         const char *p = out->iov[i].iov_base;
+         size_t len = out->iov[i].iov_len;
+         
+         while (len > 0) {
+             ssize_t n = write(out->fd, p, len);
+             if (n < 0 && errno == EINTR) {
+                 continue;
+             }
+             if (n <= 0) {
+                 return;
+             }
+             p += n;
+             len -= (size_t)n;
+         }
+     }
+ }
+ 
+ int log_output_flush(log_output_t *out) {
+     struct iovec *iov = out->iov;
+     int count = out->iov_count;
+     int ret = 0;
+     
+     while (count > 0) {
+         ssize_t n = writev(out->fd, iov, count);
+         if (n < 0) {
+             if (errno == EINTR) {
+                 continue;
+             }
+             perror("writev failed for log output");
+             ret = -1;
+             break;
+         }
+         
+         /* 处理部分写出：跳过已完整写出的 iovec，调整写了一半的那个 */
+         while (count > 0 && (size_t)n >= iov->iov_len) {
+             n -= (ssize_t)iov->iov_len;
+             iov++;
+             count--;
+         }
+         if (count > 0) {
+             iov->iov_base = (char *)iov->iov_base + n;
+             iov->iov_len -= (size_t)n;
+         }
+     }
+     
+     out->used = 0;
+     out->pending = 0;
+     out->iov_count = 0;
+     
+     return ret;
+ }
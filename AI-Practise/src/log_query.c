@@ -0,0 +1,123 @@
+/**
+ * @file log_query.c
+ * @brief 日志时间范围查询工具
+ *
+ * 按时间范围和最低级别从文本或 JSON 格式的日志文件中取出日志，
+ * 借助稀疏时间索引只读取范围内的部分，查询大文件也只需要几毫秒
+ * 用法: log_query [-l 最低级别] [-c] <开始时间> <结束时间|-> <日志文件>...
+ * 时间格式为 "YYYY-MM-DD HH:MM:SS[.mmm]"，结束时间为 "-" 表示不限
+ */
+ 
+ #include "log_index.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <strings.h>
+ #include <limits.h>
+ #include <unistd.h>
+ 
+ /* 日志级别名称，顺序与 log_level_t 一致 */
+ static const char *level_names[] = { "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+ 
+ /**
+  * @brief 输出一条匹配的日志
+  *
+  * @param line 日志内容
+  * @param len 日志长度
+  * @param arg 输出流
+  */
+ static void print_record(const char *line, size_t len, void *arg) {
+     fwrite(line, 1, len, arg);
+ }
+ 
+ /**
+  * @brief 不输出日志（只统计条数）
+  */
+ static void skip_record(const char *line, size_t len, void *arg) {
+     (void)line;
+     (void)len;
+     (void)arg;
+ }
+ 
+ /**
+  * @brief 解析日志级别名称（不区分大小写）
+  *
+  * @param name 级别名称
+  * @param level 输出参数，日志级别
+  * @return 成功返回0，无法识别返回-1
+  */
+ static int parse_level(const char *name, log_level_t *level) {
+     for (int i = 0; i < (int)(sizeof(level_names) / sizeof(level_names[0])); i++) {
+         if (strcasecmp(name, level_names[i]) == 0) {
+             *level = (log_level_t)i;
+             return 0;
+         }
+     }
+     return -1;
+ }
+ 
+ static void usage(const char *prog) {
+     fprintf(stderr, "用法: %s [-l 最低级别] [-c] <开始时间> <结束时间|-> <日志文件>...\n", prog);
+     fprintf(stderr, "  时间格式为 \"YYYY-MM-DD HH:MM:SS[.mmm]\"，结束时间为 \"-\" 表示不限\n");
+     fprintf(stderr, "  -l  只输出不低于该级别的日志（DEBUG/INFO/WARN/ERROR/FATAL）\n");
+     fprintf(stderr, "  -c  只输出匹配的日志条数\n");
+ }
+ 
+ int main(int argc, char *argv[]) {
+     log_level_t min_level = LOG_LEVEL_DEBUG;
+     long long from_ms;
+     long long to_ms = LLONG_MAX - LOG_INDEX_SKEW_MS;
+     int count_only = 0;
+     int ret = 0;
+     size_t total = 0;
+     int opt;
+     
+     while ((opt = getopt(argc, argv, "l:c")) != -1) {
+         switch (opt) {
+             case 'l':
+                 if (parse_level(optarg, &min_level) != 0) {
+                     fprintf(stderr, "Unknown log level: %s\n", optarg);
+                     return 1;
+                 }
+                 break;
+             case 'c':
+                 count_only = 1;
+                 break;
+             default:
+                 usage(argv[0]);
+                 return 1;
+         }
+     }
+     
+     if (argc - optind < 3) {
+         usage(argv[0]);
+         return 1;
+     }
+     
+     if (log_index_parse_time(argv[optind], strlen(argv[optind]), &from_ms) != 0) {
+         fprintf(stderr, "Invalid start time: %s\n", argv[optind]);
+         return 1;
+     }
+     if (strcmp(argv[optind + 1], "-") != 0 &&
+         log_index_parse_time(argv[optind + 1], strlen(argv[optind + 1]), &to_ms) != 0) {
+         fprintf(stderr, "Invalid end time: %s\n", argv[optind + 1]);
+         return 1;
+     }
+     
+     for (int i = optind + 2; i < argc; i++) {
+         log_index_t *idx = log_index_open(argv[i]);
+         if (!idx) {
+             fprintf(stderr, "Skipping %s\n", argv[i]);
+             ret = 1;
+             continue;
+         }
+         total += log_index_query(idx, from_ms, to_ms, min_level, count_only ? skip_record : print_record, stdout);
+         log_index_close(idx);
+     }
+     
+     if (count_only) {
+         printf("%zu\n", total);
+     }
+     
+     return ret;
+ }
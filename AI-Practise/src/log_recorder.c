@@ -0,0 +1,315 @@
+/**
+ * @file log_recorder.c
+ * @brief 日志飞行记录器实现
+ *
+ * 记录器由定长槽位组成，每个槽位是一个槽位头、格式字符串的副本和一条二进制日志记录（调用点编号固定为1）。
+ * 转储时在内存中拼出一段完整的二进制日志：每条记录之前重新定义1号调用点，
+ * 再交给二进制日志解码器还原，因此还原结果与 log_decode 完全一致
+ */
+ 
+ #include "log_recorder.h"
+ #include "log_binary.h"
+ #include "log_clock.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include <time.h>
+ #include <pthread.h>
+ 
+ /* 每个槽位的字节数，放不下的字符串参数被截断 */
+ #define RECORDER_SLOT_SIZE 256
+ /* 转储时还原一行文本的缓冲区大小 */
+ #define RECORDER_LINE_SIZE 4096
+ /* 复制格式字符串后至少要留给参数的字节数，放不下时只记录占位格式 */
+ #define RECORDER_MIN_ARGS 32
+ /* 格式字符串太长时使用的占位格式 */
+ #define RECORDER_LONG_FORMAT "(format too long)"
+ 
+ /* 槽位头，其后是以'\0'结尾的格式字符串和编码后的日志记录 */
+ typedef struct {
+     size_t len;          /* 日志记录的长度 */
+     int level;           /* 日志级别 */
+     int line;            /* 调用处的行号 */
+     const char *file;    /* 调用处的文件名 */
+     const char *func;    /* 调用处的函数名 */
+     size_t fmt_len;      /* 格式字符串的长度（不包括'\0'） */
+ } slot_header_t;
+ 
+ struct log_recorder {
+     pthread_mutex_t mutex;       /* 所属线程写入与其他线程转储之间的互斥 */
+     size_t slots;                /* 槽位数 */
+     size_t next;                 /* 下一条日志写入的槽位 */
+     size_t count;                /* 保存的日志条数 */
+     log_recorder_t *next_thread; /* 所有线程的记录器组成的链表 */
+     unsigned char *buf;          /* 槽位数组 */
+ };
+ 
+ /* 所有线程的记录器 */
+ static struct {
+     pthread_mutex_t mutex;       /* 保护链表 */
+     pthread_once_t once;         /* 线程键只创建一次 */
+     pthread_key_t key;           /* 线程退出时销毁记录器 */
+     log_recorder_t *head;        /* 链表头 */
+ } registry = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, NULL };
+ 
+ /* 调用线程的记录器 */
+ static _Thread_local log_recorder_t *tls_recorder;
+ 
+ /**
+  * @brief 从链表中摘下并销毁记录器
+  *
+  * @param rec 记录器
+  */
+ static void recorder_destroy(log_recorder_t *rec) {
+     pthread_mutex_lock(&registry.mutex);
+     for (log_recorder_t **p = &registry.head; *p; p = &(*p)->next_thread) {
+         if (*p == rec) {
+             *p = rec->next_thread;
+             break;
+         }
+     }
+     pthread_mutex_unlock(&registry.mutex);
+     
+     pthread_mutex_destroy(&rec->mutex);
+     free(rec->buf);
+     free(rec);
+ }
+ 
+ /**
+  * @brief 线程退出时的清理函数
+  *
+  * @param value 线程的记录器
+  */
+ static void recorder_thread_exit(void *value) {
+     recorder_destroy(value);
+ }
+ 
+ /**
+  * @brief 创建线程键
+  */
+ static void recorder_key_create(void) {
+     if (pthread_key_create(&registry.key, recorder_thread_exit) != 0) {
+         perror("pthread_key_create failed for log recorder");
+     }
+ }
+ 
+ log_recorder_t *log_recorder_thread(size_t capacity) {
+     log_recorder_t *rec = tls_recorder;
+     size_t slots = capacity / RECORDER_SLOT_SIZE;
+     
+     if (capacity == 0) {
+         return NULL;
+     }
+     if (slots == 0) {
+         slots = 1;
+     }
+     if (rec && rec->slots == slots) {
+         return rec;
+     }
+     
+     pthread_once(&registry.once, recorder_key_create);
+     
+     /* 条数改变时重新创建 */
+     if (rec) {
+         tls_recorder = NULL;
+         pthread_setspecific(registry.key, NULL);
+         recorder_destroy(rec);
+     }
+     
+     rec = calloc(1, sizeof(*rec));
+     if (!rec) {
+         return NULL;
+     }
+     rec->buf = malloc(slots * RECORDER_SLOT_SIZE);
+     if (!rec->buf) {
+         free(rec);
+         return NULL;
+     }
+     pthread_mutex_init(&rec->mutex, NULL);
+     rec->slots = slots;
+     
+     pthread_mutex_lock(&registry.mutex);
+     rec->next_thread = registry.head;
+     registry.head = rec;
+     pthread_mutex_unlock(&registry.mutex);
+     
+     pthread_setspecific(registry.key, rec);
+     tls_recorder = rec;
+     return rec;
+ }
+ 
+ int log_recorder_append(log_recorder_t *rec, int level, const char *file, int line, const char *func,
+                         const char *fmt, const unsigned char *types, int ntypes, va_list args) {
+     struct timespec ts;
+     unsigned long long timestamp_us;
+     unsigned char *slot;
+     unsigned char *record;
+     slot_header_t *header;
+     size_t fmt_len = strlen(fmt);
+     size_t len;
+     va_list copy;
+     
+     /* 格式字符串可能在栈上，转储时已经失效，必须复制到槽位中 */
+     if (sizeof(slot_header_t) + fmt_len + 1 + RECORDER_MIN_ARGS > RECORDER_SLOT_SIZE) {
+         fmt = RECORDER_LONG_FORMAT;
+         fmt_len = strlen(fmt);
+         ntypes = 0;
+     }
+     
+     log_clock_now(&ts);
+     timestamp_us = (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000;
+     
+     pthread_mutex_lock(&rec->mutex);
+     
+     slot = rec->buf + rec->next * RECORDER_SLOT_SIZE;
+     record = slot + sizeof(slot_header_t) + fmt_len + 1;
+     va_copy(copy, args);
+     len = log_binary_encode_record(record, (size_t)(slot + RECORDER_SLOT_SIZE - record),
+                                    1, timestamp_us, types, ntypes, copy);
+     va_end(copy);
+     if (len == 0) {
+         pthread_mutex_unlock(&rec->mutex);
+         return -1;
+     }
+     
+     header = (slot_header_t *)slot;
+     header->len = len;
+     header->level = level;
+     header->line = line;
+     header->file = file;
+     header->func = func;
+     header->fmt_len = fmt_len;
+     memcpy(slot + sizeof(slot_header_t), fmt, fmt_len + 1);
+     
+     rec->next = (rec->next + 1) % rec->slots;
+     if (rec->count < rec->slots) {
+         rec->count++;
+     }
+     
+     pthread_mutex_unlock(&rec->mutex);
+     return 0;
+ }
+ 
+ /**
+  * @brief 把记录器中的日志拼成一段二进制日志，并清空记录器
+  *
+  * @param rec 记录器
+  * @param levels 输出参数，各条日志的级别（需由调用者释放）
+  * @param data 输出参数，二进制日志（需由调用者释放）
+  * @param size 输出参数，二进制日志长度
+  * @return 日志条数，失败或没有日志时返回0
+  */
+ static size_t recorder_serialize(log_recorder_t *rec, int **levels, char **data, size_t *size) {
+     unsigned char site_buf[RECORDER_LINE_SIZE];
+     unsigned char header_buf[8];
+     size_t count;
+     FILE *stream;
+     
+     pthread_mutex_lock(&rec->mutex);
+     
+     count = rec->count;
+     if (count == 0) {
+         pthread_mutex_unlock(&rec->mutex);
+         return 0;
+     }
+     
+     *levels = malloc(count * sizeof(int));
+     stream = *levels ? open_memstream(data, size) : NULL;
+     if (!stream) {
+         free(*levels);
+         pthread_mutex_unlock(&rec->mutex);
+         return 0;
+     }
+     
+     fwrite(header_buf, 1, log_binary_encode_header(header_buf), stream);
+     for (size_t i = 0; i < count; i++) {
+         size_t index = (rec->next + rec->slots - count + i) % rec->slots;
+         unsigned char *slot = rec->buf + index * RECORDER_SLOT_SIZE;
+         slot_header_t *header = (slot_header_t *)slot;
+         const char *fmt = (const char *)(slot + sizeof(slot_header_t));
+         size_t site_len = log_binary_encode_site(site_buf, sizeof(site_buf), 1, header->level,
+                                                  header->file, header->line, header->func, fmt);
+         
+         /* 文件名、函数名和格式字符串太长时只保留行号 */
+         if (site_len == 0) {
+             site_len = log_binary_encode_site(site_buf, sizeof(site_buf), 1, header->level,
+                                               "?", header->line, "?", RECORDER_LONG_FORMAT);
+         }
+         (*levels)[i] = header->level;
+         fwrite(site_buf, 1, site_len, stream);
+         fwrite(fmt + header->fmt_len + 1, 1, header->len, stream);
+     }
+     rec->count = 0;
+     
+     pthread_mutex_unlock(&rec->mutex);
+     
+     if (fclose(stream) != 0) {
+         free(*levels);
+         free(*data);
+         return 0;
+     }
+     return count;
+ }
+ 
+ size_t log_recorder_dump(log_recorder_t *rec, log_recorder_emit_fn emit, void *arg) {
+     int *levels = NULL;
+     char *data = NULL;
+     size_t size = 0;
+     size_t count;
+     size_t emitted = 0;
+     char *line;
+     FILE *in;
+     log_binary_decoder_t *dec;
+     
+     if (!rec) {
+         return 0;
+     }
+     
+     count = recorder_serialize(rec, &levels, &data, &size);
+     if (count == 0) {
+         return 0;
+     }
+     
+     /* 在不持有记录器锁的情况下还原和输出 */
+     line = malloc(RECORDER_LINE_SIZE);
+     in = line ? fmemopen(data, size, "r") : NULL;
+     dec = in ? log_binary_decoder_open(in) : NULL;
+     if (dec) {
+         int len;
+         while (emitted < count && (len = log_binary_decode_next(dec, line, RECORDER_LINE_SIZE)) > 0) {
+             emit(levels[emitted], line, (size_t)len, arg);
+             emitted++;
+         }
+         log_binary_decoder_close(dec);
+     }
+     
+     if (in) {
+         fclose(in);
+     }
+     free(line);
+     free(data);
+     free(levels);
+     return emitted;
+ }
+ 
+ size_t log_recorder_dump_all(log_recorder_emit_fn emit, void *arg) {
+     size_t total = 0;
+     
+     pthread_mutex_lock(&registry.mutex);
+     for (log_recorder_t *rec = registry.head; rec; rec = rec->next_thread) {
+         total += log_recorder_dump(rec, emit, arg);
+     }
+     pthread_mutex_unlock(&registry.mutex);
+     
+     return total;
+ }
+ 
+ void log_recorder_reset_all(void) {
+     pthread_mutex_lock(&registry.mutex);
+     for (log_recorder_t *rec = registry.head; rec; rec = rec->next_thread) {
+         pthread_mutex_lock(&rec->mutex);
+         rec->count = 0;
+         pthread_mutex_unlock(&rec->mutex);
+     }
+     pthread_mutex_unlock(&registry.mutex);
+ }
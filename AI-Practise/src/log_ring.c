@@ -0,0 +1,161 @@
+/**
+ * @file log_ring.c
+ * @brief 有界无锁多生产者单消费者环形队列实现
+ *
+ * 基于每个槽位序号的有界队列：生产者用CAS推进写位置，消费者独占读位置，
+ * 槽位序号用来区分“空闲 / 已提交 / 已读取”三种状态，整个过程不需要加锁
+ */
+ 
+ #include "log_ring.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <stdint.h>
+ #include <stdatomic.h>
+ 
+ /* 缓存行大小，用于避免读写位置之间的伪共享 */
+ #define CACHE_LINE_SIZE 64
+ 
+ /* 槽位头部，数据区紧跟其后 */
+ typedef struct {
+     atomic_size_t seq;            /* 槽位序号 */
+ } ring_cell_t;
+ 
+ struct log_ring {
+     unsigned char *cells;         /* 槽位数组 */
+     size_t capacity;              /* 槽位数量（2的幂） */
+     size_t mask;                  /* capacity - 1 */
+     size_t slot_size;             /* 每个槽位的数据区大小 */
+     size_t stride;                /* 相邻槽位的间距 */
+     _Alignas(CACHE_LINE_SIZE) atomic_size_t head; /* 生产者写位置 */
+     _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; /* 消费者读位置 */
+ };
+ 
+ /**
+  * @brief 获取指定位置对应的槽位
+  *
+  * @param ring 环形队列
+  * @param pos 队列位置
+  * @return 槽位头部指针
+  */
+ static inline ring_cell_t *ring_cell(const log_ring_t *ring, size_t pos) {
+     return (ring_cell_t *)(ring->cells + (pos & ring->mask) * ring->stride);
+ }
+ 
+ log_ring_t *log_ring_create(size_t capacity, size_t slot_size) {
+     log_ring_t *ring;
+     size_t cap = 2;
+     
+     if (capacity == 0 || slot_size == 0) {
+         return NULL;
+     }
+     
+     /* 容量向上取整为2的幂，便于用掩码取模 */
+     while (cap < capacity) {
+         cap <<= 1;
+     }
+     
+     ring = (log_ring_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(log_ring_t));
+     if (!ring) {
+         perror("malloc failed for log_ring");
+         return NULL;
+     }
+     
+     ring->capacity = cap;
+     ring->mask = cap - 1;
+     ring->slot_size = slot_size;
+     ring->stride = (sizeof(ring_cell_t) + slot_size + CACHE_LINE_SIZE - 1) &
+                    ~(size_t)(CACHE_LINE_SIZE - 1);
+     ring->cells = (unsigned char *)aligned_alloc(CACHE_LINE_SIZE, cap * ring->stride);
+     if (!ring->cells) {
+         perror("malloc failed for log_ring cells");
+         free(ring);
+         return NULL;
+     }
+     
+     /* 槽位i的初始序号为i，表示可以被第i次写入使用 */
+     for (size_t i = 0; i < cap; i++) {
+         atomic_init(&ring_cell(ring, i)->seq, i);
+     }
+     atomic_init(&ring->head, 0);
+     atomic_init(&ring->tail, 0);
+     
+     return ring;
+ }
+ 
+ void log_ring_destroy(log_ring_t *ring) {
+     if (!ring) {
+         return;
+     }
+     
+     free(ring->cells);
+     free(ring);
+ }
+ 
+ void *log_ring_reserve(log_ring_t *ring, size_t *ticket) {
+     size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+     
+     for (;;) {
+         ring_cell_t *cell = ring_cell(ring, pos);
+         size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+         intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+         
+         if (diff == 0) {
+             /* 槽位空闲，尝试占用 */
+             if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                       memory_order_relaxed,
+                                                       memory_order_relaxed)) {
+                 *ticket = pos;
+                 return cell + 1;
+             }
+         } else if (diff < 0) {
+             /* 槽位尚未被消费者释放，队列已满 */
+             return NULL;
+         } else {
+             /* 其他生产者已占用该位置，重新读取写位置 */
+             pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+         }
+     }
+ }
+ 
+ void log_ring_commit(log_ring_t *ring, size_t ticket) {
+     atomic_store_explicit(&ring_cell(ring, ticket)->seq, ticket + 1, memory_order_release);
+ }
+ 
+ void *log_ring_peek(log_ring_t *ring) {
+     size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+     ring_cell_t *cell = ring_cell(ring, pos);
+     
+     if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1) {
+         return NULL;
+     }
+     
+     return cell + 1;
+ }
+ 
+ void log_ring_release(log_ring_t *ring) {
+     size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+     
+     /* 序号推进一整圈，交还给下一轮的生产者 */
+     atomic_store_explicit(&ring_cell(ring, pos)->seq, pos + ring->capacity, memory_order_release);
+     atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+ }
+ 
+ void *log_ring_peek_at(log_ring_t *ring, size_t index) {
+     size_t pos = atomic_load_explicit(&ring->tail, memory_order_acquire) + index;
+     ring_cell_t *cell = ring_cell(ring, pos);
+     
+     if (index >= ring->capacity ||
+         atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1) {
+         return NULL;
+     }
+     
+     return cell + 1;
+ }
+ 
+ bool log_ring_empty(log_ring_t *ring) {
+     return log_ring_peek(ring) == NULL;
+ }
+ 
+ size_t log_ring_slot_size(const log_ring_t *ring) {
+     return ring->slot_size;
+ }
\ No newline at end of file
@@ -0,0 +1,285 @@
+/**
+ * @file log_rotate.c
+ * @brief 日志文件轮转实现
+ *
+ * 后台线程始终提前打开一个 filename.next 文件。写入者判断需要轮转时用原子交换取走它，
+ * 把旧文件描述符交还给后台线程；后台线程关闭旧文件，依次把 filename.N 改名为
+ * filename.N+1，再把 filename 改名为 filename.1、filename.next 改名为 filename，
+ * 最后打开新的 filename.next。写入者一侧只有原子操作和一次条件变量通知。
+ * 开启压缩时，历史文件在打开新的 filename.next 之后压缩为 filename.N.lz
+ */
+ 
+ #include "log_rotate.h"
+ #include "log_lz.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include <time.h>
+ #include <stdatomic.h>
+ #include <pthread.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+ 
+ /* 轮转文件名的最大长度 */
+ #define ROTATE_PATH_MAX 4096
+ 
+ struct log_rotate {
+     char *filename;               /* 日志文件名 */
+     size_t max_size;              /* 单个文件的最大字节数 */
+     unsigned int interval_sec;    /* 按时间轮转的间隔 */
+     unsigned int keep;            /* 保留的历史文件个数 */
+     bool compress;                /* 是否压缩历史文件 */
+     size_t current_size;          /* 当前文件已写入的字节数（只由写入者访问） */
+     time_t deadline;              /* 下次按时间轮转的时刻（只由写入者访问） */
+     atomic_int next_fd;           /* 预先打开的下一个文件，-1表示尚未就绪 */
+     atomic_int retired_fd;        /* 等待后台线程处理的旧文件，-1表示没有 */
+     atomic_bool stop;             /* 通知后台线程退出 */
+     pthread_t thread;             /* 后台线程 */
+     bool running;                 /* 后台线程是否已启动 */
+     pthread_mutex_t mutex;        /* 唤醒后台线程使用的互斥锁 */
+     pthread_cond_t cond;          /* 唤醒后台线程使用的条件变量 */
+ };
+ 
+ /**
+  * @brief 计算下一次按时间轮转的时刻，对齐到间隔的整数倍
+  *
+  * @param rot 轮转器
+  * @return 下次轮转的时刻，不按时间轮转时返回0
+  */
+ static time_t next_deadline(const log_rotate_t *rot) {
+     time_t now = time(NULL);
+     
+     if (rot->interval_sec == 0) {
+         return 0;
+     }
+     return (now / rot->interval_sec + 1) * rot->interval_sec;
+ }
+ 
+ /**
+  * @brief 打开下一个日志文件 filename.next
+  *
+  * @param rot 轮转器
+  * @return 文件描述符，失败返回-1
+  */
+ static int open_next(const log_rotate_t *rot) {
+     char path[ROTATE_PATH_MAX];
+     int fd;
+     
+     snprintf(path, sizeof(path), "%s.next", rot->filename);
+     fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+     if (fd < 0) {
+         perror("Failed to open next log file");
+     }
+     
+     return fd;
+ }
+ 
+ /**
+  * @brief 关闭旧文件并完成改名：filename.N -> filename.N+1，filename -> filename.1，
+  *        filename.next -> filename
+  *
+  * @param rot 轮转器
+  * @param old_fd 旧文件描述符
+  */
+ static void retire_file(const log_rotate_t *rot, int old_fd) {
+     /* 压缩失败时历史文件保留未压缩的形式，两种文件名都要依次后移，
+        否则未压缩的 filename.1 会被下一次轮转覆盖 */
+     static const char *suffixes[] = { "", LOG_LZ_SUFFIX };
+     size_t suffix_count = rot->compress ? 2 : 1;
+     char from[ROTATE_PATH_MAX];
+     char to[ROTATE_PATH_MAX];
+     
+     close(old_fd);
+     
+     for (size_t s = 0; s < suffix_count; s++) {
+         /* 超出保留个数的最旧文件直接删除 */
+         snprintf(to, sizeof(to), "%s.%u%s", rot->filename, rot->keep, suffixes[s]);
+         unlink(to);
+         
+         for (unsigned int i = rot->keep; i > 1; i--) {
+             snprintf(from, sizeof(from), "%s.%u%s", rot->filename, i - 1, suffixes[s]);
+             snprintf(to, sizeof(to), "%s.%u%s", rot->filename, i, suffixes[s]);
+             rename(from, to);
+         }
+     }
+     
+     if (rot->keep > 0) {
+         snprintf(to, sizeof(to), "%s.1", rot->filename);
+         if (rename(rot->filename, to) != 0) {
+             perror("Failed to rename rotated log file");
+         }
+     }
+     
+     /* keep 为0时 filename 被直接覆盖 */
+     snprintf(from, sizeof(from), "%s.next", rot->filename);
+     if (rename(from, rot->filename) != 0) {
+         perror("Failed to rename next log file");
+     }
+ }
+ 
+ /**
+  * @brief 把刚轮转出的 filename.1 压缩为 filename.1.lz
+  *
+  * @param rot 轮转器
+  */
+ static void compress_retired(const log_rotate_t *rot) {
+     char from[ROTATE_PATH_MAX];
+     char to[ROTATE_PATH_MAX];
+     
+     snprintf(from, sizeof(from), "%s.1", rot->filename);
+     snprintf(to, sizeof(to), "%s.1%s", rot->filename, LOG_LZ_SUFFIX);
+     
+     /* 压缩失败时保留未压缩的文件 */
+     if (log_lz_compress_file(from, to) == 0) {
+         unlink(from);
+     }
+ }
+ 
+ /**
+  * @brief 后台线程：处理旧文件并提前打开下一个文件
+  *
+  * @param arg 轮转器
+  * @return NULL
+  */
+ static void *rotate_main(void *arg) {
+     log_rotate_t *rot = arg;
+     
+     for (;;) {
+         int old_fd = atomic_exchange(&rot->retired_fd, -1);
+         
+         if (old_fd >= 0) {
+             retire_file(rot, old_fd);
+         }
+         
+         /* 上一次打开失败时在这里重试 */
+         if (atomic_load(&rot->next_fd) < 0 && atomic_load(&rot->retired_fd) < 0) {
+             atomic_store(&rot->next_fd, open_next(rot));
+         }
+         
+         /* 压缩比较耗时，放在下一个文件就绪之后进行 */
+         if (old_fd >= 0 && rot->compress && rot->keep > 0) {
+             compress_retired(rot);
+         }
+         
+         pthread_mutex_lock(&rot->mutex);
+         if (!atomic_load(&rot->stop) && atomic_load(&rot->retired_fd) < 0) {
+             struct timespec deadline;
+             clock_gettime(CLOCK_REALTIME, &deadline);
+             deadline.tv_sec += 1;
+             pthread_cond_timedwait(&rot->cond, &rot->mutex, &deadline);
+         }
+         pthread_mutex_unlock(&rot->mutex);
+         
+         if (atomic_load(&rot->stop) && atomic_load(&rot->retired_fd) < 0) {
+             break;
+         }
+     }
+     
+     return NULL;
+ }
+ 
+ log_rotate_t *log_rotate_start(const char *filename, int fd, size_t max_size,
+                                unsigned int interval_sec, unsigned int keep, bool compress) {
+     log_rotate_t *rot;
+     struct stat st;
+     
+     rot = calloc(1, sizeof(log_rotate_t));
+     if (!rot) {
+         perror("calloc failed for log rotate");
+         return NULL;
+     }
+     
+     rot->filename = strdup(filename);
+     if (!rot->filename) {
+         perror("strdup failed for log rotate");
+         free(rot);
+         return NULL;
+     }
+     
+     rot->max_size = max_size;
+     rot->interval_sec = interval_sec;
+     rot->keep = keep;
+     rot->compress = compress;
+     rot->current_size = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+     rot->deadline = next_deadline(rot);
+     atomic_init(&rot->next_fd, open_next(rot));
+     atomic_init(&rot->retired_fd, -1);
+     atomic_init(&rot->stop, false);
+     pthread_mutex_init(&rot->mutex, NULL);
+     pthread_cond_init(&rot->cond, NULL);
+     
+     if (pthread_create(&rot->thread, NULL, rotate_main, rot) != 0) {
+         perror("pthread_create failed for log rotate");
+         log_rotate_stop(rot);
+         return NULL;
+     }
+     rot->running = true;
+     
+     return rot;
+ }
+ 
+ bool log_rotate_due(log_rotate_t *rot, size_t len) {
+     bool due = false;
+     
+     /* 空文件不轮转 */
+     if (rot->current_size > 0) {
+         if (rot->max_size > 0 && rot->current_size + len > rot->max_size) {
+             due = true;
+         } else if (rot->deadline > 0 && time(NULL) >= rot->deadline) {
+             due = true;
+         }
+     }
+     
+     /* 下一个文件尚未就绪时继续写当前文件，不等待 */
+     if (due && atomic_load_explicit(&rot->next_fd, memory_order_acquire) >= 0) {
+         return true;
+     }
+     
+     rot->current_size += len;
+     return false;
+ }
+ 
+ int log_rotate_switch(log_rotate_t *rot, int old_fd) {
+     int fd = atomic_exchange(&rot->next_fd, -1);
+     
+     atomic_store(&rot->retired_fd, old_fd);
+     rot->current_size = 0;
+     rot->deadline = next_deadline(rot);
+     
+     pthread_mutex_lock(&rot->mutex);
+     pthread_cond_signal(&rot->cond);
+     pthread_mutex_unlock(&rot->mutex);
+     
+     return fd;
+ }
+ 
+ void log_rotate_stop(log_rotate_t *rot) {
+     char path[ROTATE_PATH_MAX];
+     int fd;
+     
+     if (!rot) {
+         return;
+     }
+     
+     if (rot->running) {
+         pthread_mutex_lock(&rot->mutex);
+         atomic_store(&rot->stop, true);
+         pthread_cond_signal(&rot->cond);
+         pthread_mutex_unlock(&rot->mutex);
+         pthread_join(rot->thread, NULL);
+     }
+     
+     /* 删除没有用上的下一个文件 */
+     fd = atomic_load(&rot->next_fd);
+     if (fd >= 0) {
+         close(fd);
+         snprintf(path, sizeof(path), "%s.next", rot->filename);
+         unlink(path);
+     }
+     
+     pthread_cond_destroy(&rot->cond);
+     pthread_mutex_destroy(&rot->mutex);
+     free(rot->filename);
+     free(rot);
+ }
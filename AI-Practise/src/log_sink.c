@@ -0,0 +1,559 @@
+/**
+ * @file log_sink.c
+ * @brief 日志输出目标（sink）实现
+ *
+ * 每个 sink 的队列是一个多生产者单消费者环形队列，槽位里只放共享记录的指针。
+ * 后台线程每次取空队列后调用一次 flush，文件和标准输出因此按批写出
+ */
+ 
+ #include "log_sink.h"
+ #include "log_ring.h"
+ #include "log_output.h"
+ #include <stdlib.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include <time.h>
+ #include <pthread.h>
+ #include <sched.h>
+ #include <stdatomic.h>
+ #include <unistd.h>
+ #include <fcntl.h>
+ #include <errno.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ 
+ /* 队列默认容量（条数） */
+ #define SINK_QUEUE_DEFAULT_SIZE 1024
+ /* 文件和标准输出 sink 的输出缓冲大小 */
+ #define SINK_OUTPUT_SIZE (64 * 1024)
+ 
+ /* 共享的日志记录，由所有引用它的 sink 共同持有，最后一个释放者负责释放内存 */
+ typedef struct {
+     atomic_uint refs;     /* 引用计数 */
+     log_level_t level;    /* 日志级别 */
+     size_t len;           /* 日志长度 */
+     char data[];          /* 格式化完成的日志 */
+ } sink_record_t;
+ 
+ struct log_sink {
+     log_sink_ops_t ops;           /* 输出操作 */
+     void *ctx;                    /* 输出操作的参数 */
+     log_level_t min_level;        /* 级别阈值 */
+     log_ring_t *queue;            /* 队列，槽位中保存 sink_record_t 指针 */
+     pthread_t thread;             /* 后台线程 */
+     atomic_bool stop;             /* 通知后台线程退出 */
+     atomic_bool sleeping;         /* 后台线程是否处于等待状态 */
+     pthread_mutex_t wake_mutex;   /* 唤醒后台线程使用的互斥锁 */
+     pthread_cond_t wake_cond;     /* 唤醒后台线程使用的条件变量 */
+     atomic_uint flush_requested;  /* log_sink_flush 的请求序号 */
+     atomic_uint flush_completed;  /* 后台线程已完成的请求序号 */
+     atomic_ullong dropped;        /* 因队列已满丢弃的条数 */
+     atomic_bool emergency;        /* 正在紧急写出，后台线程暂停取日志 */
+     log_output_t *output;         /* 标准输出和文件 sink 的输出缓冲，崩溃时紧急写出；其他 sink 为NULL */
+     int output_fd;                /* 输出缓冲对应的文件描述符 */
+     bool colored;                 /* 紧急写出队列中的日志时是否加颜色 */
+ };
+ 
+ /* 标准输出 sink 使用的各级别颜色 */
+ static const char *sink_colors[] = {
+     "\033[36m", /* 青色 - DEBUG */
+     "\033[32m", /* 绿色 - INFO */
+     "\033[33m", /* 黄色 - WARN */
+     "\033[31m", /* 红色 - ERROR */
+     "\033[35m"  /* 紫色 - FATAL */
+ };
+ 
+ /* 重置颜色的ANSI转义序列 */
+ static const char *sink_color_reset = "\033[0m";
+ 
+ /**
+  * @brief 释放一个对共享记录的引用
+  *
+  * @param record 共享记录
+  */
+ static void record_release(sink_record_t *record) {
+     if (atomic_fetch_sub_explicit(&record->refs, 1, memory_order_acq_rel) == 1) {
+         free(record);
+     }
+ }
+ 
+ /**
+  * @brief 如果后台线程正在等待，则唤醒它
+  *
+  * @param sink sink
+  */
+ static void sink_wakeup(log_sink_t *sink) {
+     /* 与后台线程中的栅栏配对，保证“提交记录”与“检查等待标志”不会同时错过对方 */
+     atomic_thread_fence(memory_order_seq_cst);
+     if (atomic_load_explicit(&sink->sleeping, memory_order_relaxed)) {
+         pthread_mutex_lock(&sink->wake_mutex);
+         pthread_cond_signal(&sink->wake_cond);
+         pthread_mutex_unlock(&sink->wake_mutex);
+     }
+ }
+ 
+ /**
+  * @brief sink 的后台线程：取出队列中的日志逐条写出，每批结束后调用一次 flush
+  *
+  * @param arg sink
+  * @return NULL
+  */
+ static void *sink_main(void *arg) {
+     log_sink_t *sink = arg;
+     
+     for (;;) {
+         sink_record_t **slot;
+         bool wrote = false;
+         /* 先读取刷新请求，保证请求之前提交的日志都在本轮取出 */
+         unsigned int flush_request = atomic_load(&sink->flush_requested);
+         
+         /* 写出之后再释放槽位，崩溃时正在写的日志仍在队列中，最多重复一条 */
+         while (!atomic_load(&sink->emergency) && (slot = log_ring_peek(sink->queue)) != NULL) {
+             sink_record_t *record = *slot;
+             sink->ops.write(sink->ctx, record->level, record->data, record->len);
+             log_ring_release(sink->queue);
+             record_release(record);
+             wrote = true;
+         }
+         
+         if (wrote && sink->ops.flush) {
+             sink->ops.flush(sink->ctx);
+         }
+         atomic_store(&sink->flush_completed, flush_request);
+         
+         if (atomic_load(&sink->stop)) {
+             if (log_ring_empty(sink->queue)) {
+                 break;
+             }
+             continue;
+         }
+         
+         /* 队列为空，等待生产者唤醒 */
+         pthread_mutex_lock(&sink->wake_mutex);
+         atomic_store(&sink->sleeping, true);
+         atomic_thread_fence(memory_order_seq_cst);
+         if (log_ring_empty(sink->queue) &&
+             atomic_load(&sink->flush_requested) == flush_request &&
+             !atomic_load(&sink->stop)) {
+             struct timespec deadline;
+             clock_gettime(CLOCK_REALTIME, &deadline);
+             deadline.tv_sec += 1;
+             pthread_cond_timedwait(&sink->wake_cond, &sink->wake_mutex, &deadline);
+         }
+         atomic_store(&sink->sleeping, false);
+         pthread_mutex_unlock(&sink->wake_mutex);
+     }
+     
+     return NULL;
+ }
+ 
+ log_sink_t *log_sink_create(const log_sink_ops_t *ops, void *ctx, log_level_t min_level,
+                             size_t queue_size) {
+     log_sink_t *sink;
+     
+     if (!ops || !ops->write) {
+         return NULL;
+     }
+     
+     sink = calloc(1, sizeof(*sink));
+     if (!sink) {
+         if (ops->close) {
+             ops->close(ctx);
+         }
+         return NULL;
+     }
+     
+     sink->ops = *ops;
+     sink->ctx = ctx;
+     sink->min_level = min_level;
+     sink->queue = log_ring_create(queue_size ? queue_size : SINK_QUEUE_DEFAULT_SIZE,
+                                   sizeof(sink_record_t *));
+     if (!sink->queue) {
+         if (ops->close) {
+             ops->close(ctx);
+         }
+         free(sink);
+         return NULL;
+     }
+     
+     pthread_mutex_init(&sink->wake_mutex, NULL);
+     pthread_cond_init(&sink->wake_cond, NULL);
+     atomic_init(&sink->stop, false);
+     atomic_init(&sink->sleeping, false);
+     atomic_init(&sink->flush_requested, 0);
+     atomic_init(&sink->flush_completed, 0);
+     atomic_init(&sink->dropped, 0);
+     
+     if (pthread_create(&sink->thread, NULL, sink_main, sink) != 0) {
+         perror("pthread_create failed for log sink");
+         pthread_cond_destroy(&sink->wake_cond);
+         pthread_mutex_destroy(&sink->wake_mutex);
+         log_ring_destroy(sink->queue);
+         if (ops->close) {
+             ops->close(ctx);
+         }
+         free(sink);
+         return NULL;
+     }
+     
+     return sink;
+ }
+ 
+ void log_sink_dispatch(log_sink_t *const *sinks, size_t count, log_level_t level,
+                        const char *data, size_t len) {
+     sink_record_t *record = NULL;
+     
+     for (size_t i = 0; i < count; i++) {
+         log_sink_t *sink = sinks[i];
+         sink_record_t **slot;
+         size_t ticket;
+         
+         if (level < sink->min_level) {
+             continue;
+         }
+         
+         /* 至少有一个 sink 需要时才复制，分发期间由调用者持有一个引用 */
+         if (!record) {
+             record = malloc(sizeof(*record) + len);
+             if (!record) {
+                 return;
+             }
+             atomic_init(&record->refs, 1);
+             record->level = level;
+             record->len = len;
+             memcpy(record->data, data, len);
+         }
+         
+         /* 队列满时只丢弃这个 sink 的这条日志 */
+         slot = log_ring_reserve(sink->queue, &ticket);
+         if (!slot) {
+             atomic_fetch_add_explicit(&sink->dropped, 1, memory_order_relaxed);
+             continue;
+         }
+         
+         atomic_fetch_add_explicit(&record->refs, 1, memory_order_relaxed);
+         *slot = record;
+         log_ring_commit(sink->queue, ticket);
+         sink_wakeup(sink);
+     }
+     
+     if (record) {
+         record_release(record);
+     }
+ }
+ 
+ void log_sink_flush(log_sink_t *sink) {
+     unsigned int request;
+     
+     if (!sink) {
+         return;
+     }
+     
+     request = atomic_fetch_add(&sink->flush_requested, 1) + 1;
+     
+     pthread_mutex_lock(&sink->wake_mutex);
+     pthread_cond_signal(&sink->wake_cond);
+     pthread_mutex_unlock(&sink->wake_mutex);
+     
+     while ((int)(atomic_load(&sink->flush_completed) - request) < 0) {
+         sched_yield();
+     }
+ }
+ 
+ /**
+  * @brief 用 write 写出一段数据，处理中断和部分写出（异步信号安全）
+  *
+  * @param fd 文件描述符
+  * @param data 数据
+  * @param len 数据长度
+  */
+ static void emergency_write(int fd, const char *data, size_t len) {
+     while (len > 0) {
+         ssize_t n = write(fd, data, len);
+         if (n < 0 && errno == EINTR) {
+             continue;
+         }
+         if (n <= 0) {
+             return;
+         }
+         data += n;
+         len -= (size_t)n;
+     }
+ }
+ 
+ void log_sink_emergency_flush(log_sink_t *sink) {
+     sink_record_t **slot;
+     
+     if (!sink || !sink->output) {
+         return;
+     }
+     
+     atomic_store(&sink->emergency, true);
+     /* 先写出后台线程已经取出、停留在输出缓冲中的日志，再写出队列中更晚的日志 */
+     log_output_emergency_flush(sink->output);
+     for (size_t i = 0; (slot = log_ring_peek_at(sink->queue, i)) != NULL; i++) {
+         sink_record_t *record = *slot;
+         if (sink->colored) {
+             emergency_write(sink->output_fd, sink_colors[record->level], strlen(sink_colors[record->level]));
+         }
+         emergency_write(sink->output_fd, record->data, record->len);
+         if (sink->colored) {
+             emergency_write(sink->output_fd, sink_color_reset, strlen(sink_color_reset));
+         }
+     }
+     atomic_store(&sink->emergency, false);
+ }
+ 
+ unsigned long long log_sink_dropped(log_sink_t *sink) {
+     return sink ? atomic_load(&sink->dropped) : 0;
+ }
+ 
+ void log_sink_destroy(log_sink_t *sink) {
+     if (!sink) {
+         return;
+     }
+     
+     pthread_mutex_lock(&sink->wake_mutex);
+     atomic_store(&sink->stop, true);
+     pthread_cond_signal(&sink->wake_cond);
+     pthread_mutex_unlock(&sink->wake_mutex);
+     
+     pthread_join(sink->thread, NULL);
+     
+     if (sink->ops.close) {
+         sink->ops.close(sink->ctx);
+     }
+     pthread_cond_destroy(&sink->wake_cond);
+     pthread_mutex_destroy(&sink->wake_mutex);
+     log_ring_destroy(sink->queue);
+     free(sink);
+ }
+ 
+ /* 标准输出 sink：带颜色追加到输出缓冲，每批写出一次 */
+ 
+ static void stdout_write(void *ctx, log_level_t level, const char *data, size_t len) {
+     log_output_t *out = ctx;
+     
+     log_output_append_static(out, sink_colors[level], strlen(sink_colors[level]));
+     log_output_append(out, data, len);
+     log_output_append_static(out, sink_color_reset, strlen(sink_color_reset));
+ }
+ 
+ static void stdout_flush(void *ctx) {
+     log_output_flush(ctx);
+ }
+ 
+ static void stdout_close(void *ctx) {
+     log_output_destroy(ctx);
+ }
+ 
+ log_sink_t *log_sink_stdout(log_level_t min_level, size_t queue_size) {
+     static const log_sink_ops_t ops = { stdout_write, stdout_flush, stdout_close };
+     log_output_t *out = log_output_create(STDOUT_FILENO, SINK_OUTPUT_SIZE);
+     log_sink_t *sink;
+     
+     if (!out) {
+         return NULL;
+     }
+     sink = log_sink_create(&ops, out, min_level, queue_size);
+     if (sink) {
+         sink->output = out;
+         sink->output_fd = STDOUT_FILENO;
+         sink->colored = true;
+     }
+     return sink;
+ }
+ 
+ /* 文件 sink：追加到输出缓冲，每批写出一次 */
+ 
+ /* 文件 sink 的参数 */
+ typedef struct {
+     int fd;               /* 文件描述符 */
+     log_output_t *out;    /* 输出缓冲 */
+ } file_sink_t;
+ 
+ static void file_write(void *ctx, log_level_t level, const char *data, size_t len) {
+     file_sink_t *file = ctx;
+     
+     (void)level;
+     log_output_append(file->out, data, len);
+ }
+ 
+ static void file_flush(void *ctx) {
+     file_sink_t *file = ctx;
+     
+     log_output_flush(file->out);
+ }
+ 
+ static void file_close(void *ctx) {
+     file_sink_t *file = ctx;
+     
+     log_output_destroy(file->out);
+     close(file->fd);
+     free(file);
+ }
+ 
+ log_sink_t *log_sink_file(const char *filename, log_level_t min_level, size_t queue_size) {
+     static const log_sink_ops_t ops = { file_write, file_flush, file_close };
+     file_sink_t *file;
+     log_sink_t *sink;
+     
+     if (!filename) {
+         return NULL;
+     }
+     
+     file = calloc(1, sizeof(*file));
+     if (!file) {
+         return NULL;
+     }
+     
+     file->fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+     if (file->fd < 0) {
+         perror("Failed to open log sink file");
+         free(file);
+         return NULL;
+     }
+     
+     file->out = log_output_create(file->fd, SINK_OUTPUT_SIZE);
+     if (!file->out) {
+         close(file->fd);
+         free(file);
+         return NULL;
+     }
+     
+     sink = log_sink_create(&ops, file, min_level, queue_size);
+     if (sink) {
+         sink->output = file->out;
+         sink->output_fd = file->fd;
+     }
+     return sink;
+ }
+ 
+ /* 内存 sink：写入定长的环形缓冲，旧内容被覆盖 */
+ 
+ /* 内存 sink 的参数 */
+ typedef struct {
+     pthread_mutex_t mutex;    /* 保护读写 */
+     size_t capacity;          /* 缓冲区字节数 */
+     unsigned long long total; /* 累计写入的字节数 */
+     char buf[];               /* 缓冲区 */
+ } memory_sink_t;
+ 
+ static void memory_write(void *ctx, log_level_t level, const char *data, size_t len) {
+     memory_sink_t *mem = ctx;
+     size_t pos;
+     size_t first;
+     
+     (void)level;
+     pthread_mutex_lock(&mem->mutex);
+     
+     /* 比缓冲区还长的日志只保留末尾 */
+     mem->total += len;
+     if (len > mem->capacity) {
+         data += len - mem->capacity;
+         len = mem->capacity;
+     }
+     
+     pos = (size_t)((mem->total - len) % mem->capacity);
+     first = len < mem->capacity - pos ? len : mem->capacity - pos;
+     memcpy(mem->buf + pos, data, first);
+     memcpy(mem->buf, data + first, len - first);
+     
+     pthread_mutex_unlock(&mem->mutex);
+ }
+ 
+ static void memory_close(void *ctx) {
+     memory_sink_t *mem = ctx;
+     
+     pthread_mutex_destroy(&mem->mutex);
+     free(mem);
+ }
+ 
+ log_sink_t *log_sink_memory(size_t capacity, log_level_t min_level) {
+     static const log_sink_ops_t ops = { memory_write, NULL, memory_close };
+     memory_sink_t *mem;
+     
+     if (capacity == 0) {
+         return NULL;
+     }
+     
+     mem = malloc(sizeof(*mem) + capacity);
+     if (!mem) {
+         return NULL;
+     }
+     
+     pthread_mutex_init(&mem->mutex, NULL);
+     mem->capacity = capacity;
+     mem->total = 0;
+     
+     return log_sink_create(&ops, mem, min_level, 0);
+ }
+ 
+ size_t log_sink_memory_read(log_sink_t *sink, char *buf, size_t cap) {
+     memory_sink_t *mem;
+     size_t len;
+     size_t pos;
+     size_t first;
+     
+     if (!sink || sink->ops.write != memory_write || !buf) {
+         return 0;
+     }
+     
+     mem = sink->ctx;
+     pthread_mutex_lock(&mem->mutex);
+     
+     /* 缓冲区不够时只复制最近的部分 */
+     len = mem->total < mem->capacity ? (size_t)mem->total : mem->capacity;
+     if (len > cap) {
+         len = cap;
+     }
+     
+     pos = (size_t)((mem->total - len) % mem->capacity);
+     first = len < mem->capacity - pos ? len : mem->capacity - pos;
+     memcpy(buf, mem->buf + pos, first);
+     memcpy(buf + first, mem->buf, len - first);
+     
+     pthread_mutex_unlock(&mem->mutex);
+     return len;
+ }
+ 
+ /* Unix 套接字 sink：每条日志发送一个数据报，ctx 即套接字描述符 */
+ 
+ static void unix_write(void *ctx, log_level_t level, const char *data, size_t len) {
+     int fd = (int)(long)ctx;
+     
+     (void)level;
+     /* 不等待对端，接收缓冲区满时丢弃 */
+     (void)send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+ }
+ 
+ static void unix_close(void *ctx) {
+     close((int)(long)ctx);
+ }
+ 
+ log_sink_t *log_sink_unix(const char *path, log_level_t min_level, size_t queue_size) {
+     static const log_sink_ops_t ops = { unix_write, NULL, unix_close };
+     struct sockaddr_un addr;
+     int fd;
+     
+     if (!path || strlen(path) >= sizeof(addr.sun_path)) {
+         return NULL;
+     }
+     
+     fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+     if (fd < 0) {
+         perror("Failed to create log sink socket");
+         return NULL;
+     }
+     
+     memset(&addr, 0, sizeof(addr));
+     addr.sun_family = AF_UNIX;
+     strcpy(addr.sun_path, path);
+     if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+         perror("Failed to connect log sink socket");
+         close(fd);
+         return NULL;
+     }
+     
+     return log_sink_create(&ops, (void *)(long)fd, min_level, queue_size);
+ }
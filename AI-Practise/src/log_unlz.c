@@ -0,0 +1,69 @@
+/**
+ * @file log_unlz.c
+ * @brief 压缩日志解压工具
+ *
+ * 将轮转后压缩的日志文件（.lz）解压输出
+ * 用法: log_unlz <压缩日志文件> [输出文件]
+ */
+ 
+ #include "log_lz.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ 
+ /* 每次读取的缓冲区大小 */
+ #define READ_BUFFER_SIZE 65536
+ 
+ int main(int argc, char *argv[]) {
+     static char buffer[READ_BUFFER_SIZE];
+     FILE *in;
+     FILE *out = stdout;
+     log_lz_reader_t *reader;
+     long len;
+     int ret = 0;
+     
+     if (argc < 2 || argc > 3) {
+         fprintf(stderr, "用法: %s <压缩日志文件> [输出文件]\n", argv[0]);
+         return 1;
+     }
+     
+     in = fopen(argv[1], "rb");
+     if (!in) {
+         perror("Failed to open compressed log file");
+         return 1;
+     }
+     
+     if (argc == 3) {
+         out = fopen(argv[2], "w");
+         if (!out) {
+             perror("Failed to open output file");
+             fclose(in);
+             return 1;
+         }
+     }
+     
+     reader = log_lz_reader_open(in);
+     if (!reader) {
+         fclose(in);
+         if (out != stdout) {
+             fclose(out);
+         }
+         return 1;
+     }
+     
+     while ((len = log_lz_read(reader, buffer, sizeof(buffer))) > 0) {
+         fwrite(buffer, 1, (size_t)len, out);
+     }
+     
+     if (len < 0) {
+         fprintf(stderr, "Corrupted compressed log at offset %ld\n", ftell(in));
+         ret = 1;
+     }
+     
+     log_lz_reader_close(reader);
+     fclose(in);
+     if (out != stdout) {
+         fclose(out);
+     }
+     
+     return ret;
+ }
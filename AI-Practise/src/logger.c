@@ -4,39 +4,139 @@
  * 
  * 实现了日志系统的各项功能，包括初始化、销毁、设置日志级别和日志打印
  */
-
+ 
  #include "logger.h"
  #include "log_filter.h"
+ #include "log_ring.h"
+ #include "log_binary.h"
+ #include "log_clock.h"
+ #include "log_output.h"
+ #include "log_mmap.h"
+ #include "log_rotate.h"
+ #include "log_governor.h"
+ #include "log_kv.h"
+ #include "log_sink.h"
+ #include "log_recorder.h"
  #include <stdlib.h>
  #include <string.h>
  #include <time.h>
  #include <pthread.h>
  #include <unistd.h>
  #include <sys/stat.h>
- #include <sys/time.h>
  #include <stdarg.h>
+ #include <sched.h>
+ #include <stdatomic.h>
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <errno.h>
  
  /* 日志缓冲区大小 */
  #define LOG_BUFFER_SIZE 4096
  /* 用户消息缓冲区大小 */
  #define USER_MSG_BUFFER_SIZE 2048
+ /* 日志缓冲区中为前缀预留的空间，用户消息格式化到其后，前缀在过滤之后补到消息之前 */
+ #define LOG_PREFIX_RESERVE 512
+ /* 异步队列默认容量（条数） */
+ #define ASYNC_QUEUE_DEFAULT_SIZE 1024
+ /* 后台写线程空闲时的最长等待时间（毫秒） */
+ #define ASYNC_IDLE_WAIT_MS 100
+ /* 输出缓冲区默认大小，同时也是 LOG_FLUSH_BYTES 的默认阈值 */
+ #define FLUSH_BYTES_DEFAULT (64 * 1024)
+ /* LOG_FLUSH_INTERVAL 的默认间隔（毫秒） */
+ #define FLUSH_INTERVAL_DEFAULT_MS 1000
+ /* 内存映射日志文件的默认段大小 */
+ #define MMAP_SEGMENT_DEFAULT_SIZE (16 * 1024 * 1024)
+ /* 轮转后默认保留的历史文件个数 */
+ #define ROTATE_KEEP_DEFAULT 5
+ /* 按调用点过滤：1分钟内调用达到此次数时开始屏蔽 */
+ #define CALLSITE_FLOOD_PER_MIN 60
+ /* 按调用点过滤：屏蔽持续的时间（秒） */
+ #define CALLSITE_SUPPRESS_SEC 3600
+ /* 关闭所有级别时的日志级别 */
+ #define LOG_LEVEL_DISABLED (LOG_LEVEL_FATAL + 1)
+ /* 流量控制的令牌桶容量（毫秒） */
+ #define GOVERNOR_BURST_MS 1000
+ /* 统计计数的分组数，各线程轮流分到不同的组，减少线程间争用 */
+ #define STATS_STRIPES 16
+ /* 缓存行大小，统计计数按缓存行对齐 */
+ #define CACHE_LINE_SIZE 64
+ 
+ /* 崩溃时紧急写出日志的信号 */
+ static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+ #define CRASH_SIGNAL_COUNT (sizeof(crash_signals) / sizeof(crash_signals[0]))
+ 
+ /* 异步队列中的一条日志记录 */
+ typedef struct {
+     size_t len;                  /* 日志长度 */
+     log_level_t level;           /* 日志级别 */
+     char data[LOG_BUFFER_SIZE];  /* 格式化完成的日志内容 */
+ } async_record_t;
  
  /* 日志系统状态 */
  static struct {
-     FILE *log_file;              /* 日志文件句柄 */
-     log_level_t log_level;       /* 当前日志级别 */
+     int log_fd;                  /* 日志文件描述符，-1表示只输出到标准输出 */
+     log_output_t *stdout_out;    /* 标准输出的输出缓冲，二进制格式下为NULL */
+     log_output_t *file_out;      /* 日志文件的输出缓冲，没有日志文件或使用内存映射时为NULL */
+     log_mmap_t *file_map;        /* 内存映射的日志文件，未使用内存映射时为NULL */
+     log_rotate_t *rotate;        /* 日志文件轮转器，不轮转时为NULL */
+     log_governor_t *governor;    /* 流量控制器，不限制速率时为NULL */
+     atomic_ullong dropped[LOG_LEVEL_FATAL + 1]; /* 各级别因超出流量限制被丢弃的日志条数 */
+     atomic_ullong write_latency[LOG_STATS_LATENCY_BUCKETS]; /* 写出耗时的直方图 */
+     log_sink_t *sinks[LOG_MAX_SINKS]; /* 额外的输出目标 */
+     size_t sink_count;           /* 输出目标个数，只增不减，直到销毁 */
+     size_t recorder_size;        /* 每个线程的飞行记录器字节数，0表示不启用 */
+     unsigned int flush_policy;   /* 刷新策略 */
+     size_t flush_bytes;          /* LOG_FLUSH_BYTES 的阈值 */
+     long long flush_interval_ms; /* LOG_FLUSH_INTERVAL 的间隔 */
+     long long last_flush_ms;     /* 上次写出的时间（单调时钟） */
      log_mode_t log_mode;         /* 当前日志模式 */
+     log_format_t format;         /* 输出格式 */
+     unsigned int session;        /* 当前会话号，每次初始化递增，用于判断调用点编号是否有效 */
+     unsigned int next_site_id;   /* 二进制模式下下一个调用点编号 */
      bool initialized;            /* 初始化标志 */
-     pthread_mutex_t mutex;       /* 互斥锁，保证多线程安全 */
-     char buffer[LOG_BUFFER_SIZE]; /* 日志缓冲区 */
-     char user_msg[USER_MSG_BUFFER_SIZE]; /* 用户消息缓冲区，用于过滤 */
+     pthread_mutex_t mutex;       /* 互斥锁，保护同步模式下的输出 */
+     log_ring_t *ring;            /* 异步队列，非异步模式下为NULL */
+     pthread_t writer;            /* 后台写线程 */
+     atomic_bool writer_stop;     /* 通知写线程退出 */
+     atomic_bool writer_sleeping; /* 写线程是否处于等待状态 */
+     pthread_mutex_t wake_mutex;  /* 唤醒写线程使用的互斥锁 */
+     pthread_cond_t wake_cond;    /* 唤醒写线程使用的条件变量 */
+     atomic_uint flush_requested; /* 异步模式下 log_flush 的请求序号 */
+     atomic_uint flush_completed; /* 异步模式下写线程已完成的请求序号 */
+     pthread_t flusher;           /* 同步模式下按时间间隔写出的后台线程 */
+     bool flusher_running;        /* 按时间写出的后台线程是否在运行 */
+     unsigned int summary_interval_sec; /* 被过滤日志的汇总间隔（秒） */
+     long long last_summary_ms;   /* 上次汇总的时间（单调时钟） */
+     pthread_t summarizer;        /* 定期汇总被过滤日志的后台线程 */
+     bool summarizer_running;     /* 汇总线程是否在运行 */
+     atomic_bool summarizer_stop; /* 通知汇总线程退出 */
+     pthread_mutex_t summary_mutex; /* 唤醒汇总线程使用的互斥锁 */
+     pthread_cond_t summary_cond; /* 唤醒汇总线程使用的条件变量 */
+     bool crash_installed;        /* 是否安装了崩溃信号处理函数 */
+     struct sigaction crash_old[CRASH_SIGNAL_COUNT]; /* 安装之前的信号处理方式 */
+     atomic_bool emergency_active; /* 正在紧急写出，多个线程同时崩溃时只写出一次 */
  } logger_state = {
-     .log_file = NULL,
-     .log_level = LOG_LEVEL_INFO,
+     .log_fd = -1,
      .log_mode = LOG_MODE_NORMAL,
      .initialized = false
  };
  
+ /* 线程私有的格式化缓冲区，格式化过程无需持有全局锁 */
+ static _Thread_local char tls_buffer[LOG_BUFFER_SIZE];       /* 日志缓冲区 */
+ static _Thread_local char tls_user_msg[USER_MSG_BUFFER_SIZE]; /* 用户消息缓冲区，用于过滤 */
+ static _Thread_local char tls_json[LOG_BUFFER_SIZE];         /* JSON 格式的日志记录 */
+ 
+ /* 一组统计计数，独占缓存行 */
+ typedef struct {
+     atomic_ullong emitted[LOG_LEVEL_FATAL + 1]; /* 各级别写出的日志条数 */
+     atomic_ullong bytes;                        /* 写出的字节数 */
+     atomic_ullong callsite_suppressed;          /* 按调用点屏蔽的条数 */
+ } __attribute__((aligned(CACHE_LINE_SIZE))) stats_stripe_t;
+ 
+ static stats_stripe_t stats_stripes[STATS_STRIPES];
+ static atomic_uint stats_next_stripe;
+ static _Thread_local stats_stripe_t *tls_stripe; /* 本线程使用的统计计数组 */
+ 
  /* 日志级别对应的字符串表示 */
  static const char *level_strings[] = {
      "DEBUG",
@@ -55,174 +155,1910 @@
      "\033[35m"  /* 紫色 - FATAL */
  };
  
+ /* 流量控制时各级别需要保留的令牌百分比：低级别先被丢弃，ERROR和FATAL总是写出 */
+ static const int governor_reserve_pct[] = {
+     50, /* DEBUG */
+     25, /* INFO */
+     0,  /* WARN */
+     -1, /* ERROR */
+     -1  /* FATAL */
+ };
+ 
  /* 重置颜色的ANSI转义序列 */
  static const char *color_reset = "\033[0m";
  
- int log_init(const char *filename, log_level_t level, log_mode_t mode) {
-     /* 已经初始化则先销毁 */
-     if (logger_state.initialized) {
-         log_destroy();
+ /* 当前全局日志级别；未初始化时所有级别都关闭 */
+ static int log_runtime_level = LOG_LEVEL_DISABLED;
+ 
+ /* 级别生成号，从1开始，使零初始化的调用点缓存一定失效 */
+ unsigned int log_level_generation = 1;
+ 
+ /* 模块日志级别表，可以在初始化之前设置，不随日志系统销毁；只在调用点缓存失效时查找 */
+ static struct {
+     pthread_mutex_t mutex;
+     size_t count;
+     struct {
+         char name[LOG_MODULE_NAME_MAX];
+         log_level_t level;
+     } entries[LOG_MAX_MODULES];
+ } module_levels = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+ 
+ /* 会话计数器，跨多次初始化保持递增 */
+ static unsigned int session_counter = 0;
+ 
+ /**
+  * @brief 全局或模块日志级别改变后递增级别生成号，使所有调用点的级别缓存失效
+  * 
+  * 生成号只用低30位，与调用点缓存中的两个标志位拼成一个整数
+  */
+ static void level_changed(void) {
+     unsigned int old = __atomic_load_n(&log_level_generation, __ATOMIC_RELAXED);
+     unsigned int next;
+     
+     do {
+         next = (old + 1) & (~0u >> LOG_SITE_GEN_SHIFT);
+         if (next == 0) {
+             next = 1;
+         }
+     } while (!__atomic_compare_exchange_n(&log_level_generation, &old, next, true,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+ }
+ 
+ /**
+  * @brief 获取本线程使用的统计计数组，第一次调用时分配
+  * 
+  * @return 统计计数组
+  */
+ static inline stats_stripe_t *stats_stripe(void) {
+     if (__builtin_expect(!tls_stripe, 0)) {
+         tls_stripe = &stats_stripes[atomic_fetch_add_explicit(&stats_next_stripe, 1, memory_order_relaxed) %
+                                     STATS_STRIPES];
      }
+     return tls_stripe;
+ }
+ 
+ /**
+  * @brief 统计一条写出的日志
+  * 
+  * @param level 日志级别
+  * @param len 日志长度
+  */
+ static inline void stats_emitted(log_level_t level, size_t len) {
+     stats_stripe_t *stripe = stats_stripe();
      
-     /* 初始化互斥锁 */
-     if (pthread_mutex_init(&logger_state.mutex, NULL) != 0) {
-         perror("pthread_mutex_init failed");
-         return -1;
+     atomic_fetch_add_explicit(&stripe->emitted[level], 1, memory_order_relaxed);
+     atomic_fetch_add_explicit(&stripe->bytes, len, memory_order_relaxed);
+ }
+ 
+ /**
+  * @brief 统计清零，在初始化时调用
+  */
+ static void stats_reset(void) {
+     for (int i = 0; i < STATS_STRIPES; i++) {
+         for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_FATAL; level++) {
+             atomic_store(&stats_stripes[i].emitted[level], 0);
+         }
+         atomic_store(&stats_stripes[i].bytes, 0);
+         atomic_store(&stats_stripes[i].callsite_suppressed, 0);
+     }
+     for (int i = 0; i < LOG_STATS_LATENCY_BUCKETS; i++) {
+         atomic_store(&logger_state.write_latency[i], 0);
      }
+ }
+ 
+ /**
+  * @brief 获取单调时钟（毫秒）
+  * 
+  * @return 毫秒数
+  */
+ static long long monotonic_ms(void) {
+     struct timespec ts;
      
-     /* 设置日志级别和模式 */
-     logger_state.log_level = level;
-     logger_state.log_mode = mode;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+ }
+ 
+ /**
+  * @brief 计算条件变量等待的截止时间
+  * 
+  * @param deadline 输出参数，截止时间（CLOCK_REALTIME）
+  * @param ms 从现在起的毫秒数
+  */
+ static void deadline_after_ms(struct timespec *deadline, long long ms) {
+     clock_gettime(CLOCK_REALTIME, deadline);
+     deadline->tv_sec += (time_t)(ms / 1000);
+     deadline->tv_nsec += (long)(ms % 1000) * 1000000L;
+     if (deadline->tv_nsec >= 1000000000L) {
+         deadline->tv_sec++;
+         deadline->tv_nsec -= 1000000000L;
+     }
+ }
+ 
+ /**
+  * @brief 将一条格式化完成的日志追加到标准输出的输出缓冲
+  * 
+  * 调用者需保证同一时刻只有一个线程写出（同步模式持有全局锁，异步模式为写线程）
+  * 
+  * @param level 日志级别
+  * @param data 日志内容
+  * @param len 日志长度
+  */
+ static void write_stdout(log_level_t level, const char *data, size_t len) {
+     /* 二进制日志只写入日志文件；JSON 日志不加颜色 */
+     if (logger_state.stdout_out && logger_state.format == LOG_FORMAT_JSON) {
+         log_output_append(logger_state.stdout_out, data, len);
+     } else if (logger_state.stdout_out) {
+         log_output_append_static(logger_state.stdout_out, level_colors[level], strlen(level_colors[level]));
+         log_output_append(logger_state.stdout_out, data, len);
+         log_output_append_static(logger_state.stdout_out, color_reset, strlen(color_reset));
+     }
+ }
+ 
+ /**
+  * @brief 将一条日志写入日志文件
+  * 
+  * 内存映射方式可多线程并发调用；否则追加到输出缓冲，要求同 write_stdout
+  * 
+  * @param data 日志内容
+  * @param len 日志长度
+  */
+ static void write_file(const char *data, size_t len) {
+     if (logger_state.file_map) {
+         log_mmap_write(logger_state.file_map, data, len);
+         return;
+     }
      
-     /* 如果提供了文件名，打开日志文件 */
-     if (filename) {
-         logger_state.log_file = fopen(filename, "a");
-         if (!logger_state.log_file) {
-             perror("Failed to open log file");
-             pthread_mutex_destroy(&logger_state.mutex);
-             return -1;
+     if (!logger_state.file_out) {
+         return;
+     }
+     
+     /* 需要轮转时先把缓冲的数据写到旧文件，再换成预先打开的新文件 */
+     if (logger_state.rotate && log_rotate_due(logger_state.rotate, len)) {
+         log_output_flush(logger_state.file_out);
+         logger_state.log_fd = log_rotate_switch(logger_state.rotate, logger_state.log_fd);
+         log_output_set_fd(logger_state.file_out, logger_state.log_fd);
+         /* 新文件为空，此时只会把本条日志计入新文件的大小 */
+         log_rotate_due(logger_state.rotate, len);
+     }
+     
+     log_output_append(logger_state.file_out, data, len);
+ }
+ 
+ /**
+  * @brief 将一条格式化完成的日志写到标准输出和日志文件
+  * 
+  * @param level 日志级别
+  * @param data 日志内容
+  * @param len 日志长度
+  */
+ static void write_record(log_level_t level, const char *data, size_t len) {
+     write_stdout(level, data, len);
+     write_file(data, len);
+ }
+ 
+ /**
+  * @brief 获取输出缓冲中尚未写出的字节数（取两路中较多者）
+  * 
+  * @return 待写字节数
+  */
+ static size_t pending_bytes(void) {
+     size_t pending = 0;
+     
+     if (logger_state.stdout_out) {
+         pending = log_output_pending(logger_state.stdout_out);
+     }
+     if (logger_state.file_out && log_output_pending(logger_state.file_out) > pending) {
+         pending = log_output_pending(logger_state.file_out);
+     }
+     
+     return pending;
+ }
+ 
+ /**
+  * @brief 将输出缓冲中的日志写出到标准输出和日志文件
+  */
+ static void flush_outputs(void) {
+     struct timespec start;
+     struct timespec end;
+     long long ns;
+     int bucket = 0;
+     bool pending = pending_bytes() > 0;
+     
+     clock_gettime(CLOCK_MONOTONIC, &start);
+     
+     if (logger_state.stdout_out) {
+         /* 先写出调用者自己通过stdio打印的内容，保持与日志的先后顺序 */
+         fflush(stdout);
+         log_output_flush(logger_state.stdout_out);
+     }
+     
+     if (logger_state.file_out) {
+         log_output_flush(logger_state.file_out);
+     }
+     
+     /* 有数据写出时按耗时的最高位计入直方图 */
+     clock_gettime(CLOCK_MONOTONIC, &end);
+     ns = (long long)(end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+     if (pending) {
+         if (ns > 1) {
+             bucket = 63 - __builtin_clzll((unsigned long long)ns);
          }
-         
-         /* 设置文件缓冲区为行缓冲，确保日志及时写入 */
-         setvbuf(logger_state.log_file, NULL, _IOLBF, 0);
+         if (bucket >= LOG_STATS_LATENCY_BUCKETS) {
+             bucket = LOG_STATS_LATENCY_BUCKETS - 1;
+         }
+         atomic_fetch_add_explicit(&logger_state.write_latency[bucket], 1, memory_order_relaxed);
      }
      
-     /* 初始化日志过滤器 */
-     if (filter_init() != 0) {
-         if (logger_state.log_file) {
-             fclose(logger_state.log_file);
-             logger_state.log_file = NULL;
+     logger_state.last_flush_ms = end.tv_sec * 1000LL + end.tv_nsec / 1000000;
+ }
+ 
+ /**
+  * @brief 根据刷新策略判断是否需要写出
+  * 
+  * @param level 本批日志中的最高级别
+  * @return 需要写出返回true
+  */
+ static bool flush_due(log_level_t level) {
+     unsigned int policy = logger_state.flush_policy;
+     
+     if (policy & LOG_FLUSH_RECORD) {
+         return true;
+     }
+     if ((policy & LOG_FLUSH_ON_ERROR) && level >= LOG_LEVEL_ERROR) {
+         return true;
+     }
+     if ((policy & LOG_FLUSH_BYTES) && pending_bytes() >= logger_state.flush_bytes) {
+         return true;
+     }
+     if ((policy & LOG_FLUSH_INTERVAL) &&
+         monotonic_ms() - logger_state.last_flush_ms >= logger_state.flush_interval_ms) {
+         return true;
+     }
+     
+     return false;
+ }
+ 
+ /**
+  * @brief 按刷新策略写出，在追加日志之后调用
+  * 
+  * @param level 本批日志中的最高级别
+  */
+ static void flush_if_due(log_level_t level) {
+     if (pending_bytes() > 0 && flush_due(level)) {
+         flush_outputs();
+     }
+ }
+ 
+ /**
+  * @brief 如果后台写线程正在等待，则唤醒它
+  */
+ static void async_wakeup(void) {
+     /* 与写线程中的栅栏配对，保证“提交记录”与“检查等待标志”不会同时错过对方 */
+     atomic_thread_fence(memory_order_seq_cst);
+     if (atomic_load_explicit(&logger_state.writer_sleeping, memory_order_relaxed)) {
+         pthread_mutex_lock(&logger_state.wake_mutex);
+         pthread_cond_signal(&logger_state.wake_cond);
+         pthread_mutex_unlock(&logger_state.wake_mutex);
+     }
+ }
+ 
+ /**
+  * @brief 将一条日志放入异步队列
+  * 
+  * 队列满时让出CPU等待写线程腾出空间，保证日志不丢失
+  * 
+  * @param level 日志级别
+  * @param data 日志内容
+  * @param len 日志长度
+  */
+ static void async_enqueue(log_level_t level, const char *data, size_t len) {
+     async_record_t *record;
+     size_t ticket;
+     
+     while ((record = log_ring_reserve(logger_state.ring, &ticket)) == NULL) {
+         async_wakeup();
+         sched_yield();
+     }
+     
+     record->level = level;
+     record->len = len;
+     memcpy(record->data, data, len);
+     log_ring_commit(logger_state.ring, ticket);
+     
+     async_wakeup();
+ }
+ 
+ /**
+  * @brief 后台写线程：取出队列中的日志并批量写出
+  * 
+  * @param arg 未使用
+  * @return NULL
+  */
+ static void *async_writer_main(void *arg) {
+     (void)arg;
+     
+     for (;;) {
+         async_record_t *record;
+         log_level_t max_level = LOG_LEVEL_DEBUG;
+         /* 先读取刷新请求，保证请求之前提交的日志都在本轮取出 */
+         unsigned int flush_request = atomic_load(&logger_state.flush_requested);
+         long long wait_ms = ASYNC_IDLE_WAIT_MS;
+         
+         /* 取出当前所有已提交的日志，整批追加到输出缓冲；紧急写出期间暂停，
+            以免取出的日志既不在队列中也来不及写出 */
+         while (!atomic_load(&logger_state.emergency_active) &&
+                (record = log_ring_peek(logger_state.ring)) != NULL) {
+             write_record(record->level, record->data, record->len);
+             if (record->level > max_level) {
+                 max_level = record->level;
+             }
+             log_ring_release(logger_state.ring);
          }
-         pthread_mutex_destroy(&logger_state.mutex);
+         
+         /* 按刷新策略整批写出；有刷新请求或即将退出时无条件写出 */
+         if (flush_request != atomic_load(&logger_state.flush_completed) ||
+             atomic_load(&logger_state.writer_stop)) {
+             flush_outputs();
+         } else {
+             flush_if_due(max_level);
+         }
+         atomic_store(&logger_state.flush_completed, flush_request);
+         
+         if (atomic_load(&logger_state.writer_stop)) {
+             if (log_ring_empty(logger_state.ring)) {
+                 break;
+             }
+             continue;
+         }
+         
+         /* 还有未写出的数据时，最多等到刷新间隔到期 */
+         if ((logger_state.flush_policy & LOG_FLUSH_INTERVAL) && pending_bytes() > 0) {
+             long long remain = logger_state.last_flush_ms + logger_state.flush_interval_ms - monotonic_ms();
+             wait_ms = remain < wait_ms ? (remain > 0 ? remain : 0) : wait_ms;
+         }
+         
+         /* 队列为空，等待生产者唤醒 */
+         pthread_mutex_lock(&logger_state.wake_mutex);
+         atomic_store(&logger_state.writer_sleeping, true);
+         atomic_thread_fence(memory_order_seq_cst);
+         if (wait_ms > 0 && log_ring_empty(logger_state.ring) &&
+             atomic_load(&logger_state.flush_requested) == flush_request &&
+             !atomic_load(&logger_state.writer_stop)) {
+             struct timespec deadline;
+             deadline_after_ms(&deadline, wait_ms);
+             pthread_cond_timedwait(&logger_state.wake_cond, &logger_state.wake_mutex, &deadline);
+         }
+         atomic_store(&logger_state.writer_sleeping, false);
+         pthread_mutex_unlock(&logger_state.wake_mutex);
+     }
+     
+     return NULL;
+ }
+ 
+ /**
+  * @brief 启动异步队列和后台写线程
+  * 
+  * @param queue_size 队列容量（条数），0表示使用默认值
+  * @return 成功返回0，失败返回-1
+  */
+ static int async_start(size_t queue_size) {
+     logger_state.ring = log_ring_create(queue_size ? queue_size : ASYNC_QUEUE_DEFAULT_SIZE,
+                                         sizeof(async_record_t));
+     if (!logger_state.ring) {
          return -1;
      }
      
-     logger_state.initialized = true;
+     atomic_store(&logger_state.writer_stop, false);
+     atomic_store(&logger_state.writer_sleeping, false);
+     atomic_store(&logger_state.flush_requested, 0);
+     atomic_store(&logger_state.flush_completed, 0);
      
-     /* 打印初始化成功的日志 */
-     log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, 
-             "Log system initialized successfully (level=%s, mode=%s, file=%s)",
-             level_strings[level], mode == LOG_MODE_NORMAL ? "normal" : "filter",
-             filename ? filename : "stdout");
+     if (pthread_create(&logger_state.writer, NULL, async_writer_main, NULL) != 0) {
+         perror("pthread_create failed for log writer");
+         log_ring_destroy(logger_state.ring);
+         logger_state.ring = NULL;
+         return -1;
+     }
      
      return 0;
  }
  
- void log_destroy(void) {
-     if (!logger_state.initialized) {
+ /**
+  * @brief 通知后台写线程写完剩余日志后退出，并释放异步队列
+  */
+ static void async_stop(void) {
+     if (!logger_state.ring) {
          return;
      }
      
-     pthread_mutex_lock(&logger_state.mutex);
-     
-     /* 关闭日志文件 */
-     if (logger_state.log_file) {
-         fclose(logger_state.log_file);
-         logger_state.log_file = NULL;
-     }
-     
-     logger_state.initialized = false;
+     pthread_mutex_lock(&logger_state.wake_mutex);
+     atomic_store(&logger_state.writer_stop, true);
+     pthread_cond_signal(&logger_state.wake_cond);
+     pthread_mutex_unlock(&logger_state.wake_mutex);
      
-     pthread_mutex_unlock(&logger_state.mutex);
-     pthread_mutex_destroy(&logger_state.mutex);
+     pthread_join(logger_state.writer, NULL);
      
-     /* 销毁日志过滤器 */
-     filter_destroy();
+     log_ring_destroy(logger_state.ring);
+     logger_state.ring = NULL;
  }
  
- void log_set_level(log_level_t level) {
-     if (level >= LOG_LEVEL_DEBUG && level <= LOG_LEVEL_FATAL) {
+ /**
+  * @brief 同步模式下按时间间隔写出的后台线程
+  * 
+  * 保证 LOG_FLUSH_INTERVAL 策略下即使没有新日志，已缓冲的日志也会在间隔内写出
+  * 
+  * @param arg 未使用
+  * @return NULL
+  */
+ static void *flusher_main(void *arg) {
+     (void)arg;
+     
+     pthread_mutex_lock(&logger_state.wake_mutex);
+     while (!atomic_load(&logger_state.writer_stop)) {
+         struct timespec deadline;
+         deadline_after_ms(&deadline, logger_state.flush_interval_ms);
+         pthread_cond_timedwait(&logger_state.wake_cond, &logger_state.wake_mutex, &deadline);
+         if (atomic_load(&logger_state.writer_stop)) {
+             break;
+         }
+         pthread_mutex_unlock(&logger_state.wake_mutex);
+         
          pthread_mutex_lock(&logger_state.mutex);
-         logger_state.log_level = level;
+         flush_if_due(LOG_LEVEL_DEBUG);
          pthread_mutex_unlock(&logger_state.mutex);
+         
+         pthread_mutex_lock(&logger_state.wake_mutex);
      }
+     pthread_mutex_unlock(&logger_state.wake_mutex);
+     
+     return NULL;
  }
  
- void log_set_mode(log_mode_t mode) {
-     pthread_mutex_lock(&logger_state.mutex);
-     logger_state.log_mode = mode;
-     pthread_mutex_unlock(&logger_state.mutex);
+ /**
+  * @brief 停止按时间间隔写出的后台线程，不能在持有全局锁时调用
+  */
+ static void flusher_stop(void) {
+     if (!logger_state.flusher_running) {
+         return;
+     }
+     
+     pthread_mutex_lock(&logger_state.wake_mutex);
+     atomic_store(&logger_state.writer_stop, true);
+     pthread_cond_signal(&logger_state.wake_cond);
+     pthread_mutex_unlock(&logger_state.wake_mutex);
+     
+     pthread_join(logger_state.flusher, NULL);
+     logger_state.flusher_running = false;
  }
  
- void log_print(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...) {
-     struct timeval tv;
-     struct tm *tm_info;
-     time_t timer;
-     char time_str[32]; /* 时间字符串缓冲区 */
+ static void log_vprint(log_level_t level, const char *file, int line, const char *func,
+                        const char *fmt, va_list args, bool site_checked);
+ 
+ /**
+  * @brief 输出一条日志系统自身的日志，不经过过滤
+  * 
+  * @param level 日志级别
+  * @param fmt 格式化字符串
+  * @param ... 参数列表
+  */
+ static void log_internal(log_level_t level, const char *fmt, ...) {
      va_list args;
-     bool should_filter = false;
-     int log_len;
-     int user_msg_len;
      
-     /* 检查日志级别 */
-     if (level < logger_state.log_level || !logger_state.initialized) {
+     va_start(args, fmt);
+     log_vprint(level, __FILE__, __LINE__, __func__, fmt, args, true);
+     va_end(args);
+ }
+ 
+ /**
+  * @brief 为一条被过滤的日志输出汇总行
+  * 
+  * @param tag 过滤键中的日志级别
+  * @param content 日志内容，只保存指纹时为NULL
+  * @param content_len 日志内容长度
+  * @param fingerprint 日志的指纹
+  * @param count 被过滤的次数
+  * @param arg 汇总间隔（秒）
+  */
+ static void summary_report(unsigned int tag, const char *content, size_t content_len,
+                            uint64_t fingerprint, unsigned int count, void *arg) {
+     unsigned int elapsed = *(const unsigned int *)arg;
+     log_level_t level = tag <= LOG_LEVEL_FATAL ? (log_level_t)tag : LOG_LEVEL_WARN;
+     
+     if (!content) {
+         log_internal(level, "suppressed %u occurrences in last %us: fingerprint %016llx",
+                      count, elapsed, (unsigned long long)fingerprint);
          return;
      }
      
-     /* 获取当前时间 */
-     gettimeofday(&tv, NULL);
-     timer = tv.tv_sec;
-     tm_info = localtime(&timer);
+     /* 去掉日志内容末尾的换行符 */
+     if (content_len > 0 && content[content_len - 1] == '\n') {
+         content_len--;
+     }
+     log_internal(level, "suppressed %u occurrences in last %us: %.*s",
+                  count, elapsed, (int)content_len, content);
+ }
+ 
+ /**
+  * @brief 汇总上次汇总之后被过滤的日志，每条日志输出一行
+  */
+ static void summary_emit(void) {
+     long long now = monotonic_ms();
+     unsigned int elapsed = (unsigned int)((now - logger_state.last_summary_ms + 999) / 1000);
      
-     /* 格式化时间字符串 */
-     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+     /* 不足1秒按1秒计 */
+     if (elapsed == 0) {
+         elapsed = 1;
+     }
+     logger_state.last_summary_ms = now;
+     filter_report_suppressed(summary_report, &elapsed);
+ }
+ 
+ /**
+  * @brief 定期汇总被过滤日志的后台线程，退出前再汇总一次
+  * 
+  * @param arg 未使用
+  * @return NULL
+  */
+ static void *summarizer_main(void *arg) {
+     (void)arg;
      
-     pthread_mutex_lock(&logger_state.mutex);
+     pthread_mutex_lock(&logger_state.summary_mutex);
+     while (!atomic_load(&logger_state.summarizer_stop)) {
+         struct timespec deadline;
+         deadline_after_ms(&deadline, (long long)logger_state.summary_interval_sec * 1000);
+         pthread_cond_timedwait(&logger_state.summary_cond, &logger_state.summary_mutex, &deadline);
+         if (atomic_load(&logger_state.summarizer_stop)) {
+             break;
+         }
+         pthread_mutex_unlock(&logger_state.summary_mutex);
+         
+         summary_emit();
+         
+         pthread_mutex_lock(&logger_state.summary_mutex);
+     }
+     pthread_mutex_unlock(&logger_state.summary_mutex);
      
-     /* 首先格式化用户消息部分，仅用于过滤比较 */
-     va_start(args, fmt);
-     user_msg_len = vsnprintf(logger_state.user_msg, USER_MSG_BUFFER_SIZE, fmt, args);
-     va_end(args);
+     /* 退出前输出最后一次汇总，计数不会丢失 */
+     summary_emit();
      
-     /* 确保用户消息以换行符结束 */
-     if (user_msg_len > 0 && user_msg_len < USER_MSG_BUFFER_SIZE - 1 && 
-         logger_state.user_msg[user_msg_len - 1] != '\n') {
-         logger_state.user_msg[user_msg_len++] = '\n';
-         logger_state.user_msg[user_msg_len] = '\0';
+     return NULL;
+ }
+ 
+ /**
+  * @brief 启动汇总线程
+  * 
+  * @param interval_sec 汇总间隔（秒）
+  * @return 成功返回0，失败返回-1
+  */
+ static int summary_start(unsigned int interval_sec) {
+     logger_state.summary_interval_sec = interval_sec;
+     logger_state.last_summary_ms = monotonic_ms();
+     atomic_store(&logger_state.summarizer_stop, false);
+     pthread_mutex_init(&logger_state.summary_mutex, NULL);
+     pthread_cond_init(&logger_state.summary_cond, NULL);
+     
+     if (pthread_create(&logger_state.summarizer, NULL, summarizer_main, NULL) != 0) {
+         perror("pthread_create failed for log summarizer");
+         pthread_cond_destroy(&logger_state.summary_cond);
+         pthread_mutex_destroy(&logger_state.summary_mutex);
+         return -1;
+     }
+     logger_state.summarizer_running = true;
+     
+     return 0;
+ }
+ 
+ /**
+  * @brief 停止汇总线程，不能在持有全局锁时调用（汇总线程退出前还要写日志）
+  */
+ static void summary_stop(void) {
+     if (!logger_state.summarizer_running) {
+         return;
      }
      
-     /* 创建过滤键，格式: "LEVEL:MESSAGE" */
-     char filter_key[USER_MSG_BUFFER_SIZE + 10];
-     snprintf(filter_key, sizeof(filter_key), "%s:%s", level_strings[level], logger_state.user_msg);
+     pthread_mutex_lock(&logger_state.summary_mutex);
+     atomic_store(&logger_state.summarizer_stop, true);
+     pthread_cond_signal(&logger_state.summary_cond);
+     pthread_mutex_unlock(&logger_state.summary_mutex);
      
-     /* 检查是否需要过滤 */
-     if (logger_state.log_mode == LOG_MODE_FILTER) {
-         /* 在过滤模式下，检查普通过滤和海量日志过滤 */
-         should_filter = filter_check(filter_key, strlen(filter_key));
-     } else {
-         /* 在普通模式下，仅检查海量日志过滤 */
-         should_filter = filter_check_massive(filter_key, strlen(filter_key));
+     pthread_join(logger_state.summarizer, NULL);
+     logger_state.summarizer_running = false;
+     pthread_cond_destroy(&logger_state.summary_cond);
+     pthread_mutex_destroy(&logger_state.summary_mutex);
+ }
+ 
+ /**
+  * @brief 关闭输出缓冲和日志文件，剩余数据会先写出
+  */
+ static void outputs_close(void) {
+     if (logger_state.stdout_out) {
+         fflush(stdout);
+         log_output_destroy(logger_state.stdout_out);
+         logger_state.stdout_out = NULL;
+     }
+     
+     if (logger_state.file_out) {
+         log_output_destroy(logger_state.file_out);
+         logger_state.file_out = NULL;
+     }
+     
+     /* 等待轮转线程完成尚未完成的改名 */
+     if (logger_state.rotate) {
+         log_rotate_stop(logger_state.rotate);
+         logger_state.rotate = NULL;
+     }
+     
+     if (logger_state.file_map) {
+         log_mmap_close(logger_state.file_map);
+         logger_state.file_map = NULL;
+     }
+     
+     if (logger_state.log_fd >= 0) {
+         close(logger_state.log_fd);
+         logger_state.log_fd = -1;
+     }
+     
+     if (logger_state.governor) {
+         log_governor_destroy(logger_state.governor);
+         logger_state.governor = NULL;
+     }
+ }
+ 
+ /**
+  * @brief 打开日志文件并创建输出缓冲
+  * 
+  * @param filename 日志文件名，为NULL时只输出到标准输出
+  * @param options 可选配置，可以为NULL
+  * @return 成功返回0，失败返回-1
+  */
+ static int outputs_open(const char *filename, const log_options_t *options) {
+     size_t capacity = logger_state.flush_bytes > FLUSH_BYTES_DEFAULT ?
+                       logger_state.flush_bytes : FLUSH_BYTES_DEFAULT;
+     
+     /* 二进制日志只写入日志文件 */
+     if (logger_state.format != LOG_FORMAT_BINARY && !(options && options->no_stdout)) {
+         logger_state.stdout_out = log_output_create(STDOUT_FILENO, capacity);
+         if (!logger_state.stdout_out) {
+             return -1;
+         }
      }
      
-     /* 如果不过滤，则格式化完整日志并打印 */
-     if (!should_filter) {
-         /* 格式化日志前缀 */
-         log_len = snprintf(logger_state.buffer, LOG_BUFFER_SIZE,
-                         "%s.%03ld [%s] [%s:%d %s] ",
-                         time_str, tv.tv_usec / 1000, level_strings[level], 
-                         file, line, func);
+     if (filename && options && options->mmap_file) {
+         logger_state.file_map = log_mmap_open(filename, options->mmap_segment_size ?
+                                               options->mmap_segment_size : MMAP_SEGMENT_DEFAULT_SIZE);
+         if (!logger_state.file_map) {
+             outputs_close();
+             return -1;
+         }
          
-         /* 添加用户日志内容 */
-         va_start(args, fmt);
-         log_len += vsnprintf(logger_state.buffer + log_len, LOG_BUFFER_SIZE - log_len, fmt, args);
-         va_end(args);
+         /* 二进制日志先写出文件头 */
+         if (logger_state.format == LOG_FORMAT_BINARY) {
+             unsigned char header[8];
+             log_mmap_write(logger_state.file_map, header, log_binary_encode_header(header));
+         }
+     } else if (filename) {
+         logger_state.log_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+         if (logger_state.log_fd < 0) {
+             perror("Failed to open log file");
+             outputs_close();
+             return -1;
+         }
          
-         /* 确保字符串以换行符结束 */
-         if (log_len > 0 && log_len < LOG_BUFFER_SIZE - 1 && logger_state.buffer[log_len - 1] != '\n') {
-             logger_state.buffer[log_len++] = '\n';
-             logger_state.buffer[log_len] = '\0';
+         logger_state.file_out = log_output_create(logger_state.log_fd, capacity);
+         if (!logger_state.file_out) {
+             outputs_close();
+             return -1;
          }
          
-         /* 输出到标准输出 */
-         fprintf(stdout, "%s%s%s", level_colors[level], logger_state.buffer, color_reset);
-         fflush(stdout);
+         if (options && (options->rotate_size || options->rotate_interval_sec)) {
+             logger_state.rotate = log_rotate_start(filename, logger_state.log_fd, options->rotate_size,
+                                                    options->rotate_interval_sec,
+                                                    options->rotate_keep ? options->rotate_keep : ROTATE_KEEP_DEFAULT,
+                                                    options->rotate_compress);
+             if (!logger_state.rotate) {
+                 outputs_close();
+                 return -1;
+             }
+         }
          
-         /* 输出到日志文件 */
-         if (logger_state.log_file) {
-             fprintf(logger_state.log_file, "%s", logger_state.buffer);
-             fflush(logger_state.log_file);
+         /* 二进制日志先写出文件头 */
+         if (logger_state.format == LOG_FORMAT_BINARY) {
+             unsigned char header[8];
+             log_output_append(logger_state.file_out, header, log_binary_encode_header(header));
+             log_output_flush(logger_state.file_out);
          }
      }
      
-     pthread_mutex_unlock(&logger_state.mutex);
+     /* 按字节数和条数限制写出速率 */
+     for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_FATAL; i++) {
+         atomic_store(&logger_state.dropped[i], 0);
+     }
+     stats_reset();
+     if (options && (options->governor_bytes_per_sec || options->governor_records_per_sec)) {
+         logger_state.governor = log_governor_create(options->governor_bytes_per_sec,
+                                                     options->governor_records_per_sec,
+                                                     GOVERNOR_BURST_MS);
+         if (!logger_state.governor) {
+             outputs_close();
+             return -1;
+         }
+     }
+     
+     logger_state.last_flush_ms = monotonic_ms();
+     
+     return 0;
+ }
+ 
+ /**
+  * @brief 用 write 写出一段数据，处理中断和部分写出（异步信号安全）
+  * 
+  * @param fd 文件描述符
+  * @param data 数据
+  * @param len 数据长度
+  */
+ static void emergency_write(int fd, const char *data, size_t len) {
+     while (len > 0) {
+         ssize_t n = write(fd, data, len);
+         if (n < 0 && errno == EINTR) {
+             continue;
+         }
+         if (n <= 0) {
+             return;
+         }
+         data += n;
+         len -= (size_t)n;
+     }
+ }
+ 
+ void log_emergency_flush(void) {
+     log_ring_t *ring = logger_state.ring;
+     async_record_t *record;
+     
+     if (!logger_state.initialized || atomic_exchange(&logger_state.emergency_active, true)) {
+         return;
+     }
+     
+     /* 先写出已经进入输出缓冲的日志，再写出队列中更晚的日志 */
+     if (logger_state.stdout_out) {
+         log_output_emergency_flush(logger_state.stdout_out);
+     }
+     if (logger_state.file_out) {
+         log_output_emergency_flush(logger_state.file_out);
+     }
+     
+     for (size_t i = 0; ring && (record = log_ring_peek_at(ring, i)) != NULL; i++) {
+         if (logger_state.stdout_out) {
+             emergency_write(STDOUT_FILENO, record->data, record->len);
+         }
+         if (logger_state.file_out) {
+             emergency_write(logger_state.log_fd, record->data, record->len);
+         }
+     }
+     
+     for (size_t i = 0; i < __atomic_load_n(&logger_state.sink_count, __ATOMIC_ACQUIRE); i++) {
+         log_sink_emergency_flush(logger_state.sinks[i]);
+     }
+     
+     atomic_store(&logger_state.emergency_active, false);
+ }
+ 
+ /**
+  * @brief 崩溃信号处理函数：紧急写出日志后按原来的处理方式重新触发信号
+  * 
+  * @param sig 信号
+  */
+ static void crash_handler(int sig) {
+     int saved_errno = errno;
+     
+     log_emergency_flush();
+     
+     for (size_t i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+         if (crash_signals[i] == sig) {
+             struct sigaction old = logger_state.crash_old[i];
+             /* 原来忽略的信号按默认方式处理，否则出错的指令会被反复执行 */
+             if (!(old.sa_flags & SA_SIGINFO) && old.sa_handler == SIG_IGN) {
+                 old.sa_handler = SIG_DFL;
+             }
+             sigaction(sig, &old, NULL);
+         }
+     }
+     
+     /* 信号在处理函数返回后才会递送 */
+     raise(sig);
+     errno = saved_errno;
+ }
+ 
+ /**
+  * @brief 安装崩溃信号处理函数
+  * 
+  * @return 成功返回0，失败返回-1
+  */
+ static int crash_install(void) {
+     struct sigaction action;
+     
+     memset(&action, 0, sizeof(action));
+     action.sa_handler = crash_handler;
+     sigemptyset(&action.sa_mask);
+     /* 线程设置了备用栈时在备用栈上处理，栈溢出时也能写出 */
+     action.sa_flags = SA_ONSTACK;
+     
+     for (size_t i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+         if (sigaction(crash_signals[i], &action, &logger_state.crash_old[i]) != 0) {
+             perror("sigaction failed for log crash handler");
+             while (i-- > 0) {
+                 sigaction(crash_signals[i], &logger_state.crash_old[i], NULL);
+             }
+             return -1;
+         }
+     }
+     
+     logger_state.crash_installed = true;
+     return 0;
+ }
+ 
+ /**
+  * @brief 恢复安装之前的信号处理方式
+  */
+ static void crash_uninstall(void) {
+     if (!logger_state.crash_installed) {
+         return;
+     }
+     
+     for (size_t i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+         sigaction(crash_signals[i], &logger_state.crash_old[i], NULL);
+     }
+     logger_state.crash_installed = false;
+ }
+ 
+ /**
+  * @brief 异步模式下启动后台写线程，同步模式下按时间间隔刷新时启动刷新线程，
+  *        需要时启动汇总线程
+  * 
+  * @param options 可选配置
+  * @return 成功返回0，失败返回-1
+  */
+ static int background_start(const log_options_t *options) {
+     if (options && options->async) {
+         if (async_start(options->async_queue_size) != 0) {
+             return -1;
+         }
+     } else if (logger_state.flush_policy & LOG_FLUSH_INTERVAL) {
+         if (pthread_create(&logger_state.flusher, NULL, flusher_main, NULL) != 0) {
+             perror("pthread_create failed for log flusher");
+             return -1;
+         }
+         logger_state.flusher_running = true;
+     }
+     
+     /* 定期汇总被过滤的日志 */
+     if (options && options->suppress_summary_sec && summary_start(options->suppress_summary_sec) != 0) {
+         flusher_stop();
+         async_stop();
+         return -1;
+     }
+     
+     return 0;
+ }
+ 
+ int log_init(const char *filename, log_level_t level, log_mode_t mode) {
+     return log_init_ex(filename, level, mode, NULL);
+ }
+ 
+ int log_init_ex(const char *filename, log_level_t level, log_mode_t mode,
+                 const log_options_t *options) {
+     /* 已经初始化则先销毁 */
+     if (logger_state.initialized) {
+         log_destroy();
+     }
+     
+     /* 初始化互斥锁 */
+     if (pthread_mutex_init(&logger_state.mutex, NULL) != 0) {
+         perror("pthread_mutex_init failed");
+         return -1;
+     }
+     
+     /* 设置日志模式，日志级别在初始化完成时生效 */
+     logger_state.log_mode = mode;
+     logger_state.format = options ? options->format : LOG_FORMAT_TEXT;
+     /* 飞行记录器转储时还原为文本，二进制格式下不启用 */
+     logger_state.recorder_size = options && logger_state.format != LOG_FORMAT_BINARY ?
+                                  options->flight_recorder_size : 0;
+     logger_state.session = ++session_counter;
+     logger_state.next_site_id = 0;
+     
+     /* 刷新策略：二进制格式默认按字节数批量写出，ERROR及以上级别立即写出；其他格式默认每条写出 */
+     logger_state.flush_policy = options ? options->flush_policy : LOG_FLUSH_DEFAULT;
+     if (logger_state.flush_policy == LOG_FLUSH_DEFAULT) {
+         logger_state.flush_policy = logger_state.format == LOG_FORMAT_BINARY ?
+                                     LOG_FLUSH_BYTES | LOG_FLUSH_ON_ERROR : LOG_FLUSH_RECORD;
+     }
+     logger_state.flush_bytes = options && options->flush_bytes ? options->flush_bytes : FLUSH_BYTES_DEFAULT;
+     logger_state.flush_interval_ms = options && options->flush_interval_ms ?
+                                      options->flush_interval_ms : FLUSH_INTERVAL_DEFAULT_MS;
+     
+     /* 二进制日志不输出到标准输出，必须指定日志文件 */
+     if (logger_state.format == LOG_FORMAT_BINARY && !filename) {
+         fprintf(stderr, "Binary log format requires a log file\n");
+         pthread_mutex_destroy(&logger_state.mutex);
+         return -1;
+     }
+     
+     /* 轮转只支持普通文件写出的文本日志：二进制日志的调用点定义不能跨文件，
+      * 内存映射文件的预分配段也无法在写入者不等待的情况下切换 */
+     if (options && (options->rotate_size || options->rotate_interval_sec) &&
+         (options->mmap_file || logger_state.format == LOG_FORMAT_BINARY)) {
+         fprintf(stderr, "Log rotation is not supported with mmap output or binary format\n");
+         pthread_mutex_destroy(&logger_state.mutex);
+         return -1;
+     }
+     
+     /* 打开日志文件，创建输出缓冲 */
+     if (outputs_open(filename, options) != 0) {
+         pthread_mutex_destroy(&logger_state.mutex);
+         return -1;
+     }
+     
+     /* 初始化日志过滤器 */
+     if (filter_init_ex(!(options && options->filter_fingerprint_only)) != 0) {
+         outputs_close();
+         pthread_mutex_destroy(&logger_state.mutex);
+         return -1;
+     }
+     
+     /* 后台线程共用的唤醒条件 */
+     pthread_mutex_init(&logger_state.wake_mutex, NULL);
+     pthread_cond_init(&logger_state.wake_cond, NULL);
+     atomic_store(&logger_state.writer_stop, false);
+     
+     /* 启动后台写线程或刷新线程 */
+     if (background_start(options) != 0) {
+         pthread_cond_destroy(&logger_state.wake_cond);
+         pthread_mutex_destroy(&logger_state.wake_mutex);
+         filter_destroy();
+         outputs_close();
+         pthread_mutex_destroy(&logger_state.mutex);
+         return -1;
+     }
+     
+     logger_state.initialized = true;
+     atomic_store(&logger_state.emergency_active, false);
+     
+     /* 崩溃时写出尚未写出的日志 */
+     if (options && options->crash_handler && crash_install() != 0) {
+         log_destroy();
+         return -1;
+     }
+     
+     __atomic_store_n(&log_runtime_level, level, __ATOMIC_RELEASE);
+     level_changed();
+     
+     /* 打印初始化成功的日志 */
+     log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, 
+             "Log system initialized successfully (level=%s, mode=%s, file=%s)",
+             level_strings[level],
+             mode == LOG_MODE_NORMAL ? "normal" : (mode == LOG_MODE_FILTER ? "filter" : "callsite"),
+             filename ? filename : "stdout");
+     
+     return 0;
+ }
+ 
+ void log_flush(void) {
+     size_t sinks;
+     
+     if (!logger_state.initialized) {
+         return;
+     }
+     
+     sinks = __atomic_load_n(&logger_state.sink_count, __ATOMIC_ACQUIRE);
+     for (size_t i = 0; i < sinks; i++) {
+         log_sink_flush(logger_state.sinks[i]);
+     }
+     
+     if (logger_state.ring) {
+         /* 异步模式：由写线程写出，等待它完成本次请求 */
+         unsigned int request = atomic_fetch_add(&logger_state.flush_requested, 1) + 1;
+         
+         pthread_mutex_lock(&logger_state.wake_mutex);
+         pthread_cond_signal(&logger_state.wake_cond);
+         pthread_mutex_unlock(&logger_state.wake_mutex);
+         
+         while ((int)(atomic_load(&logger_state.flush_completed) - request) < 0) {
+             sched_yield();
+         }
+         return;
+     }
+     
+     pthread_mutex_lock(&logger_state.mutex);
+     flush_outputs();
+     pthread_mutex_unlock(&logger_state.mutex);
+ }
+ 
+ void log_destroy(void) {
+     if (!logger_state.initialized) {
+         return;
+     }
+     
+     /* 之后的 LOG_* 宏在调用之前就会返回 */
+     __atomic_store_n(&log_runtime_level, LOG_LEVEL_DISABLED, __ATOMIC_RELAXED);
+     __atomic_store_n(&logger_state.recorder_size, 0, __ATOMIC_RELAXED);
+     level_changed();
+     
+     /* 之后释放的缓冲不能再被信号处理函数访问 */
+     crash_uninstall();
+     
+     /* 汇总线程和刷新线程需要获取全局锁，必须在加锁之前停止 */
+     summary_stop();
+     flusher_stop();
+     
+     pthread_mutex_lock(&logger_state.mutex);
+     
+     /* 异步模式下先等待写线程写完队列中的日志 */
+     async_stop();
+     
+     /* 各输出目标写完自己队列中的日志后销毁 */
+     for (size_t i = 0; i < logger_state.sink_count; i++) {
+         log_sink_destroy(logger_state.sinks[i]);
+         logger_state.sinks[i] = NULL;
+     }
+     __atomic_store_n(&logger_state.sink_count, 0, __ATOMIC_RELEASE);
+     
+     /* 写出剩余日志并关闭日志文件 */
+     outputs_close();
+     
+     logger_state.initialized = false;
+     
+     pthread_mutex_unlock(&logger_state.mutex);
+     pthread_mutex_destroy(&logger_state.mutex);
+     pthread_cond_destroy(&logger_state.wake_cond);
+     pthread_mutex_destroy(&logger_state.wake_mutex);
+     
+     /* 销毁日志过滤器 */
+     filter_destroy();
+     
+     /* 记录器属于各自的线程，只清空内容 */
+     log_recorder_reset_all();
+ }
+ 
+ int log_add_sink(log_sink_t *sink) {
+     int ret = -1;
+     
+     if (!sink || !logger_state.initialized) {
+         return -1;
+     }
+     
+     pthread_mutex_lock(&logger_state.mutex);
+     if (logger_state.sink_count < LOG_MAX_SINKS) {
+         logger_state.sinks[logger_state.sink_count] = sink;
+         /* 先写入指针再发布个数，分发时不需要加锁 */
+         __atomic_store_n(&logger_state.sink_count, logger_state.sink_count + 1, __ATOMIC_RELEASE);
+         ret = 0;
+     }
+     pthread_mutex_unlock(&logger_state.mutex);
+     
+     return ret;
+ }
+ 
+ unsigned long long log_get_dropped(log_level_t level) {
+     if (level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_FATAL) {
+         return 0;
+     }
+     
+     return atomic_load(&logger_state.dropped[level]);
+ }
+ 
+ void log_get_stats(log_stats_t *stats) {
+     filter_stats_t filter;
+     size_t sinks;
+     
+     memset(stats, 0, sizeof(*stats));
+     if (!logger_state.initialized) {
+         return;
+     }
+     
+     for (int i = 0; i < STATS_STRIPES; i++) {
+         for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_FATAL; level++) {
+             stats->emitted[level] += atomic_load_explicit(&stats_stripes[i].emitted[level], memory_order_relaxed);
+         }
+         stats->bytes_written += atomic_load_explicit(&stats_stripes[i].bytes, memory_order_relaxed);
+         stats->filtered_massive += atomic_load_explicit(&stats_stripes[i].callsite_suppressed,
+                                                         memory_order_relaxed);
+     }
+     for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_FATAL; level++) {
+         stats->dropped += atomic_load(&logger_state.dropped[level]);
+     }
+     for (int i = 0; i < LOG_STATS_LATENCY_BUCKETS; i++) {
+         stats->write_latency[i] = atomic_load_explicit(&logger_state.write_latency[i], memory_order_relaxed);
+     }
+     
+     sinks = __atomic_load_n(&logger_state.sink_count, __ATOMIC_ACQUIRE);
+     for (size_t i = 0; i < sinks; i++) {
+         stats->sink_dropped += log_sink_dropped(logger_state.sinks[i]);
+     }
+     
+     filter_get_stats(&filter);
+     stats->filtered_duplicate = filter.filtered_duplicate;
+     stats->filtered_massive += filter.filtered_massive;
+     stats->filter_records = filter.records;
+     stats->filter_capacity = filter.capacity;
+     stats->filter_max_probe = filter.max_probe;
+     stats->filter_memory = filter.memory_bytes;
+ }
+ 
+ void log_set_level(log_level_t level) {
+     if (level >= LOG_LEVEL_DEBUG && level <= LOG_LEVEL_FATAL) {
+         __atomic_store_n(&log_runtime_level, level, __ATOMIC_RELAXED);
+         level_changed();
+     }
+ }
+ 
+ /**
+  * @brief 在模块级别表中查找模块，调用者需持有 module_levels.mutex
+  * 
+  * @param module 模块名
+  * @return 找到返回下标，否则返回-1
+  */
+ static int module_find(const char *module) {
+     for (size_t i = 0; i < module_levels.count; i++) {
+         if (strcmp(module_levels.entries[i].name, module) == 0) {
+             return (int)i;
+         }
+     }
+     return -1;
+ }
+ 
+ int log_set_module_level(const char *module, log_level_t level) {
+     int index;
+     
+     if (!module || strlen(module) >= LOG_MODULE_NAME_MAX ||
+         level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_FATAL) {
+         return -1;
+     }
+     
+     pthread_mutex_lock(&module_levels.mutex);
+     index = module_find(module);
+     if (index < 0) {
+         if (module_levels.count == LOG_MAX_MODULES) {
+             pthread_mutex_unlock(&module_levels.mutex);
+             fprintf(stderr, "Too many log modules (max %d)\n", LOG_MAX_MODULES);
+             return -1;
+         }
+         index = (int)module_levels.count++;
+         strcpy(module_levels.entries[index].name, module);
+     }
+     module_levels.entries[index].level = level;
+     pthread_mutex_unlock(&module_levels.mutex);
+     
+     level_changed();
+     return 0;
+ }
+ 
+ void log_clear_module_level(const char *module) {
+     int index;
+     
+     if (!module) {
+         return;
+     }
+     
+     pthread_mutex_lock(&module_levels.mutex);
+     index = module_find(module);
+     if (index >= 0) {
+         /* 用最后一项填补空位 */
+         module_levels.entries[index] = module_levels.entries[--module_levels.count];
+     }
+     pthread_mutex_unlock(&module_levels.mutex);
+     
+     if (index >= 0) {
+         level_changed();
+     }
+ }
+ 
+ bool log_site_resolve(log_callsite_t *site, unsigned int generation) {
+     int level = __atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED);
+     unsigned int flags = 0;
+     
+     /* 未初始化时不查找模块，所有级别都关闭 */
+     if (site->module && level != LOG_LEVEL_DISABLED) {
+         pthread_mutex_lock(&module_levels.mutex);
+         int index = module_find(site->module);
+         if (index >= 0) {
+             level = module_levels.entries[index].level;
+         }
+         pthread_mutex_unlock(&module_levels.mutex);
+     }
+     
+     if ((int)site->level >= level) {
+         flags = LOG_SITE_CALL | LOG_SITE_EMIT;
+     } else if (level != LOG_LEVEL_DISABLED && __atomic_load_n(&logger_state.recorder_size, __ATOMIC_RELAXED)) {
+         /* 级别未打开的日志交给飞行记录器 */
+         flags = LOG_SITE_CALL;
+     }
+     
+     /* 计算期间级别又被修改时，缓存的是旧生成号，下次调用会重新计算 */
+     __atomic_store_n(&site->level_state, (generation << LOG_SITE_GEN_SHIFT) | flags, __ATOMIC_RELAXED);
+     return flags & LOG_SITE_CALL;
+ }
+ 
+ void log_set_mode(log_mode_t mode) {
+     pthread_mutex_lock(&logger_state.mutex);
+     logger_state.log_mode = mode;
+     pthread_mutex_unlock(&logger_state.mutex);
+ }
+ 
+ /**
+  * @brief 获取当前时间（微秒）
+  * 
+  * @return 自1970年以来的微秒数
+  */
+ static unsigned long long now_us(void) {
+     struct timespec ts;
+     
+     log_clock_now(&ts);
+     return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000;
+ }
+ 
+ /**
+  * @brief 流量控制：判断一条日志是否可以写出，超出限制时计入丢弃计数
+  * 
+  * @param level 日志级别
+  * @param len 日志长度
+  * @return 可以写出返回true
+  */
+ static bool governor_admit(log_level_t level, size_t len) {
+     if (!logger_state.governor ||
+         log_governor_admit(logger_state.governor, len, governor_reserve_pct[level])) {
+         return true;
+     }
+     
+     atomic_fetch_add_explicit(&logger_state.dropped[level], 1, memory_order_relaxed);
+     return false;
+ }
+ 
+ /**
+  * @brief 写出一条二进制日志条目，调用者需已持有锁（同步模式）
+  * 
+  * @param level 日志级别
+  * @param data 条目数据
+  * @param len 条目长度
+  */
+ static void binary_emit_locked(log_level_t level, const void *data, size_t len) {
+     if (logger_state.ring) {
+         async_enqueue(level, (const char *)data, len);
+         return;
+     }
+     
+     write_record(level, data, len);
+     flush_if_due(level);
+ }
+ 
+ /**
+  * @brief 写出一条二进制日志条目（调用点定义之外的条目，受流量控制）
+  * 
+  * @param level 日志级别
+  * @param data 条目数据
+  * @param len 条目长度
+  */
+ static void binary_emit(log_level_t level, const void *data, size_t len) {
+     if (!governor_admit(level, len)) {
+         return;
+     }
+     
+     stats_emitted(level, len);
+     if (logger_state.ring) {
+         /* 异步模式下入队本身无锁 */
+         async_enqueue(level, (const char *)data, len);
+         return;
+     }
+     
+     if (logger_state.file_map) {
+         /* 内存映射写出本身是线程安全的，无需加锁 */
+         write_file(data, len);
+         return;
+     }
+     
+     pthread_mutex_lock(&logger_state.mutex);
+     binary_emit_locked(level, data, len);
+     pthread_mutex_unlock(&logger_state.mutex);
+ }
+ 
+ /**
+  * @brief 二进制模式下写出一条文本记录
+  * 
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param msg 消息
+  * @param msg_len 消息长度
+  */
+ static void binary_emit_text(log_level_t level, const char *file, int line, const char *func,
+                              const char *msg, size_t msg_len) {
+     size_t len = log_binary_encode_text((unsigned char *)tls_buffer, LOG_BUFFER_SIZE, level, now_us(),
+                                         file, line, func, msg, msg_len);
+     
+     if (len > 0) {
+         binary_emit(level, tls_buffer, len);
+     }
+ }
+ 
+ /**
+  * @brief 二进制模式下格式化并写出一条文本记录
+  * 
+  * 用于没有调用点信息或格式字符串不支持延迟格式化的日志
+  * 
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param fmt 格式化字符串
+  * @param args 参数列表
+  */
+ static void binary_print_text(log_level_t level, const char *file, int line, const char *func,
+                               const char *fmt, va_list args) {
+     int msg_len;
+     
+     msg_len = vsnprintf(tls_user_msg, USER_MSG_BUFFER_SIZE, fmt, args);
+     if (msg_len < 0) {
+         return;
+     }
+     if (msg_len >= USER_MSG_BUFFER_SIZE) {
+         msg_len = USER_MSG_BUFFER_SIZE - 1;
+     }
+     
+     binary_emit_text(level, file, line, func, tls_user_msg, (size_t)msg_len);
+ }
+ 
+ /**
+  * @brief 为调用点分配本次会话的编号，并写出调用点定义
+  * 
+  * @param site 调用点
+  * @param func 调用处的函数名
+  * @param fmt 格式化字符串
+  * @return 调用点的会话号和编号，编号为0表示该调用点不能延迟格式化
+  */
+ static unsigned long long binary_define_site(log_callsite_t *site, const char *func, const char *fmt) {
+     unsigned long long key;
+     
+     pthread_mutex_lock(&logger_state.mutex);
+     
+     /* 其他线程可能已经完成了定义 */
+     key = __atomic_load_n(&site->binary_key, __ATOMIC_ACQUIRE);
+     if ((unsigned int)(key >> 32) != logger_state.session) {
+         unsigned int id = 0;
+         int argc = log_binary_compile(fmt, site->binary_types, LOG_CALLSITE_MAX_ARGS);
+         
+         if (argc >= 0) {
+             size_t len = log_binary_encode_site((unsigned char *)tls_buffer, LOG_BUFFER_SIZE,
+                                                 logger_state.next_site_id + 1, site->level,
+                                                 site->file, site->line, func, fmt);
+             if (len > 0) {
+                 id = ++logger_state.next_site_id;
+                 /* 定义必须先于编号发布写出，保证解码时定义出现在记录之前 */
+                 binary_emit_locked(site->level, tls_buffer, len);
+             }
+         }
+         
+         site->binary_argc = argc;
+         site->binary_fmt = fmt;
+         key = ((unsigned long long)logger_state.session << 32) | id;
+         __atomic_store_n(&site->binary_key, key, __ATOMIC_RELEASE);
+     }
+     
+     pthread_mutex_unlock(&logger_state.mutex);
+     
+     return key;
+ }
+ 
+ /**
+  * @brief 二进制模式下记录一条日志：只保存调用点编号、时间戳和原始参数
+  * 
+  * @param site 调用点
+  * @param func 调用处的函数名
+  * @param fmt 格式化字符串
+  * @param args 参数列表
+  */
+ static void binary_print_site(log_callsite_t *site, const char *func, const char *fmt, va_list args) {
+     unsigned long long key = __atomic_load_n(&site->binary_key, __ATOMIC_ACQUIRE);
+     unsigned int id;
+     size_t len = 0;
+     va_list copy;
+     
+     if ((unsigned int)(key >> 32) != logger_state.session) {
+         key = binary_define_site(site, func, fmt);
+     }
+     id = (unsigned int)key;
+     
+     /* 格式字符串与定义时不同（非常量格式串）或不支持时，退化为文本记录 */
+     if (id != 0 && fmt == site->binary_fmt) {
+         va_copy(copy, args);
+         len = log_binary_encode_record((unsigned char *)tls_buffer, LOG_BUFFER_SIZE, id, now_us(),
+                                        site->binary_types, site->binary_argc, copy);
+         va_end(copy);
+     }
+     
+     if (len > 0) {
+         binary_emit(site->level, tls_buffer, len);
+     } else {
+         binary_print_text(site->level, site->file, site->line, func, fmt, args);
+     }
+ }
+ 
+ /**
+  * @brief 在消息之前写入日志前缀 "时间 [级别] [文件:行号 函数] "
+  * 
+  * 前缀直接拼接，不经过 snprintf；文件名和函数名过长时保留文件名末尾部分
+  * 
+  * @param msg 消息起始位置，其前方至少有 reserve 字节可用
+  * @param reserve 前方可用空间
+  * @param time_str 时间字符串
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @return 前缀起始位置
+  */
+ static char *prepend_prefix(char *msg, size_t reserve, const char *time_str, log_level_t level,
+                             const char *file, int line, const char *func) {
+     const char *level_str = level_strings[level];
+     size_t level_len = strlen(level_str);
+     size_t file_len = strlen(file);
+     size_t func_len = strlen(func);
+     char line_str[16];
+     size_t line_len = 0;
+     unsigned int value = line < 0 ? 0 : (unsigned int)line;
+     size_t fixed_len;
+     char *p;
+     
+     /* 行号倒序写入再翻转 */
+     do {
+         line_str[line_len++] = (char)('0' + value % 10);
+         value /= 10;
+     } while (value > 0);
+     for (size_t i = 0; i < line_len / 2; i++) {
+         char c = line_str[i];
+         line_str[i] = line_str[line_len - 1 - i];
+         line_str[line_len - 1 - i] = c;
+     }
+     
+     /* "时间 [级别] [" + ":" + 行号 + " " + "] " */
+     fixed_len = LOG_CLOCK_TEXT_LEN + 2 + level_len + 3 + 1 + line_len + 1 + 2;
+     if (fixed_len + file_len + func_len > reserve) {
+         size_t name_space = reserve - fixed_len;
+         if (func_len > name_space / 2) {
+             func_len = name_space / 2;
+         }
+         if (file_len > name_space - func_len) {
+             file += file_len - (name_space - func_len);
+             file_len = name_space - func_len;
+         }
+     }
+     
+     p = msg - (fixed_len + file_len + func_len);
+     msg = p;
+     memcpy(p, time_str, LOG_CLOCK_TEXT_LEN);
+     p += LOG_CLOCK_TEXT_LEN;
+     *p++ = ' ';
+     *p++ = '[';
+     memcpy(p, level_str, level_len);
+     p += level_len;
+     *p++ = ']';
+     *p++ = ' ';
+     *p++ = '[';
+     memcpy(p, file, file_len);
+     p += file_len;
+     *p++ = ':';
+     memcpy(p, line_str, line_len);
+     p += line_len;
+     *p++ = ' ';
+     memcpy(p, func, func_len);
+     p += func_len;
+     *p++ = ']';
+     *p++ = ' ';
+     
+     return msg;
+ }
+ 
+ /**
+  * @brief 写出一条格式化完成的文本或 JSON 日志，并分发给各输出目标
+  * 
+  * @param level 日志级别
+  * @param record 日志内容
+  * @param len 日志长度
+  */
+ static void output_record(log_level_t level, const char *record, size_t len) {
+     /* 额外的输出目标共享同一份记录，各自的线程写出 */
+     size_t sinks = __atomic_load_n(&logger_state.sink_count, __ATOMIC_ACQUIRE);
+     
+     stats_emitted(level, len);
+     if (sinks > 0) {
+         log_sink_dispatch(logger_state.sinks, sinks, level, record, len);
+     }
+     
+     if (logger_state.ring) {
+         /* 异步模式：只入队，由后台线程写出，入队本身无锁 */
+         async_enqueue(level, record, len);
+     } else {
+         /* 内存映射的日志文件可以并发写入，不需要持有全局锁 */
+         if (logger_state.file_map) {
+             write_file(record, len);
+         }
+         
+         /* 同步模式：直接输出到标准输出和日志文件，加锁保证两路输出顺序一致 */
+         pthread_mutex_lock(&logger_state.mutex);
+         write_stdout(level, record, len);
+         if (!logger_state.file_map) {
+             write_file(record, len);
+         }
+         flush_if_due(level);
+         pthread_mutex_unlock(&logger_state.mutex);
+     }
+ }
+ 
+ /**
+  * @brief 过滤并输出一条已经写入线程私有缓冲区的日志
+  * 
+  * 消息位于 tls_buffer 的前缀预留区之后，过滤按（级别，消息）进行；文本格式下在消息之前补上前缀，
+  * JSON 格式下另外生成一行 JSON 对象
+  * 
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param msg_len 消息长度
+  * @param kv_msg 键值日志的消息，为NULL时 JSON 的 msg 成员使用整条消息
+  * @param fields 键值字段
+  * @param count 键值字段个数
+  * @param site_checked 是否已经按调用点过滤过，此时不再按内容过滤
+  */
+ static void log_emit(log_level_t level, const char *file, int line, const char *func, size_t msg_len,
+                      const char *kv_msg, const log_field_t *fields, size_t count, bool site_checked) {
+     struct timespec ts;
+     char time_str[LOG_CLOCK_TEXT_LEN + 1]; /* 时间字符串缓冲区 */
+     char *msg = tls_buffer + LOG_PREFIX_RESERVE; /* 用户消息位置，前方留给前缀 */
+     const size_t msg_cap = LOG_BUFFER_SIZE - LOG_PREFIX_RESERVE;
+     bool should_filter = false;
+     char *record;
+     
+     /* 确保用户消息以换行符结束 */
+     if (msg_len == 0 || msg[msg_len - 1] != '\n') {
+         if (msg_len < msg_cap - 1) {
+             msg_len++;
+         }
+         msg[msg_len - 1] = '\n';
+         msg[msg_len] = '\0';
+     }
+     
+     /* 过滤器内部按分片加锁，不需要持有全局锁；过滤键为（级别，消息内容） */
+     if (!site_checked) {
+         /* 检查是否需要过滤 */
+         if (logger_state.log_mode == LOG_MODE_FILTER) {
+             /* 在过滤模式下，检查普通过滤和海量日志过滤 */
+             should_filter = filter_check_ex(level, msg, msg_len);
+         } else {
+             /* 在普通模式下，仅检查海量日志过滤 */
+             should_filter = filter_check_massive_ex(level, msg, msg_len);
+         }
+         
+         if (should_filter) {
+             return;
+         }
+     }
+     
+     /* 获取当前时间，被过滤的日志不需要时间戳 */
+     log_clock_now(&ts);
+     log_clock_format(&ts, time_str);
+     
+     if (logger_state.format == LOG_FORMAT_JSON) {
+         record = tls_json;
+         msg_len = log_kv_format_json(tls_json, LOG_BUFFER_SIZE, time_str, level_strings[level],
+                                      file, line, func, kv_msg ? kv_msg : msg,
+                                      kv_msg ? strlen(kv_msg) : msg_len - 1, fields, count);
+         if (msg_len == 0) {
+             return;
+         }
+     } else {
+         /* 在消息之前补上日志前缀 */
+         record = prepend_prefix(msg, LOG_PREFIX_RESERVE, time_str, level, file, line, func);
+         msg_len += (size_t)(msg - record);
+     }
+     
+     /* 超出流量限制时丢弃 */
+     if (!governor_admit(level, msg_len)) {
+         return;
+     }
+     
+     output_record(level, record, msg_len);
+ }
+ 
+ /**
+  * @brief 格式化、过滤并输出一条文本日志
+  * 
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param fmt 格式化字符串
+  * @param args 参数列表
+  * @param site_checked 是否已经按调用点过滤过，此时不再按内容过滤
+  */
+ static void log_vprint(log_level_t level, const char *file, int line, const char *func,
+                        const char *fmt, va_list args, bool site_checked) {
+     char *msg = tls_buffer + LOG_PREFIX_RESERVE; /* 用户消息位置，前方留给前缀 */
+     const size_t msg_cap = LOG_BUFFER_SIZE - LOG_PREFIX_RESERVE;
+     int ret;
+     
+     /* 二进制模式下不做过滤，直接写出文本记录 */
+     if (logger_state.format == LOG_FORMAT_BINARY) {
+         binary_print_text(level, file, line, func, fmt, args);
+         return;
+     }
+     
+     /* 用户消息只格式化一次，直接写入线程私有缓冲区的前缀预留区之后 */
+     ret = vsnprintf(msg, msg_cap, fmt, args);
+     if (ret < 0) {
+         return;
+     }
+     
+     /* 超长日志会被截断 */
+     log_emit(level, file, line, func, (size_t)ret < msg_cap ? (size_t)ret : msg_cap - 1,
+              NULL, NULL, 0, site_checked);
+ }
+ 
+ /**
+  * @brief 序列化、过滤并输出一条键值日志
+  * 
+  * @param level 日志级别
+  * @param file 调用处的文件名
+  * @param line 调用处的行号
+  * @param func 调用处的函数名
+  * @param msg 消息
+  * @param fields 字段数组
+  * @param count 字段个数
+  * @param site_checked 是否已经按调用点过滤过，此时不再按内容过滤
+  */
+ static void kv_print(log_level_t level, const char *file, int line, const char *func, const char *msg,
+                      const log_field_t *fields, size_t count, bool site_checked) {
+     size_t len;
+     
+     if (!msg) {
+         msg = "";
+     }
+     
+     /* 二进制模式下写出文本形式，不做过滤 */
+     if (logger_state.format == LOG_FORMAT_BINARY) {
+         len = log_kv_format_text(tls_user_msg, USER_MSG_BUFFER_SIZE, msg, fields, count);
+         binary_emit_text(level, file, line, func, tls_user_msg, len);
+         return;
+     }
+     
+     /* 文本形式同时作为过滤键，留一个字节给换行符 */
+     len = log_kv_format_text(tls_buffer + LOG_PREFIX_RESERVE, LOG_BUFFER_SIZE - LOG_PREFIX_RESERVE - 1,
+                              msg, fields, count);
+     log_emit(level, file, line, func, len, msg, fields, count, site_checked);
+ }
+ 
+ /**
+  * @brief 把一条级别未打开的日志记入调用线程的飞行记录器，不格式化
+  * 
+  * @param site 调用点
+  * @param func 调用处的函数名
+  * @param fmt 格式化字符串
+  * @param args 参数列表
+  */
+ static void recorder_capture(log_callsite_t *site, const char *func, const char *fmt, va_list args) {
+     log_recorder_t *rec = log_recorder_thread(logger_state.recorder_size);
+     unsigned char types[LOG_CALLSITE_MAX_ARGS];
+     int argc;
+     
+     if (!rec) {
+         return;
+     }
+     
+     /* 同一调用点的格式字符串可能不同（例如动态构造），每次都编译到局部缓冲区，
+      * 不与其他线程共享调用点中的参数类型 */
+     argc = log_binary_compile(fmt, types, sizeof(types));
+     if (argc >= 0) {
+         log_recorder_append(rec, site->level, site->file, site->line, func, fmt, types, argc, args);
+     }
+ }
+ 
+ /**
+  * @brief 飞行记录器的转储回调：还原出的日志直接写出，不经过过滤和流量控制
+  * 
+  * @param level 日志级别
+  * @param line 还原出的文本
+  * @param len 文本长度
+  * @param arg 已转储条数
+  */
+ static void recorder_emit(int level, const char *line, size_t len, void *arg) {
+     size_t *emitted = arg;
+     
+     if ((*emitted)++ == 0) {
+         log_internal(LOG_LEVEL_WARN, "Flight recorder dump begins");
+     }
+     
+     /* JSON 格式下整行作为 msg */
+     if (logger_state.format == LOG_FORMAT_JSON) {
+         struct timespec ts;
+         char time_str[LOG_CLOCK_TEXT_LEN + 1];
+         
+         log_clock_now(&ts);
+         log_clock_format(&ts, time_str);
+         len = log_kv_format_json(tls_json, LOG_BUFFER_SIZE, time_str, level_strings[level], __FILE__, __LINE__,
+                                  __func__, line, len > 0 && line[len - 1] == '\n' ? len - 1 : len, NULL, 0);
+         if (len == 0) {
+             return;
+         }
+         line = tls_json;
+     }
+     
+     output_record((log_level_t)level, line, len);
+ }
+ 
+ /**
+  * @brief 转储调用线程的飞行记录器，在写出 ERROR 及以上的日志之前调用
+  */
+ static void recorder_dump_thread(void) {
+     size_t emitted = 0;
+     
+     log_recorder_dump(log_recorder_thread(logger_state.recorder_size), recorder_emit, &emitted);
+     if (emitted > 0) {
+         log_internal(LOG_LEVEL_WARN, "Flight recorder dump ends (%zu records)", emitted);
+     }
+ }
+ 
+ void log_flight_dump(void) {
+     size_t emitted = 0;
+     
+     if (!logger_state.initialized || !logger_state.recorder_size) {
+         return;
+     }
+     
+     log_recorder_dump_all(recorder_emit, &emitted);
+     if (emitted > 0) {
+         log_internal(LOG_LEVEL_WARN, "Flight recorder dump ends (%zu records)", emitted);
+     }
+ }
+ 
+ void log_print(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...) {
+     va_list args;
+     
+     /* 检查日志级别 */
+     if ((int)level < __atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED) || !logger_state.initialized) {
+         return;
+     }
+     
+     if (level >= LOG_LEVEL_ERROR && logger_state.recorder_size) {
+         recorder_dump_thread();
+     }
+     
+     va_start(args, fmt);
+     log_vprint(level, file, line, func, fmt, args, false);
+     va_end(args);
+ }
+
+/**
+  * @brief 按调用点检查是否为海量日志，在格式化之前调用
+  * 
+  * 计数保存在调用点的静态实例中，不需要查表和加锁；多个线程同时更新时计数可能略有偏差，
+  * 只影响开始屏蔽的时机
+  * 
+  * @param site 调用点
+  * @return true 表示应该过滤此日志，false 表示应该打印此日志
+  */
+ static bool callsite_suppressed(log_callsite_t *site) {
+     struct timespec ts;
+     long long now;
+     long long until;
+     
+     clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+     now = ts.tv_sec;
+     
+     /* 调用点的计数属于上一次初始化，重新开始计数 */
+     if (__atomic_load_n(&site->filter_session, __ATOMIC_ACQUIRE) != logger_state.session) {
+         __atomic_store_n(&site->filter_until, 0, __ATOMIC_RELAXED);
+         __atomic_store_n(&site->filter_window, now, __ATOMIC_RELAXED);
+         __atomic_store_n(&site->filter_count, 0, __ATOMIC_RELAXED);
+         __atomic_store_n(&site->filter_session, logger_state.session, __ATOMIC_RELEASE);
+     }
+     
+     /* 已被屏蔽：屏蔽期内直接丢弃，期满后重新计数 */
+     until = __atomic_load_n(&site->filter_until, __ATOMIC_RELAXED);
+     if (until != 0) {
+         if (now < until) {
+             atomic_fetch_add_explicit(&stats_stripe()->callsite_suppressed, 1, memory_order_relaxed);
+             return true;
+         }
+         __atomic_store_n(&site->filter_until, 0, __ATOMIC_RELAXED);
+         __atomic_store_n(&site->filter_window, now, __ATOMIC_RELAXED);
+         __atomic_store_n(&site->filter_count, 1, __ATOMIC_RELAXED);
+         return false;
+     }
+     
+     /* 进入新的一分钟，重新计数 */
+     if (now - __atomic_load_n(&site->filter_window, __ATOMIC_RELAXED) >= 60) {
+         __atomic_store_n(&site->filter_window, now, __ATOMIC_RELAXED);
+         __atomic_store_n(&site->filter_count, 1, __ATOMIC_RELAXED);
+         return false;
+     }
+     
+     /* 达到阈值的这一条照常打印，之后开始屏蔽 */
+     if (__atomic_add_fetch(&site->filter_count, 1, __ATOMIC_RELAXED) == CALLSITE_FLOOD_PER_MIN) {
+         __atomic_store_n(&site->filter_until, now + CALLSITE_SUPPRESS_SEC, __ATOMIC_RELAXED);
+     }
+     
+     return false;
+ }
+ 
+ void log_print_callsite(log_callsite_t *site, const char *func, const char *fmt, ...) {
+     va_list args;
+     bool site_checked = false;
+     
+     /* 检查日志级别（含模块级别） */
+     if (!log_site_enabled(site) || !logger_state.initialized) {
+         return;
+     }
+     
+     /* 级别未打开时只记入飞行记录器 */
+     if (!(__atomic_load_n(&site->level_state, __ATOMIC_RELAXED) & LOG_SITE_EMIT)) {
+         va_start(args, fmt);
+         recorder_capture(site, func, fmt, args);
+         va_end(args);
+         return;
+     }
+     
+     /* 按调用点过滤在格式化之前进行，被屏蔽的日志不会处理任何参数 */
+     if (logger_state.log_mode == LOG_MODE_CALLSITE) {
+         if (callsite_suppressed(site)) {
+             return;
+         }
+         site_checked = true;
+     }
+     
+     /* 错误日志之前先写出本线程记录的上下文 */
+     if (site->level >= LOG_LEVEL_ERROR && logger_state.recorder_size) {
+         recorder_dump_thread();
+     }
+     
+     va_start(args, fmt);
+     if (logger_state.format == LOG_FORMAT_BINARY) {
+         binary_print_site(site, func, fmt, args);
+     } else {
+         log_vprint(site->level, site->file, site->line, func, fmt, args, site_checked);
+     }
+     va_end(args);
+ }
+ 
+ void log_kv(log_level_t level, const char *file, int line, const char *func, const char *msg,
+             const log_field_t *fields, size_t count) {
+     /* 检查日志级别 */
+     if ((int)level < __atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED) || !logger_state.initialized) {
+         return;
+     }
+     
+     if (level >= LOG_LEVEL_ERROR && logger_state.recorder_size) {
+         recorder_dump_thread();
+     }
+     
+     kv_print(level, file, line, func, msg, fields, count, false);
+ }
+ 
+ void log_kv_callsite(log_callsite_t *site, const char *func, const char *msg,
+                      const log_field_t *fields, size_t count) {
+     bool site_checked = false;
+     
+     /* 检查日志级别（含模块级别）；键值日志不记入飞行记录器 */
+     if (!log_site_enabled(site) || !logger_state.initialized ||
+         !(__atomic_load_n(&site->level_state, __ATOMIC_RELAXED) & LOG_SITE_EMIT)) {
+         return;
+     }
+     
+     /* 按调用点过滤在序列化之前进行 */
+     if (logger_state.log_mode == LOG_MODE_CALLSITE) {
+         if (callsite_suppressed(site)) {
+             return;
+         }
+         site_checked = true;
+     }
+     
+     kv_print(site->level, site->file, site->line, func, msg, fields, count, site_checked);
  }
\ No newline at end of file
@@ -0,0 +1,439 @@
+/**
+ * @file logger_bench.c
+ * @brief 日志系统性能测试
+ *
+ * 对 NORMAL / FILTER 两种模式、三种日志（每条内容不同、内容重复、低于当前级别）、
+ * 日志文件和 /dev/null 两种输出，分别用 1..N 个线程调用 LOG_* 宏：
+ * 第一轮不计时，统计每秒日志条数；第二轮逐次计时，用对数分桶直方图统计单次调用的
+ * p50/p99/p99.9 延迟（已扣除计时本身的开销）。结果可以输出为表格或 JSON Lines
+ * 用法: logger_bench [-n 每线程调用次数] [-t 最大线程数] [-a] [-j]
+ */
+ 
+ #include "logger.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdbool.h>
+ #include <time.h>
+ #include <unistd.h>
+ #include <pthread.h>
+ #include <sched.h>
+ #include <stdatomic.h>
+ 
+ /* 默认每个线程每轮的调用次数 */
+ #define DEFAULT_CALLS 100000
+ /* 默认最多的线程数上限 */
+ #define DEFAULT_MAX_THREADS 8
+ /* 测试写出的日志文件 */
+ #define BENCH_LOG_FILE "bench_logger.log"
+ 
+ /* 直方图每个2的幂区间划分的子桶数（2的幂），相对误差不超过 1/16 */
+ #define HIST_SUB_BITS 4
+ #define HIST_SUB (1 << HIST_SUB_BITS)
+ #define HIST_BUCKETS (64 * HIST_SUB)
+ 
+ /* 延迟直方图（纳秒） */
+ typedef struct {
+     unsigned long long counts[HIST_BUCKETS]; /* 各桶的次数 */
+     unsigned long long total;                /* 总次数 */
+     unsigned long long max;                  /* 最大值 */
+ } histogram_t;
+ 
+ /* 日志种类 */
+ typedef enum {
+     RECORD_PRINTED,      /* 每条内容不同，总是写出 */
+     RECORD_DUPLICATE,    /* 内容完全相同，重复日志会被过滤或屏蔽 */
+     RECORD_BELOW_LEVEL,  /* 低于当前级别，调用处即返回 */
+     RECORD_KIND_COUNT
+ } record_kind_t;
+ 
+ static const char *record_names[] = { "printed", "duplicate", "below_level" };
+ 
+ /* 一个测试线程的参数 */
+ typedef struct {
+     atomic_int *start;          /* 开始标志：1表示开始，-1表示放弃，所有线程同时开始 */
+     record_kind_t kind;         /* 日志种类 */
+     int id;                     /* 线程编号 */
+     size_t base;                /* 日志序号的起点，保证两轮之间内容也不重复 */
+     size_t calls;               /* 调用次数 */
+     long long timer_ns;         /* 计时本身的开销 */
+     histogram_t *hist;          /* 延迟直方图，NULL表示不计时 */
+ } worker_t;
+ 
+ /* 一组测试条件 */
+ typedef struct {
+     log_mode_t mode;            /* 日志模式 */
+     record_kind_t kind;         /* 日志种类 */
+     const char *output;         /* 日志文件名 */
+     const char *output_name;    /* 输出的名称 */
+     bool async;                 /* 是否异步写出 */
+ } scenario_t;
+ 
+ /**
+  * @brief 获取单调时钟（纳秒）
+  */
+ static long long now_ns(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+ }
+ 
+ /**
+  * @brief 估计连续两次读取时钟的开销：取多次测量的最小值
+  *
+  * @return 开销（纳秒）
+  */
+ static long long timer_overhead_ns(void) {
+     long long best = -1;
+     
+     for (int i = 0; i < 10000; i++) {
+         long long t0 = now_ns();
+         long long d = now_ns() - t0;
+         if (best < 0 || d < best) {
+             best = d;
+         }
+     }
+     
+     return best;
+ }
+ 
+ /**
+  * @brief 计算数值所在的桶：小于 HIST_SUB 的值各占一个桶，更大的值按最高位分组后再细分
+  *
+  * @param value 数值
+  * @return 桶的下标
+  */
+ static size_t hist_index(unsigned long long value) {
+     int shift;
+     
+     if (value < HIST_SUB) {
+         return (size_t)value;
+     }
+     
+     shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+     return (size_t)(shift + 1) * HIST_SUB + (size_t)((value >> shift) & (HIST_SUB - 1));
+ }
+ 
+ /**
+  * @brief 获取桶内的最大值
+  *
+  * @param index 桶的下标
+  * @return 桶内的最大值
+  */
+ static unsigned long long hist_upper(size_t index) {
+     size_t shift;
+     
+     if (index < HIST_SUB) {
+         return index;
+     }
+     
+     shift = index / HIST_SUB - 1;
+     return ((unsigned long long)(HIST_SUB + index % HIST_SUB) << shift) + (1ULL << shift) - 1;
+ }
+ 
+ /**
+  * @brief 记录一个数值
+  *
+  * @param hist 直方图
+  * @param value 数值
+  */
+ static void hist_add(histogram_t *hist, unsigned long long value) {
+     hist->counts[hist_index(value)]++;
+     hist->total++;
+     if (value > hist->max) {
+         hist->max = value;
+     }
+ }
+ 
+ /**
+  * @brief 把一个直方图合并到另一个中
+  *
+  * @param dst 目标直方图
+  * @param src 源直方图
+  */
+ static void hist_merge(histogram_t *dst, const histogram_t *src) {
+     for (size_t i = 0; i < HIST_BUCKETS; i++) {
+         dst->counts[i] += src->counts[i];
+     }
+     dst->total += src->total;
+     if (src->max > dst->max) {
+         dst->max = src->max;
+     }
+ }
+ 
+ /**
+  * @brief 计算百分位数，结果为所在桶的最大值（不超过实际最大值）
+  *
+  * @param hist 直方图
+  * @param p 百分位（0到1之间）
+  * @return 百分位数
+  */
+ static unsigned long long hist_percentile(const histogram_t *hist, double p) {
+     unsigned long long target = (unsigned long long)(p * (double)hist->total + 0.999999);
+     unsigned long long seen = 0;
+     
+     if (target == 0) {
+         target = 1;
+     }
+     
+     for (size_t i = 0; i < HIST_BUCKETS; i++) {
+         seen += hist->counts[i];
+         if (seen >= target) {
+             unsigned long long upper = hist_upper(i);
+             return upper < hist->max ? upper : hist->max;
+         }
+     }
+     
+     return hist->max;
+ }
+ 
+ /**
+  * @brief 调用一次日志宏
+  *
+  * @param kind 日志种类
+  * @param id 线程编号
+  * @param seq 日志序号
+  */
+ static inline void log_once(record_kind_t kind, int id, size_t seq) {
+     switch (kind) {
+         case RECORD_PRINTED:
+             LOG_INFO("bench request %zu from worker %d done", seq, id);
+             break;
+         case RECORD_DUPLICATE:
+             LOG_INFO("bench duplicate request from worker");
+             break;
+         default:
+             LOG_DEBUG("bench debug request %zu from worker %d", seq, id);
+             break;
+     }
+ }
+ 
+ /**
+  * @brief 测试线程：等待所有线程就绪后连续调用日志宏
+  *
+  * @param arg 线程参数
+  * @return NULL
+  */
+ static void *worker_main(void *arg) {
+     worker_t *w = arg;
+     
+     while (atomic_load(w->start) == 0) {
+         sched_yield();
+     }
+     if (atomic_load(w->start) < 0) {
+         return NULL;
+     }
+     
+     if (!w->hist) {
+         for (size_t i = 0; i < w->calls; i++) {
+             log_once(w->kind, w->id, w->base + i);
+         }
+         return NULL;
+     }
+     
+     for (size_t i = 0; i < w->calls; i++) {
+         long long t0 = now_ns();
+         long long d;
+         
+         log_once(w->kind, w->id, w->base + i);
+         d = now_ns() - t0 - w->timer_ns;
+         hist_add(w->hist, d > 0 ? (unsigned long long)d : 0);
+     }
+     
+     return NULL;
+ }
+ 
+ /**
+  * @brief 用多个线程跑一轮
+  *
+  * @param kind 日志种类
+  * @param threads 线程数
+  * @param base 日志序号的起点
+  * @param calls 每个线程的调用次数
+  * @param timer_ns 计时本身的开销
+  * @param hist 合并后的延迟直方图，NULL表示不计时
+  * @return 从所有线程开始到全部结束的秒数，失败返回负数
+  */
+ static double run_pass(record_kind_t kind, int threads, size_t base, size_t calls,
+                        long long timer_ns, histogram_t *hist) {
+     pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+     worker_t *workers = calloc((size_t)threads, sizeof(worker_t));
+     histogram_t *hists = hist ? calloc((size_t)threads, sizeof(histogram_t)) : NULL;
+     atomic_int go = 0;
+     double elapsed = -1;
+     int started = 0;
+     long long start;
+     
+     if (!tids || !workers || (hist && !hists)) {
+         perror("calloc failed for bench workers");
+         free(tids);
+         free(workers);
+         free(hists);
+         return -1;
+     }
+     
+     for (int i = 0; i < threads; i++) {
+         workers[i].start = &go;
+         workers[i].kind = kind;
+         workers[i].id = i;
+         workers[i].base = base;
+         workers[i].calls = calls;
+         workers[i].timer_ns = timer_ns;
+         workers[i].hist = hists ? &hists[i] : NULL;
+         if (pthread_create(&tids[i], NULL, worker_main, &workers[i]) != 0) {
+             perror("pthread_create failed for bench worker");
+             break;
+         }
+         started++;
+     }
+     
+     /* 创建失败时让已启动的线程直接退出 */
+     start = now_ns();
+     atomic_store(&go, started == threads ? 1 : -1);
+     for (int i = 0; i < started; i++) {
+         pthread_join(tids[i], NULL);
+     }
+     if (started == threads) {
+         elapsed = (double)(now_ns() - start) / 1e9;
+     }
+     
+     for (int i = 0; hists && i < threads; i++) {
+         hist_merge(hist, &hists[i]);
+     }
+     
+     free(tids);
+     free(workers);
+     free(hists);
+     return elapsed;
+ }
+ 
+ /**
+  * @brief 跑一组测试条件并输出结果
+  *
+  * @param sc 测试条件
+  * @param threads 线程数
+  * @param calls 每个线程每轮的调用次数
+  * @param timer_ns 计时本身的开销
+  * @param json 是否输出 JSON Lines
+  * @return 成功返回0，失败返回-1
+  */
+ static int run_scenario(const scenario_t *sc, int threads, size_t calls, long long timer_ns, bool json) {
+     log_options_t options;
+     histogram_t *hist = calloc(1, sizeof(histogram_t));
+     double elapsed;
+     double rate;
+     
+     if (!hist) {
+         perror("calloc failed for bench histogram");
+         return -1;
+     }
+     
+     /* 不写标准输出，标准输出只用于测试结果 */
+     memset(&options, 0, sizeof(options));
+     options.no_stdout = true;
+     options.async = sc->async;
+     remove(BENCH_LOG_FILE);
+     if (log_init_ex(sc->output, LOG_LEVEL_INFO, sc->mode, &options) != 0) {
+         free(hist);
+         return -1;
+     }
+     
+     /* 第一轮只统计吞吐量，第二轮逐次计时 */
+     elapsed = run_pass(sc->kind, threads, 0, calls, timer_ns, NULL);
+     if (elapsed >= 0 && run_pass(sc->kind, threads, calls, calls, timer_ns, hist) < 0) {
+         elapsed = -1;
+     }
+     log_flush();
+     log_destroy();
+     remove(BENCH_LOG_FILE);
+     
+     if (elapsed < 0) {
+         free(hist);
+         return -1;
+     }
+     
+     rate = elapsed > 0 ? (double)calls * threads / elapsed : 0;
+     if (json) {
+         printf("{\"mode\":\"%s\",\"records\":\"%s\",\"output\":\"%s\",\"async\":%s,\"threads\":%d,"
+                "\"calls\":%zu,\"records_per_sec\":%.0f,\"p50_ns\":%llu,\"p99_ns\":%llu,"
+                "\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+                sc->mode == LOG_MODE_FILTER ? "filter" : "normal", record_names[sc->kind],
+                sc->output_name, sc->async ? "true" : "false", threads, calls * (size_t)threads, rate,
+                hist_percentile(hist, 0.50), hist_percentile(hist, 0.99),
+                hist_percentile(hist, 0.999), hist->max);
+     } else {
+         printf("%-7s %-12s %-9s %7d %14.0f %9llu %9llu %9llu %11llu\n",
+                sc->mode == LOG_MODE_FILTER ? "filter" : "normal", record_names[sc->kind],
+                sc->output_name, threads, rate,
+                hist_percentile(hist, 0.50), hist_percentile(hist, 0.99),
+                hist_percentile(hist, 0.999), hist->max);
+     }
+     fflush(stdout);
+     
+     free(hist);
+     return 0;
+ }
+ 
+ int main(int argc, char *argv[]) {
+     static const log_mode_t modes[] = { LOG_MODE_NORMAL, LOG_MODE_FILTER };
+     static const char *outputs[][2] = { { BENCH_LOG_FILE, "file" }, { "/dev/null", "devnull" } };
+     size_t calls = DEFAULT_CALLS;
+     long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+     int max_threads = cpus > 0 && cpus < DEFAULT_MAX_THREADS ? (int)cpus : DEFAULT_MAX_THREADS;
+     bool json = false;
+     bool async = false;
+     long long timer_ns;
+     int opt;
+     
+     while ((opt = getopt(argc, argv, "n:t:aj")) != -1) {
+         switch (opt) {
+             case 'n':
+                 calls = strtoul(optarg, NULL, 10);
+                 break;
+             case 't':
+                 max_threads = atoi(optarg);
+                 break;
+             case 'a':
+                 async = true;
+                 break;
+             case 'j':
+                 json = true;
+                 break;
+             default:
+                 fprintf(stderr, "用法: %s [-n 每线程调用次数] [-t 最大线程数] [-a 异步写出] [-j 输出JSON Lines]\n",
+                         argv[0]);
+                 return 1;
+         }
+     }
+     if (calls == 0 || max_threads <= 0) {
+         fprintf(stderr, "调用次数和线程数必须大于0\n");
+         return 1;
+     }
+     
+     timer_ns = timer_overhead_ns();
+     if (!json) {
+         printf("# calls/thread=%zu timer_overhead=%lldns async=%s\n", calls, timer_ns, async ? "yes" : "no");
+         printf("%-7s %-12s %-9s %7s %14s %9s %9s %9s %11s\n", "mode", "records", "output", "threads",
+                "records/s", "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)");
+     }
+     
+     for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+         for (int kind = 0; kind < RECORD_KIND_COUNT; kind++) {
+             for (size_t o = 0; o < sizeof(outputs) / sizeof(outputs[0]); o++) {
+                 scenario_t sc = { modes[m], (record_kind_t)kind, outputs[o][0], outputs[o][1], async };
+                 
+                 /* 线程数按2的幂增加，最后一组为最大线程数 */
+                 for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+                     if (run_scenario(&sc, threads, calls, timer_ns, json) != 0) {
+                         return 1;
+                     }
+                     if (threads == max_threads) {
+                         break;
+                     }
+                 }
+             }
+         }
+     }
+     
+     return 0;
+ }
@@ -6,8 +6,10 @@
  #include <gtest/gtest.h>
  #include <gmock/gmock.h>
  #include <cstdio>
+ #include <cstdint>
  #include <string>
  #include <thread>
+ #include <atomic>
  #include <chrono>
  #include <vector>
  #include <unistd.h>
@@ -16,7 +18,7 @@
  extern "C" {
      #include "log_filter.h"
      // 测试内部函数需要访问静态函数，在这里声明
-     unsigned int hash_string(const char *str, size_t len);
+     uint64_t hash_string(unsigned int tag, const char *str, size_t len);
  }
  
  class LogFilterTest : public ::testing::Test {
@@ -179,6 +181,124 @@
      // 如果代码线程安全，则测试将顺利完成
  }
  
+ // 测试多线程同时检查同一条日志：只有首条和海量日志提示各放行一次
+ TEST_F(LogFilterTest, ConcurrentSameLog) {
+     ASSERT_EQ(0, filter_init());
+     
+     const int THREAD_COUNT = 8;
+     const int CHECKS_PER_THREAD = 1000;
+     const char* test_log = "Concurrent log message\n";
+     std::atomic<int> passed(0);
+     
+     auto thread_func = [&]() {
+         for (int i = 0; i < CHECKS_PER_THREAD; i++) {
+             if (!filter_check(test_log, strlen(test_log))) {
+                 passed++;
+             }
+         }
+     };
+     
+     std::vector<std::thread> threads;
+     for (int i = 0; i < THREAD_COUNT; i++) {
+         threads.emplace_back(thread_func);
+     }
+     
+     for (auto& t : threads) {
+         t.join();
+     }
+     
+     ASSERT_EQ(2, passed.load());
+ }
+ 
+ // 测试多线程同时插入不同日志：分片扩容期间记录不会丢失或重复
+ TEST_F(LogFilterTest, ConcurrentInsertGrowth) {
+     ASSERT_EQ(0, filter_init());
+     
+     const int THREAD_COUNT = 8;
+     const int LOGS_PER_THREAD = 5000;
+     std::atomic<int> first_seen(0);
+     
+     // 每条日志由两个线程插入，只有一个线程看到首次出现
+     auto thread_func = [&](int thread_id) {
+         char buf[64];
+         for (int i = 0; i < LOGS_PER_THREAD; i++) {
+             int len = snprintf(buf, sizeof(buf), "Shared log %d %d", thread_id / 2, i);
+             if (!filter_check(buf, len)) {
+                 first_seen++;
+             }
+         }
+     };
+     
+     std::vector<std::thread> threads;
+     for (int i = 0; i < THREAD_COUNT; i++) {
+         threads.emplace_back(thread_func, i);
+     }
+     
+     for (auto& t : threads) {
+         t.join();
+     }
+     
+     ASSERT_EQ(THREAD_COUNT / 2 * LOGS_PER_THREAD, first_seen.load());
+ }
+ 
+ // 测试过期记录的清理：窗口结束后记录被删除，再次出现视为首次
+ TEST_F(LogFilterTest, ExpireRecords) {
+     ASSERT_EQ(0, filter_init());
+     
+     char buf[64];
+     for (int i = 0; i < 1000; i++) {
+         int len = snprintf(buf, sizeof(buf), "Expiring log %d", i);
+         ASSERT_FALSE(filter_check(buf, len));
+     }
+     ASSERT_EQ(1000u, filter_record_count());
+     
+     // 一小时之内不会过期
+     filter_expire(time(NULL) + 1800);
+     ASSERT_EQ(1000u, filter_record_count());
+     ASSERT_TRUE(filter_check("Expiring log 0", strlen("Expiring log 0")));
+     
+     // 超过一小时全部过期
+     filter_expire(time(NULL) + 7200);
+     ASSERT_EQ(0u, filter_record_count());
+     
+     // 删除后的槽位可以复用，记录重新创建
+     for (int i = 0; i < 1000; i++) {
+         int len = snprintf(buf, sizeof(buf), "Expiring log %d", i);
+         ASSERT_FALSE(filter_check(buf, len));
+     }
+     ASSERT_EQ(1000u, filter_record_count());
+ }
+ 
+ // 收集汇总回调的结果
+ static void collect_report(unsigned int tag, const char *content, size_t content_len,
+                            uint64_t fingerprint, unsigned int count, void *arg) {
+     (void)fingerprint;
+     auto *reports = static_cast<std::vector<std::pair<std::string, unsigned int>>*>(arg);
+     std::string text = content ? std::string(content, content_len) : std::string();
+     reports->emplace_back(std::to_string(tag) + ":" + text, count);
+ }
+ 
+ // 测试被过滤日志的汇总：报告上次汇总以来被过滤的次数，汇总后清零
+ TEST_F(LogFilterTest, ReportSuppressed) {
+     ASSERT_EQ(0, filter_init());
+     
+     const char* test_log = "Suppressed log";
+     for (int i = 0; i < 5; i++) {
+         filter_check_ex(2, test_log, strlen(test_log));
+     }
+     ASSERT_FALSE(filter_check("Printed once", strlen("Printed once")));
+     
+     std::vector<std::pair<std::string, unsigned int>> reports;
+     filter_report_suppressed(collect_report, &reports);
+     ASSERT_EQ(1u, reports.size());
+     EXPECT_EQ("2:Suppressed log", reports[0].first);
+     EXPECT_EQ(4u, reports[0].second);
+     
+     reports.clear();
+     filter_report_suppressed(collect_report, &reports);
+     EXPECT_TRUE(reports.empty());
+ }
+ 
  // 测试非常长的日志内容
  TEST_F(LogFilterTest, LongLogContent) {
      ASSERT_EQ(0, filter_init());
@@ -196,6 +316,103 @@
      ASSERT_TRUE(filter_check(long_log.c_str(), long_log.length()));
  }
  
+ // 测试带附加键的过滤：相同内容、不同tag视为不同日志
+ TEST_F(LogFilterTest, TaggedFilterCheck) {
+     ASSERT_EQ(0, filter_init());
+     
+     const char* test_log = "Tagged log message\n";
+     size_t len = strlen(test_log);
+     
+     ASSERT_FALSE(filter_check_ex(1, test_log, len));
+     ASSERT_FALSE(filter_check_ex(2, test_log, len));
+     ASSERT_TRUE(filter_check_ex(1, test_log, len));
+     ASSERT_TRUE(filter_check_ex(2, test_log, len));
+     
+     // 不带tag的接口等价于tag为0
+     ASSERT_FALSE(filter_check(test_log, len));
+     ASSERT_TRUE(filter_check_ex(0, test_log, len));
+ }
+ 
+ // 测试大量不同日志：哈希表多次扩容后已有记录仍能找到
+ TEST_F(LogFilterTest, TableGrowth) {
+     ASSERT_EQ(0, filter_init());
+     
+     const int count = 50000;
+     char buf[64];
+     
+     for (int i = 0; i < count; i++) {
+         int len = snprintf(buf, sizeof(buf), "Growth log message %d", i);
+         ASSERT_FALSE(filter_check(buf, len));
+     }
+     
+     for (int i = 0; i < count; i++) {
+         int len = snprintf(buf, sizeof(buf), "Growth log message %d", i);
+         ASSERT_TRUE(filter_check(buf, len));
+     }
+ }
+ 
+ // 测试只保存指纹的模式：过滤行为与保存内容时相同
+ TEST_F(LogFilterTest, FingerprintOnly) {
+     ASSERT_EQ(0, filter_init_ex(false));
+     
+     std::string long_log(2000, 'x');
+     std::string other_log = long_log;
+     other_log[1000] = 'y';
+     
+     ASSERT_FALSE(filter_check(long_log.c_str(), long_log.length()));
+     ASSERT_FALSE(filter_check(other_log.c_str(), other_log.length()));
+     ASSERT_TRUE(filter_check(long_log.c_str(), long_log.length()));
+     ASSERT_TRUE(filter_check(other_log.c_str(), other_log.length()));
+     
+     // 长度不同的前缀不是同一条日志
+     ASSERT_FALSE(filter_check(long_log.c_str(), long_log.length() - 1));
+ }
+ 
+ // 测试过滤器统计：重复日志和海量日志分别计数，表的大小和内存随记录增长
+ TEST_F(LogFilterTest, Stats) {
+     filter_stats_t stats;
+     
+     filter_get_stats(&stats);
+     EXPECT_EQ(0u, stats.records);
+     
+     ASSERT_EQ(0, filter_init());
+     char buf[64];
+     for (int i = 0; i < 1000; i++) {
+         int len = snprintf(buf, sizeof(buf), "Stats log %d", i);
+         ASSERT_FALSE(filter_check(buf, len));
+     }
+     
+     // 第60次标记为海量日志并打印，之后的计为海量日志
+     const char *flood = "Stats flood";
+     for (int i = 0; i < 70; i++) {
+         filter_check(flood, strlen(flood));
+     }
+     
+     filter_get_stats(&stats);
+     EXPECT_EQ(1001u, stats.records);
+     EXPECT_GE(stats.capacity, stats.records);
+     EXPECT_GE(stats.max_probe, 1u);
+     EXPECT_GT(stats.memory_bytes, 1001u * (sizeof("Stats log 0") - 1));
+     EXPECT_EQ(58u, stats.filtered_duplicate);
+     EXPECT_EQ(10u, stats.filtered_massive);
+     
+     // 只检查海量日志时重复日志不计数
+     for (int i = 0; i < 70; i++) {
+         filter_check_massive("Stats massive only", strlen("Stats massive only"));
+     }
+     filter_get_stats(&stats);
+     EXPECT_EQ(58u, stats.filtered_duplicate);
+     EXPECT_EQ(20u, stats.filtered_massive);
+     
+     // 重新初始化后清零
+     filter_destroy();
+     ASSERT_EQ(0, filter_init());
+     filter_get_stats(&stats);
+     EXPECT_EQ(0u, stats.records);
+     EXPECT_EQ(0u, stats.filtered_duplicate);
+     EXPECT_EQ(0u, stats.filtered_massive);
+ }
+ 
  // 主函数
  int main(int argc, char **argv) {
      ::testing::InitGoogleTest(&argc, argv);
@@ -10,11 +10,28 @@
  #include <string>
  #include <thread>
  #include <chrono>
+ #include <atomic>
+ #include <vector>
+ #include <cstring>
+ #include <unistd.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ #include <signal.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <sys/resource.h>
  
  // 包含被测试的头文件
  extern "C" {
      #include "logger.h"
      #include "log_filter.h"
+     #include "log_binary.h"
+     #include "log_clock.h"
+     #include "log_lz.h"
+     #include "log_kv.h"
+     #include "log_sink.h"
+     #include "log_index.h"
+     #include "log_mmap.h"
  }
  
  class LoggerTest : public ::testing::Test {
@@ -148,6 +165,414 @@
      
      // 检查消息内容
      EXPECT_THAT(content, ::testing::HasSubstr("Test message with formatting: 42, string"));
+     
+     // 前缀与消息之间只有一个空格
+     EXPECT_THAT(content, ::testing::HasSubstr("TestBody] Test message"));
+ }
+ 
+ // 测试未打开的级别：在调用之前返回，不求值参数
+ TEST_F(LoggerTest, DisabledLevelSkipsArguments) {
+     int evaluated = 0;
+     auto arg = [&evaluated]() { return ++evaluated; };
+     
+     ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_WARN, LOG_MODE_NORMAL));
+     
+     LOG_DEBUG("Disabled debug %d", arg());
+     LOG_INFO("Disabled info %d", arg());
+     EXPECT_EQ(0, evaluated);
+     
+     LOG_WARN("Enabled warn %d", arg());
+     EXPECT_EQ(1, evaluated);
+     
+     // 运行时调整级别立即生效
+     log_set_level(LOG_LEVEL_DEBUG);
+     LOG_DEBUG("Enabled debug %d", arg());
+     EXPECT_EQ(2, evaluated);
+     
+     // 销毁后所有级别都关闭
+     log_destroy();
+     LOG_FATAL("After destroy %d", arg());
+     EXPECT_EQ(2, evaluated);
+ }
+ 
+ // 以下函数中的 LOG_* 宏属于 "net" 模块
+ #undef LOG_MODULE
+ #define LOG_MODULE "net"
+ static void log_from_net_module(const char *msg) {
+     LOG_DEBUG("%s", msg);
+ }
+ #undef LOG_MODULE
+ #define LOG_MODULE NULL
+ 
+ // 测试模块日志级别
+ TEST_F(LoggerTest, ModuleLevel) {
+     // 初始化之前也可以设置模块级别
+     ASSERT_EQ(0, log_set_module_level("net", LOG_LEVEL_DEBUG));
+     ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_WARN, LOG_MODE_NORMAL));
+     
+     log_from_net_module("Net debug one");
+     LOG_DEBUG("Global debug");
+     EXPECT_TRUE(log_file_contains("Net debug one"));
+     EXPECT_FALSE(log_file_contains("Global debug"));
+     
+     // 修改模块级别后调用点缓存失效
+     ASSERT_EQ(0, log_set_module_level("net", LOG_LEVEL_ERROR));
+     log_from_net_module("Net debug two");
+     EXPECT_FALSE(log_file_contains("Net debug two"));
+     
+     // 清除后使用全局级别
+     log_clear_module_level("net");
+     log_set_level(LOG_LEVEL_DEBUG);
+     log_from_net_module("Net debug three");
+     EXPECT_TRUE(log_file_contains("Net debug three"));
+     
+     // 无效参数
+     EXPECT_EQ(-1, log_set_module_level(NULL, LOG_LEVEL_INFO));
+     EXPECT_EQ(-1, log_set_module_level("a_module_name_longer_than_the_limit", LOG_LEVEL_INFO));
+ }
+ 
+ // 测试键值日志的文本和 JSON 输出
+ TEST_F(LoggerTest, KeyValue) {
+     ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL));
+     
+     LOG_KV(LOG_LEVEL_INFO, "request done", log_field_str("path", "/index"), log_field_int("status", -404),
+            log_field_double("cost", 1.25), log_field_bool("cached", true), log_field_str("user", "a b"));
+     log_flush();
+     EXPECT_TRUE(log_file_contains("request done path=/index status=-404 cost=1.25 cached=true user=\"a b\"\n"));
+     
+     log_destroy();
+     std::remove(temp_log_filename);
+     
+     log_options_t options = {};
+     options.format = LOG_FORMAT_JSON;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     LOG_KV(LOG_LEVEL_WARN, "quoted \"msg\"", log_field_strn("tab", "x\ty", 3), log_field_int("n", 7));
+     LOG_INFO("printf %d", 42);
+     log_flush();
+     EXPECT_TRUE(log_file_contains("\"level\":\"WARN\""));
+     EXPECT_TRUE(log_file_contains("\"msg\":\"quoted \\\"msg\\\"\",\"tab\":\"x\\ty\",\"n\":7}\n"));
+     EXPECT_TRUE(log_file_contains("\"msg\":\"printf 42\"}\n"));
+ }
+ 
+ // 测试键值序列化的截断
+ TEST(LogKvTest, Truncation) {
+     char buf[96];
+     std::string long_value(200, 'x');
+     log_field_t fields[] = { log_field_int("a", 1), log_field_str("long", long_value.c_str()) };
+     
+     // 放不下的字段整个丢弃
+     size_t len = log_kv_format_text(buf, 16, "msg", fields, 2);
+     EXPECT_EQ("msg a=1", std::string(buf, len));
+     
+     // JSON 截断后仍以 "}\n" 结束
+     len = log_kv_format_json(buf, sizeof(buf), "t", "INFO", "f.c", 1, "fn", "m", 1, fields, 2);
+     ASSERT_GT(len, 0u);
+     EXPECT_EQ("{\"time\":\"t\",\"level\":\"INFO\",\"file\":\"f.c\",\"line\":1,\"func\":\"fn\",\"msg\":\"m\",\"a\":1}\n",
+               std::string(buf, len));
+     EXPECT_EQ(0u, log_kv_format_json(buf, 8, "t", "INFO", "f.c", 1, "fn", "m", 1, fields, 2));
+ }
+ 
+ // 测试浮点数字段：6位小数能还原时逐位写出，否则写出能解析回原值的最短形式
+ TEST(LogKvTest, DoublePrecision) {
+     char buf[256];
+     const double values[] = { 1.25, 0.1, -3.5, 100, 0.123456789, 0.00012345, 1.0 / 3, 123456789.123, 1e20, 5e-324 };
+     const char *expected[] = { "1.25", "0.1", "-3.5", "100", "0.123456789", "0.00012345",
+                                "0.3333333333333333", "123456789.123", "1e+20", "4.94065645841247e-324" };
+     
+     for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+         log_field_t field = log_field_double("v", values[i]);
+         size_t len = log_kv_format_text(buf, sizeof(buf), "m", &field, 1);
+         std::string text(buf, len);
+         ASSERT_EQ(0u, text.find("m v="));
+         EXPECT_EQ(expected[i], text.substr(4)) << i;
+         EXPECT_EQ(values[i], std::strtod(text.c_str() + 4, NULL)) << i;
+     }
+ }
+ 
+ // 一直阻塞到被放行的 sink，模拟写得很慢的终端
+ struct BlockedSink {
+     std::atomic<bool> release{false};
+     std::atomic<int> written{0};
+ };
+ 
+ static void blocked_write(void *ctx, log_level_t, const char *, size_t) {
+     BlockedSink *blocked = static_cast<BlockedSink *>(ctx);
+     while (!blocked->release.load()) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+     }
+     blocked->written++;
+ }
+ 
+ // 测试多个输出目标
+ TEST_F(LoggerTest, Sinks) {
+     const char *sink_file = "test_sink.log";
+     const char *sock_path = "test_sink.sock";
+     std::remove(sink_file);
+     unlink(sock_path);
+     
+     // 接收日志的 Unix 数据报套接字
+     int server = socket(AF_UNIX, SOCK_DGRAM, 0);
+     ASSERT_GE(server, 0);
+     struct sockaddr_un addr = {};
+     addr.sun_family = AF_UNIX;
+     std::strcpy(addr.sun_path, sock_path);
+     ASSERT_EQ(0, bind(server, (struct sockaddr *)&addr, sizeof(addr)));
+     
+     log_options_t options = {};
+     options.no_stdout = true;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     BlockedSink blocked;
+     static const log_sink_ops_t blocked_ops = { blocked_write, NULL, NULL };
+     log_sink_t *slow = log_sink_create(&blocked_ops, &blocked, LOG_LEVEL_DEBUG, 4);
+     log_sink_t *memory = log_sink_memory(1 << 20, LOG_LEVEL_INFO);
+     log_sink_t *file = log_sink_file(sink_file, LOG_LEVEL_ERROR, 0);
+     log_sink_t *unix_sink = log_sink_unix(sock_path, LOG_LEVEL_WARN, 0);
+     ASSERT_NE(nullptr, slow);
+     ASSERT_NE(nullptr, memory);
+     ASSERT_NE(nullptr, file);
+     ASSERT_NE(nullptr, unix_sink);
+     ASSERT_EQ(0, log_add_sink(slow));
+     ASSERT_EQ(0, log_add_sink(memory));
+     ASSERT_EQ(0, log_add_sink(file));
+     ASSERT_EQ(0, log_add_sink(unix_sink));
+     
+     // 阻塞的 sink 不影响主日志文件和其他 sink，只丢弃自己的日志
+     for (int i = 0; i < 100; i++) {
+         LOG_INFO("Sink info %d", i);
+     }
+     LOG_DEBUG("Sink debug");
+     LOG_ERROR("Sink error");
+     
+     // 阻塞的 sink 不能参与 log_flush，分别等待其他 sink
+     log_sink_flush(memory);
+     log_sink_flush(file);
+     log_sink_flush(unix_sink);
+     EXPECT_TRUE(log_file_contains("Sink info 99"));
+     EXPECT_TRUE(log_file_contains("Sink debug"));
+     EXPECT_GT(log_sink_dropped(slow), 0u);
+     EXPECT_EQ(0u, log_sink_dropped(memory));
+     
+     // 内存 sink 按级别阈值过滤
+     std::vector<char> buf(1 << 20);
+     std::string memory_content(buf.data(), log_sink_memory_read(memory, buf.data(), buf.size()));
+     EXPECT_NE(std::string::npos, memory_content.find("Sink info 0\n"));
+     EXPECT_NE(std::string::npos, memory_content.find("Sink info 99\n"));
+     EXPECT_NE(std::string::npos, memory_content.find("Sink error"));
+     EXPECT_EQ(std::string::npos, memory_content.find("Sink debug"));
+     
+     // 文件 sink 只有 ERROR
+     std::ifstream in(sink_file);
+     std::string file_content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+     EXPECT_NE(std::string::npos, file_content.find("Sink error"));
+     EXPECT_EQ(std::string::npos, file_content.find("Sink info"));
+     
+     // 套接字每条日志一个数据报
+     char datagram[4096];
+     ssize_t n = recv(server, datagram, sizeof(datagram), MSG_DONTWAIT);
+     ASSERT_GT(n, 0);
+     EXPECT_NE(std::string::npos, std::string(datagram, (size_t)n).find("Sink error"));
+     
+     // 放行后销毁，不会卡住
+     blocked.release = true;
+     log_destroy();
+     EXPECT_GT(blocked.written.load(), 0);
+     
+     close(server);
+     unlink(sock_path);
+     std::remove(sink_file);
+ }
+ 
+ // 测试飞行记录器：级别未打开的日志只在出错或按需转储时写出
+ TEST_F(LoggerTest, FlightRecorder) {
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.flight_recorder_size = 16 * 1024;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_WARN, LOG_MODE_NORMAL, &options));
+     
+     for (int i = 0; i < 3; i++) {
+         LOG_DEBUG("Recorded debug %d %s", i, "ctx");
+     }
+     LOG_INFO("Recorded info");
+     log_flush();
+     EXPECT_FALSE(log_file_contains("Recorded debug"));
+     
+     // 错误日志之前按时间顺序写出记录的上下文
+     LOG_ERROR("Recorder error");
+     log_flush();
+     std::string content = get_log_content();
+     size_t first = content.find("Recorded debug 0 ctx");
+     size_t info = content.find("Recorded info");
+     size_t error = content.find("Recorder error");
+     ASSERT_NE(std::string::npos, first);
+     ASSERT_NE(std::string::npos, info);
+     ASSERT_NE(std::string::npos, error);
+     EXPECT_LT(first, content.find("Recorded debug 2 ctx"));
+     EXPECT_LT(info, error);
+     EXPECT_NE(std::string::npos, content.find("[DEBUG]"));
+     
+     // 转储后清空，不会重复写出
+     clear_log_file();
+     LOG_ERROR("Recorder error again");
+     log_flush();
+     EXPECT_FALSE(log_file_contains("Recorded debug"));
+     
+     // 按需转储，环形缓冲只保留最近的日志
+     for (int i = 0; i < 1000; i++) {
+         LOG_DEBUG("Wrapped debug %d", i);
+     }
+     clear_log_file();
+     log_flight_dump();
+     log_flush();
+     EXPECT_TRUE(log_file_contains("Wrapped debug 999"));
+     EXPECT_FALSE(log_file_contains("Wrapped debug 0\n"));
+     
+     // 未启用时不记录
+     log_destroy();
+     ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_WARN, LOG_MODE_NORMAL));
+     LOG_DEBUG("Unrecorded debug");
+     LOG_ERROR("Plain error");
+     log_flush();
+     EXPECT_FALSE(log_file_contains("Unrecorded debug"));
+     log_destroy();
+ }
+ 
+ // 崩溃时在子进程中写日志并触发信号
+ static void crash_with_pending_logs(const char *filename, bool async, bool handler, int sig) {
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.async = async;
+     options.flush_policy = LOG_FLUSH_BYTES;
+     options.flush_bytes = 1 << 20;
+     options.crash_handler = handler;
+     if (log_init_ex(filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options) != 0) {
+         _exit(1);
+     }
+     for (int i = 0; i < 50; i++) {
+         LOG_INFO("Pending before crash %d", i);
+     }
+     raise(sig);
+     _exit(0);
+ }
+ 
+ static void crash_with_pending_sink(const char *filename, const char *sink_filename) {
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.crash_handler = true;
+     if (log_init_ex(filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options) != 0) {
+         _exit(1);
+     }
+     log_sink_t *sink = log_sink_file(sink_filename, LOG_LEVEL_DEBUG, 0);
+     if (!sink || log_add_sink(sink) != 0) {
+         _exit(1);
+     }
+     for (int i = 0; i < 50; i++) {
+         LOG_INFO("Sink pending before crash %d", i);
+     }
+     raise(SIGSEGV);
+     _exit(0);
+ }
+ 
+ // 测试崩溃时紧急写出缓冲和异步队列中的日志
+ TEST_F(LoggerTest, CrashFlush) {
+     // 同步模式：日志停留在输出缓冲中
+     EXPECT_EXIT(crash_with_pending_logs(temp_log_filename, false, true, SIGABRT),
+                 ::testing::KilledBySignal(SIGABRT), "");
+     EXPECT_TRUE(log_file_contains("Pending before crash 0\n"));
+     EXPECT_TRUE(log_file_contains("Pending before crash 49\n"));
+     
+     // 异步模式：日志可能还在队列中
+     clear_log_file();
+     EXPECT_EXIT(crash_with_pending_logs(temp_log_filename, true, true, SIGSEGV),
+                 ::testing::KilledBySignal(SIGSEGV), "");
+     EXPECT_TRUE(log_file_contains("Pending before crash 0\n"));
+     EXPECT_TRUE(log_file_contains("Pending before crash 49\n"));
+     
+     // 未启用时缓冲中的日志随进程丢失
+     clear_log_file();
+     EXPECT_EXIT(crash_with_pending_logs(temp_log_filename, false, false, SIGABRT),
+                 ::testing::KilledBySignal(SIGABRT), "");
+     EXPECT_FALSE(log_file_contains("Pending before crash"));
+     
+     // sink 的输出缓冲和队列中的日志也要写出
+     const char *sink_file = "test_crash_sink.log";
+     std::remove(sink_file);
+     EXPECT_EXIT(crash_with_pending_sink(temp_log_filename, sink_file),
+                 ::testing::KilledBySignal(SIGSEGV), "");
+     std::ifstream sink_in(sink_file);
+     std::stringstream sink_content;
+     sink_content << sink_in.rdbuf();
+     EXPECT_NE(std::string::npos, sink_content.str().find("Sink pending before crash 0\n"));
+     EXPECT_NE(std::string::npos, sink_content.str().find("Sink pending before crash 49\n"));
+     std::remove(sink_file);
+     
+     // 销毁后恢复原来的信号处理方式
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.crash_handler = true;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     struct sigaction current;
+     sigaction(SIGSEGV, NULL, &current);
+     EXPECT_NE(SIG_DFL, current.sa_handler);
+     log_destroy();
+     sigaction(SIGSEGV, NULL, &current);
+     EXPECT_EQ(SIG_DFL, current.sa_handler);
+ }
+ 
+ // 测试运行统计
+ TEST_F(LoggerTest, Stats) {
+     log_stats_t stats;
+     log_options_t options = {};
+     options.no_stdout = true;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_FILTER, &options));
+     
+     for (int i = 0; i < 10; i++) {
+         LOG_INFO("Stats unique %d", i);
+     }
+     for (int i = 0; i < 3; i++) {
+         LOG_WARN("Stats repeated");
+     }
+     for (int i = 0; i < 70; i++) {
+         LOG_ERROR("Stats flood");
+     }
+     log_flush();
+     
+     log_get_stats(&stats);
+     EXPECT_EQ(11u, stats.emitted[LOG_LEVEL_INFO]);  // 包括初始化成功的日志
+     EXPECT_EQ(1u, stats.emitted[LOG_LEVEL_WARN]);
+     EXPECT_EQ(2u, stats.emitted[LOG_LEVEL_ERROR]);
+     EXPECT_EQ(0u, stats.emitted[LOG_LEVEL_DEBUG]);
+     EXPECT_EQ(2u + 58u, stats.filtered_duplicate);
+     EXPECT_EQ(10u, stats.filtered_massive);
+     EXPECT_EQ(0u, stats.dropped);
+     EXPECT_GE(stats.filter_records, 13u);
+     EXPECT_GE(stats.filter_capacity, stats.filter_records);
+     EXPECT_GE(stats.filter_max_probe, 1u);
+     EXPECT_GT(stats.filter_memory, 0u);
+     
+     // 写出的字节数与日志文件大小一致
+     EXPECT_EQ(get_log_content().size(), stats.bytes_written);
+     
+     // 每条日志写出一次
+     unsigned long long writes = 0;
+     for (int i = 0; i < LOG_STATS_LATENCY_BUCKETS; i++) {
+         writes += stats.write_latency[i];
+     }
+     EXPECT_EQ(14u, writes);
+     
+     // 按调用点屏蔽的计为海量日志
+     log_set_mode(LOG_MODE_CALLSITE);
+     for (int i = 0; i < 70; i++) {
+         LOG_INFO("Stats callsite %d", i);
+     }
+     log_get_stats(&stats);
+     EXPECT_EQ(20u, stats.filtered_massive);
+     
+     log_destroy();
+     log_get_stats(&stats);
+     EXPECT_EQ(0u, stats.emitted[LOG_LEVEL_INFO]);
+     EXPECT_EQ(0u, stats.filter_records);
  }
  
  // 测试日志过滤功能
@@ -201,6 +626,76 @@
      ASSERT_FALSE(log_file_contains("Massive log test"));
  }
  
+ // 测试按调用点过滤：同一调用点内容不同也按调用次数屏蔽
+ TEST_F(LoggerTest, CallsiteFilter) {
+     for (int round = 0; round < 2; round++) {
+         ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_CALLSITE));
+         clear_log_file();
+         
+         for (int i = 0; i < 200; i++) {
+             LOG_WARN("Flood %d", i);
+         }
+         
+         // 前60条正常打印，之后被屏蔽；重新初始化后重新计数
+         std::string content = get_log_content();
+         EXPECT_THAT(content, ::testing::HasSubstr("Flood 59\n"));
+         EXPECT_THAT(content, ::testing::Not(::testing::HasSubstr("Flood 60\n")));
+         
+         // 不经过调用点的日志不受影响
+         log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, "Direct message");
+         ASSERT_TRUE(log_file_contains("Direct message"));
+         
+         log_destroy();
+     }
+ }
+ 
+ // 测试流量控制：超出限制时先丢弃低级别日志，ERROR总是写出
+ TEST_F(LoggerTest, Governor) {
+     log_options_t options = {};
+     options.governor_records_per_sec = 100;
+     
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     for (int i = 0; i < 500; i++) {
+         LOG_INFO("Governed info %d", i);
+     }
+     for (int i = 0; i < 5; i++) {
+         LOG_ERROR("Governed error %d", i);
+     }
+     
+     std::string content = get_log_content();
+     size_t info_lines = 0;
+     for (size_t pos = content.find("Governed info"); pos != std::string::npos;
+          pos = content.find("Governed info", pos + 1)) {
+         info_lines++;
+     }
+     
+     // INFO 最多用掉令牌桶的75%
+     EXPECT_GT(info_lines, 0u);
+     EXPECT_LT(info_lines, 100u);
+     EXPECT_EQ(500u - info_lines, log_get_dropped(LOG_LEVEL_INFO));
+     
+     EXPECT_THAT(content, ::testing::HasSubstr("Governed error 4"));
+     EXPECT_EQ(0u, log_get_dropped(LOG_LEVEL_ERROR));
+ }
+ 
+ // 测试被过滤日志的汇总：销毁前输出最后一次汇总
+ TEST_F(LoggerTest, SuppressSummary) {
+     log_options_t options = {};
+     options.suppress_summary_sec = 60;
+     
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_FILTER, &options));
+     
+     for (int i = 0; i < 10; i++) {
+         LOG_WARN("Summarized message");
+     }
+     ASSERT_FALSE(log_file_contains("suppressed"));
+     
+     log_destroy();
+     EXPECT_THAT(get_log_content(),
+                 ::testing::HasSubstr("suppressed 9 occurrences in last 1s: Summarized message\n"));
+ }
+ 
  // 测试多线程安全性
  TEST_F(LoggerTest, ThreadSafety) {
      ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL));
@@ -235,6 +730,733 @@
      }
  }
  
+ // 测试多线程扩展性：格式化在线程私有缓冲区中完成，只有过滤判断和写出需要加锁
+ TEST_F(LoggerTest, ThreadSafetyScaling) {
+     ASSERT_EQ(0, log_init(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_FILTER));
+     clear_log_file();
+     
+     const int LOGS_PER_THREAD = 20000;
+     const int DISTINCT_MESSAGES = 10;
+     
+     // 重复日志在过滤模式下只打印一次，耗时主要集中在格式化上
+     auto thread_func = [LOGS_PER_THREAD, DISTINCT_MESSAGES](int thread_id) {
+         (void)thread_id;
+         for (int i = 0; i < LOGS_PER_THREAD; i++) {
+             int key = i % DISTINCT_MESSAGES;
+             LOG_INFO("Scaling message %d: value=%.3f, name=%s", key, key * 1.5, "scaling");
+         }
+     };
+     
+     // 返回每秒处理的日志条数
+     auto run = [&thread_func, LOGS_PER_THREAD](int thread_count) {
+         auto start = std::chrono::steady_clock::now();
+         std::vector<std::thread> threads;
+         for (int i = 0; i < thread_count; i++) {
+             threads.emplace_back(thread_func, i);
+         }
+         for (auto& t : threads) {
+             t.join();
+         }
+         std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+         return thread_count * LOGS_PER_THREAD / elapsed.count();
+     };
+     
+     double single = run(1);
+     double multi = run(16);
+     printf("ThreadSafetyScaling: 1 thread %.0f logs/s, 16 threads %.0f logs/s (x%.2f)\n",
+            single, multi, multi / single);
+     RecordProperty("logs_per_sec_1_thread", std::to_string(static_cast<long>(single)));
+     RecordProperty("logs_per_sec_16_threads", std::to_string(static_cast<long>(multi)));
+     
+     // 每条不同的日志只打印首次出现和海量日志提示各一次
+     std::string content = get_log_content();
+     for (int key = 0; key < DISTINCT_MESSAGES; key++) {
+         std::string text = "Scaling message " + std::to_string(key) + ":";
+         int count = 0;
+         for (size_t pos = content.find(text); pos != std::string::npos; pos = content.find(text, pos + 1)) {
+             count++;
+         }
+         EXPECT_EQ(2, count) << text;
+     }
+ }
+ 
+ // 测试异步模式：日志由后台线程写出，销毁时应全部落盘
+ TEST_F(LoggerTest, AsyncMode) {
+     log_options_t options = {};
+     options.async = true;
+     options.async_queue_size = 64; // 使用较小的队列，覆盖队列写满的情况
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     const int THREAD_COUNT = 8;
+     const int LOGS_PER_THREAD = 200;
+     
+     auto thread_func = [LOGS_PER_THREAD](int thread_id) {
+         for (int i = 0; i < LOGS_PER_THREAD; i++) {
+             LOG_INFO("Async thread %d, log %d", thread_id, i);
+         }
+     };
+     
+     std::vector<std::thread> threads;
+     for (int i = 0; i < THREAD_COUNT; i++) {
+         threads.emplace_back(thread_func, i);
+     }
+     
+     for (auto& t : threads) {
+         t.join();
+     }
+     
+     // 销毁时会等待后台线程写完队列中剩余的日志
+     log_destroy();
+     
+     std::string content = get_log_content();
+     for (int i = 0; i < THREAD_COUNT; i++) {
+         for (int j = 0; j < LOGS_PER_THREAD; j++) {
+             std::string line = "Async thread " + std::to_string(i) + ", log " + std::to_string(j) + "\n";
+             ASSERT_TRUE(content.find(line) != std::string::npos) << line;
+         }
+     }
+ }
+ 
+ // 解码二进制日志文件，返回还原后的文本
+ static std::string decode_binary_log(const char* filename) {
+     FILE* in = fopen(filename, "rb");
+     if (!in) {
+         return "";
+     }
+     
+     log_binary_decoder_t* dec = log_binary_decoder_open(in);
+     std::string text;
+     char line[8192];
+     int len;
+     while ((len = log_binary_decode_next(dec, line, sizeof(line))) > 0) {
+         text.append(line, len);
+     }
+     EXPECT_EQ(0, len); // 应正常读到文件末尾
+     
+     log_binary_decoder_close(dec);
+     fclose(in);
+     return text;
+ }
+ 
+ // 测试二进制模式：只记录原始参数，解码后应与文本格式一致
+ TEST_F(LoggerTest, BinaryMode) {
+     log_options_t options = {};
+     options.format = LOG_FORMAT_BINARY;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     const char* dynamic_fmt = "Dynamic format %d";
+     long long big = -1234567890123LL;
+     size_t size = 4096;
+     
+     LOG_INFO("Integers: %d %u %x %05d %lld %zu", -42, 42u, 255, 7, big, size);
+     LOG_WARN("Strings: [%s] [%-6s] [%.3s] %c", "hello", "pad", "truncate", 'Z');
+     LOG_ERROR("Floats: %.2f %e %g 100%%", 3.14159, 12345.678, 0.5);
+     LOG_DEBUG("Star width: [%*d] [%.*f]", 6, 99, 1, 2.25);
+     log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, dynamic_fmt, 7);
+     for (int i = 0; i < 3; i++) {
+         LOG_INFO("Loop iteration %d", i);
+     }
+     log_destroy();
+     
+     // 二进制文件中不应包含格式化后的文本
+     EXPECT_FALSE(log_file_contains("Integers: -42"));
+     
+     std::string text = decode_binary_log(temp_log_filename);
+     EXPECT_THAT(text, ::testing::HasSubstr("Log system initialized successfully"));
+     EXPECT_THAT(text, ::testing::HasSubstr("[INFO] [" __FILE__ ":"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Integers: -42 42 ff 00007 -1234567890123 4096\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("[WARN]"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Strings: [hello] [pad   ] [tru] Z\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("[ERROR]"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Floats: 3.14 1.234568e+04 0.5 100%\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Star width: [    99] [2.2]\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Dynamic format 7\n"));
+     for (int i = 0; i < 3; i++) {
+         EXPECT_THAT(text, ::testing::HasSubstr("Loop iteration " + std::to_string(i) + "\n"));
+     }
+     EXPECT_THAT(text, ::testing::MatchesRegex("^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9:]{8}\\.[0-9]{3} \\[INFO\\].*"));
+ }
+ 
+ // 不以'\0'结尾的缓冲区，放在一页的末尾，后一页不可访问，越界读取会立即崩溃
+ class GuardedBuffer {
+ public:
+     GuardedBuffer(const char *data, size_t len) : page_(sysconf(_SC_PAGESIZE)) {
+         map_ = mmap(nullptr, page_ * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         mprotect(static_cast<char *>(map_) + page_, page_, PROT_NONE);
+         buf_ = static_cast<char *>(map_) + page_ - len;
+         memcpy(buf_, data, len);
+     }
+     ~GuardedBuffer() { munmap(map_, page_ * 2); }
+     const char *get() const { return buf_; }
+ 
+ private:
+     size_t page_;
+     void *map_;
+     char *buf_;
+ };
+ 
+ // 测试二进制模式下带精度的字符串参数只读取精度个字节
+ TEST_F(LoggerTest, BinaryStringPrecision) {
+     log_options_t options = {};
+     options.format = LOG_FORMAT_BINARY;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     GuardedBuffer buf("hello", 5);
+     LOG_INFO("Unterminated: [%.*s] [%-*.*s]", 5, buf.get(), 6, 3, buf.get());
+     LOG_INFO("Negative precision: [%.*s]", -1, "whole");
+     LOG_INFO("Fixed precision: [%.4s] [%8.2s]", buf.get(), buf.get());
+     LOG_INFO("Wide precision: [%.300s] %d", "short", 7);
+     log_destroy();
+     
+     // 常数精度同样延迟格式化，文件中没有格式化后的文本
+     EXPECT_FALSE(log_file_contains("Fixed precision: [hell]"));
+     
+     std::string text = decode_binary_log(temp_log_filename);
+     EXPECT_THAT(text, ::testing::HasSubstr("Unterminated: [hello] [hel   ]\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Negative precision: [whole]\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Fixed precision: [hell] [      he]\n"));
+     EXPECT_THAT(text, ::testing::HasSubstr("Wide precision: [short] 7\n"));
+ }
+ 
+ // 测试飞行记录器记录带精度的字符串参数时不越界读取
+ TEST_F(LoggerTest, FlightRecorderStringPrecision) {
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.flight_recorder_size = 16 * 1024;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_WARN, LOG_MODE_NORMAL, &options));
+     
+     GuardedBuffer buf("hello", 5);
+     LOG_DEBUG("Recorded precision [%.*s]", 5, buf.get());
+     LOG_DEBUG("Recorded fixed [%.4s]", buf.get());
+     LOG_ERROR("Recorder precision error");
+     log_flush();
+     EXPECT_TRUE(log_file_contains("Recorded precision [hello]"));
+     EXPECT_TRUE(log_file_contains("Recorded fixed [hell]"));
+     EXPECT_TRUE(log_file_contains("Recorder precision error"));
+ }
+ 
+ // 用栈上构造的格式字符串写一条日志，返回前覆盖掉格式字符串
+ static void log_with_stack_format(int value) {
+     char fmt[64];
+     snprintf(fmt, sizeof(fmt), "Stack %s format %%d", "built");
+     LOG_DEBUG(fmt, value);
+     volatile char *p = fmt;
+     for (size_t i = 0; i + 1 < sizeof(fmt); i++) {
+         p[i] = 'x';
+     }
+ }
+ 
+ // 测试飞行记录器复制格式字符串，转储时不再读取调用者的缓冲区
+ TEST_F(LoggerTest, FlightRecorderStackFormat) {
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.flight_recorder_size = 16 * 1024;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_WARN, LOG_MODE_NORMAL, &options));
+     
+     log_with_stack_format(42);
+     // 放不下的格式只记录占位格式
+     std::string long_fmt(300, 'y');
+     LOG_DEBUG(long_fmt.c_str());
+     LOG_ERROR("Stack format error");
+     log_flush();
+     EXPECT_TRUE(log_file_contains("Stack built format 42\n"));
+     EXPECT_FALSE(log_file_contains("xxxx"));
+     EXPECT_TRUE(log_file_contains("(format too long)"));
+ }
+ 
+ // 测试二进制模式与异步模式组合，以及重新初始化后调用点编号的重新分配
+ TEST_F(LoggerTest, BinaryAsyncReinit) {
+     log_options_t options = {};
+     options.format = LOG_FORMAT_BINARY;
+     options.async = true;
+     
+     for (int round = 0; round < 2; round++) {
+         std::remove(temp_log_filename);
+         ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+         for (int i = 0; i < 100; i++) {
+             LOG_INFO("Async binary round %d record %d", round, i);
+         }
+         log_destroy();
+         
+         std::string text = decode_binary_log(temp_log_filename);
+         for (int i = 0; i < 100; i++) {
+             std::string line = "Async binary round " + std::to_string(round) + " record " + std::to_string(i) + "\n";
+             ASSERT_THAT(text, ::testing::HasSubstr(line));
+         }
+     }
+ }
+ 
+ // 测试刷新策略：缓冲的日志在满足策略条件或调用 log_flush 时才写出
+ TEST_F(LoggerTest, FlushPolicy) {
+     log_options_t options = {};
+     options.flush_policy = LOG_FLUSH_BYTES | LOG_FLUSH_ON_ERROR;
+     options.flush_bytes = 1 << 20;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     LOG_INFO("Buffered message");
+     EXPECT_FALSE(log_file_contains("Buffered message"));
+     
+     // ERROR级别立即写出，之前缓冲的日志一并写出
+     LOG_ERROR("Error message");
+     EXPECT_TRUE(log_file_contains("Buffered message"));
+     EXPECT_TRUE(log_file_contains("Error message"));
+     
+     LOG_INFO("Explicit flush");
+     EXPECT_FALSE(log_file_contains("Explicit flush"));
+     log_flush();
+     EXPECT_TRUE(log_file_contains("Explicit flush"));
+     
+     // 按时间间隔写出：没有新日志时由后台线程写出
+     options.flush_policy = LOG_FLUSH_INTERVAL;
+     options.flush_interval_ms = 50;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     LOG_INFO("Interval message");
+     for (int i = 0; i < 100 && !log_file_contains("Interval message"); i++) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+     }
+     EXPECT_TRUE(log_file_contains("Interval message"));
+     
+     // 异步模式下 log_flush 等待写线程写出
+     options.async = true;
+     options.flush_policy = LOG_FLUSH_BYTES;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     for (int i = 0; i < 100; i++) {
+         LOG_INFO("Async buffered %d", i);
+     }
+     log_flush();
+     EXPECT_TRUE(log_file_contains("Async buffered 99\n"));
+     
+     // 二进制格式默认批量写出，显式指定 LOG_FLUSH_RECORD 时每条立即写出
+     options = {};
+     options.no_stdout = true;
+     options.format = LOG_FORMAT_BINARY;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     size_t size = get_log_content().size();
+     LOG_INFO("Binary buffered %d", 1);
+     EXPECT_EQ(size, get_log_content().size());
+     
+     options.flush_policy = LOG_FLUSH_RECORD;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     size = get_log_content().size();
+     LOG_INFO("Binary record %d", 2);
+     EXPECT_GT(get_log_content().size(), size);
+ }
+ 
+ // 测试内存映射日志文件：多线程并发写入，跨越多个段，销毁后文件截断为实际长度
+ TEST_F(LoggerTest, MmapOutput) {
+     {
+         std::ofstream file(temp_log_filename);
+         file << "Existing content\n";
+     }
+     
+     log_options_t options = {};
+     options.mmap_file = true;
+     options.mmap_segment_size = 4096; // 使用很小的段，覆盖跨段写入的情况
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     const int THREAD_COUNT = 4;
+     const int LOGS_PER_THREAD = 200;
+     
+     std::vector<std::thread> threads;
+     for (int i = 0; i < THREAD_COUNT; i++) {
+         threads.emplace_back([i, LOGS_PER_THREAD]() {
+             for (int j = 0; j < LOGS_PER_THREAD; j++) {
+                 LOG_INFO("Mmap thread %d, log %d", i, j);
+             }
+         });
+     }
+     for (auto& t : threads) {
+         t.join();
+     }
+     
+     log_destroy();
+     
+     std::string content = get_log_content();
+     EXPECT_EQ(0u, content.find("Existing content\n"));
+     EXPECT_EQ(std::string::npos, content.find('\0'));
+     EXPECT_EQ('\n', content.back());
+     for (int i = 0; i < THREAD_COUNT; i++) {
+         for (int j = 0; j < LOGS_PER_THREAD; j++) {
+             std::string line = "Mmap thread " + std::to_string(i) + ", log " + std::to_string(j) + "\n";
+             ASSERT_TRUE(content.find(line) != std::string::npos) << line;
+         }
+     }
+     
+     // 二进制格式同样可以使用内存映射写出
+     std::remove(temp_log_filename);
+     options.format = LOG_FORMAT_BINARY;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     for (int i = 0; i < 500; i++) {
+         LOG_INFO("Binary mmap %d", i);
+     }
+     log_destroy();
+     EXPECT_NE(std::string::npos, decode_binary_log(temp_log_filename).find("Binary mmap 499\n"));
+ }
+ 
+ // 在子进程中限制文件大小，使第二段无法预分配，写满第一段后停止
+ static void mmap_write_until_failure(const char *filename) {
+     struct rlimit limit = { 96 * 1024, 96 * 1024 };
+     signal(SIGXFSZ, SIG_IGN);
+     if (setrlimit(RLIMIT_FSIZE, &limit) != 0) {
+         _exit(1);
+     }
+     log_mmap_t *map = log_mmap_open(filename, 64 * 1024);
+     if (!map) {
+         _exit(1);
+     }
+     char line[64];
+     int failed = 0;
+     for (int i = 0; i < 2000 && !failed; i++) {
+         int len = snprintf(line, sizeof(line), "Mmap record %04d padded to a longer line\n", i);
+         failed = log_mmap_write(map, line, (size_t)len) != 0;
+     }
+     log_mmap_close(map);
+     _exit(failed ? 0 : 1);
+ }
+ 
+ // 测试段映射失败时预留的区间被填充，文件中不留下'\0'
+ TEST_F(LoggerTest, MmapSegmentFailure) {
+     EXPECT_EXIT(mmap_write_until_failure(temp_log_filename), ::testing::ExitedWithCode(0), "");
+     
+     std::string content = get_log_content();
+     EXPECT_GT(content.size(), 64u * 1024);
+     EXPECT_EQ(std::string::npos, content.find('\0'));
+     EXPECT_EQ('\n', content.back());
+     EXPECT_EQ(0u, content.find("Mmap record 0000"));
+ }
+ 
+ // 测试日志轮转：按大小轮转并只保留指定个数的历史文件，按时间轮转
+ TEST_F(LoggerTest, Rotation) {
+     std::string base = temp_log_filename;
+     auto exists = [](const std::string& path) {
+         return access(path.c_str(), F_OK) == 0;
+     };
+     
+     log_options_t options = {};
+     options.rotate_size = 2048;
+     options.rotate_keep = 2;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     for (int i = 0; i < 500; i++) {
+         LOG_INFO("Rotation log %d", i);
+         if (i % 50 == 0) {
+             // 给后台线程时间预先打开下一个文件
+             std::this_thread::sleep_for(std::chrono::milliseconds(5));
+         }
+     }
+     log_destroy();
+     
+     EXPECT_TRUE(log_file_contains("Rotation log 499\n"));
+     EXPECT_TRUE(exists(base + ".1"));
+     EXPECT_TRUE(exists(base + ".2"));
+     EXPECT_FALSE(exists(base + ".3"));
+     EXPECT_FALSE(exists(base + ".next"));
+     
+     // 按时间轮转：跨过整秒边界后写入的日志进入新文件
+     std::remove((base + ".1").c_str());
+     std::remove((base + ".2").c_str());
+     std::remove(temp_log_filename);
+     options = {};
+     options.rotate_interval_sec = 1;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     LOG_INFO("Before interval");
+     std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+     LOG_INFO("After interval");
+     log_destroy();
+     
+     EXPECT_TRUE(log_file_contains("After interval"));
+     EXPECT_FALSE(log_file_contains("Before interval"));
+     EXPECT_TRUE(exists(base + ".1"));
+     std::remove((base + ".1").c_str());
+     
+     // 内存映射文件不支持轮转
+     options.mmap_file = true;
+     EXPECT_EQ(-1, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+ }
+ 
+ // 测试块压缩：日志文本能被有效压缩，随机数据原样存储，解压结果与原文一致
+ TEST(LogLzTest, RoundTrip) {
+     const char* raw_path = "test_lz_raw.txt";
+     const char* lz_path = "test_lz_raw.txt.lz";
+     std::string text;
+     for (int i = 0; i < 20000; i++) {
+         text += "2026-10-17 00:00:00." + std::to_string(i % 1000) +
+                 " [INFO] [src/server.c:128 handle_request] request " + std::to_string(i) +
+                 " served in " + std::to_string(i % 37) + " ms\n";
+     }
+     // 末尾追加一段不可压缩的随机数据
+     unsigned int seed = 12345;
+     for (int i = 0; i < 100000; i++) {
+         text += static_cast<char>(rand_r(&seed) & 0xff);
+     }
+     {
+         std::ofstream file(raw_path, std::ios::binary);
+         file << text;
+     }
+     
+     ASSERT_EQ(0, log_lz_compress_file(raw_path, lz_path));
+     std::ifstream lz_file(lz_path, std::ios::binary | std::ios::ate);
+     size_t lz_size = static_cast<size_t>(lz_file.tellg());
+     lz_file.close();
+     EXPECT_LT(lz_size, (text.size() - 100000) / 4 + 100000 + 1024);
+     
+     // 通过FILE接口边读边解压
+     FILE* in = log_lz_fopen(lz_path);
+     ASSERT_NE(nullptr, in);
+     std::string decoded;
+     char buffer[4096];
+     size_t n;
+     while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+         decoded.append(buffer, n);
+     }
+     fclose(in);
+     EXPECT_TRUE(decoded == text);
+     
+     // 损坏的数据应返回错误而不是越界
+     std::vector<unsigned char> comp(log_lz_bound(4096));
+     size_t comp_len = log_lz_compress(text.data(), 4096, comp.data(), comp.size());
+     ASSERT_GT(comp_len, 0u);
+     std::vector<unsigned char> out(4096);
+     EXPECT_EQ(4096, log_lz_decompress(comp.data(), comp_len, out.data(), out.size()));
+     EXPECT_EQ(-1, log_lz_decompress(comp.data(), comp_len, out.data(), 100));
+     for (size_t i = 0; i < comp_len; i += 7) {
+         comp[i] ^= 0x5a;
+     }
+     log_lz_decompress(comp.data(), comp_len, out.data(), out.size());
+     
+     std::remove(raw_path);
+     std::remove(lz_path);
+ }
+ 
+ // 测试轮转后压缩历史文件
+ TEST_F(LoggerTest, RotationCompress) {
+     std::string base = temp_log_filename;
+     log_options_t options = {};
+     options.rotate_size = 4096;
+     options.rotate_keep = 1;
+     options.rotate_compress = true;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     for (int i = 0; i < 60; i++) {
+         LOG_INFO("Compressed rotation log %d", i);
+     }
+     log_destroy();
+     
+     std::string lz_path = base + ".1" + LOG_LZ_SUFFIX;
+     FILE* in = log_lz_fopen(lz_path.c_str());
+     ASSERT_NE(nullptr, in);
+     std::string decoded;
+     char buffer[4096];
+     size_t n;
+     while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+         decoded.append(buffer, n);
+     }
+     fclose(in);
+     
+     EXPECT_NE(std::string::npos, decoded.find("Compressed rotation log 0\n"));
+     EXPECT_EQ(-1, access((base + ".1").c_str(), F_OK));
+     std::remove(lz_path.c_str());
+ }
+ 
+ // 测试压缩失败时未压缩的历史文件随轮转后移，不被下一次轮转覆盖
+ TEST_F(LoggerTest, RotationCompressFailure) {
+     std::string base = temp_log_filename;
+     std::string plain1 = base + ".1";
+     std::string plain2 = base + ".2";
+     std::string plain3 = base + ".3";
+     // 用目录占住 .lz 文件名：非空目录无法删除或被改名覆盖，每次压缩都会失败
+     std::vector<std::string> dirs;
+     for (int i = 1; i <= 3; i++) {
+         dirs.push_back(base + "." + std::to_string(i) + LOG_LZ_SUFFIX);
+         ASSERT_EQ(0, mkdir(dirs.back().c_str(), 0755));
+         if (i > 1) {
+             std::ofstream((dirs.back() + "/keep").c_str()) << "keep";
+         }
+     }
+     
+     log_options_t options = {};
+     options.no_stdout = true;
+     options.rotate_size = 4096;
+     options.rotate_keep = 3;
+     options.rotate_compress = true;
+     ASSERT_EQ(0, log_init_ex(temp_log_filename, LOG_LEVEL_DEBUG, LOG_MODE_NORMAL, &options));
+     
+     // 等第一次轮转完成、下一个文件就绪后再写，保证发生第二次轮转
+     std::string next = base + ".next";
+     for (int i = 0; i < 40; i++) {
+         LOG_INFO("Compress failure log %d", i);
+     }
+     for (int i = 0; i < 200 && (access(plain1.c_str(), F_OK) != 0 || access(next.c_str(), F_OK) != 0); i++) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+     }
+     for (int i = 40; i < 80; i++) {
+         LOG_INFO("Compress failure log %d", i);
+     }
+     log_destroy();
+     
+     // 两次以上轮转之后，所有日志仍分布在当前文件和未压缩的历史文件中
+     std::string content;
+     for (const std::string& path : { base, plain1, plain2, plain3 }) {
+         std::ifstream in(path);
+         std::stringstream ss;
+         ss << in.rdbuf();
+         content += ss.str();
+     }
+     EXPECT_EQ(0, access(plain2.c_str(), F_OK));
+     for (int i = 0; i < 80; i++) {
+         EXPECT_NE(std::string::npos, content.find("Compress failure log " + std::to_string(i) + "\n")) << i;
+     }
+     
+     std::remove(plain1.c_str());
+     std::remove(plain2.c_str());
+     std::remove(plain3.c_str());
+     for (const std::string& dir : dirs) {
+         std::remove((dir + "/keep").c_str());
+         rmdir(dir.c_str());
+     }
+ }
+ 
+ // 测试时间戳缓存：时钟应与墙上时间一致，秒数变化时缓存应正确更新
+ TEST(LogClockTest, CachedTimestamp) {
+     struct timespec now, real;
+     log_clock_now(&now);
+     clock_gettime(CLOCK_REALTIME, &real);
+     long long diff_ms = (real.tv_sec - now.tv_sec) * 1000LL + (real.tv_nsec - now.tv_nsec) / 1000000;
+     EXPECT_LT(std::llabs(diff_ms), 50);
+     
+     // 与 localtime + strftime 的结果逐秒对比
+     char expected[64], text[LOG_CLOCK_TEXT_LEN + 1], date[32];
+     struct timespec ts = real;
+     for (int i = 0; i < 3; i++) {
+         ts.tv_nsec = i * 250000000L + 7000000L;
+         struct tm tm_info;
+         localtime_r(&ts.tv_sec, &tm_info);
+         strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm_info);
+         snprintf(expected, sizeof(expected), "%s.%03ld", date, ts.tv_nsec / 1000000);
+         ASSERT_EQ(static_cast<size_t>(LOG_CLOCK_TEXT_LEN), log_clock_format(&ts, text));
+         EXPECT_STREQ(expected, text);
+         ts.tv_sec++;
+     }
+ }
+ 
+ // 时间索引测试用的一条日志
+ struct IndexRecord {
+     long long offset_ms;
+     int level;
+     std::string text;
+ };
+ 
+ // 生成以 2026-01-01 00:00:00 为起点、带少量乱序和多行日志的文本日志
+ static std::vector<IndexRecord> write_indexed_log(const char *filename, int count) {
+     static const char *names[] = { "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+     std::vector<IndexRecord> records;
+     std::ofstream out(filename, std::ios::binary);
+     char line[256];
+     
+     for (int i = 0; i < count; i++) {
+         long long ms = i * 10LL;
+         // 模拟多线程写出时时间戳较早的日志后写入
+         if (i % 7 == 3 && ms >= 200) {
+             ms -= 200;
+         }
+         int level = (i * 3) % 5;
+         int len = snprintf(line, sizeof(line), "2026-01-01 %02lld:%02lld:%02lld.%03lld [%s] [test.c:%d func] record %d\n",
+                            ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000, names[level], i % 100, i);
+         std::string text(line, len);
+         if (i % 50 == 0) {
+             text += "    continuation of record " + std::to_string(i) + "\n";
+         }
+         out << text;
+         records.push_back({ ms, level, text });
+     }
+     return records;
+ }
+ 
+ static void collect_record(const char *line, size_t len, void *arg) {
+     static_cast<std::string *>(arg)->append(line, len);
+ }
+ 
+ // 测试时间解析
+ TEST(LogIndexTest, ParseTime) {
+     long long a, b, c;
+     ASSERT_EQ(0, log_index_parse_time("1970-01-01 00:00:00", 19, &a));
+     EXPECT_EQ(0, a);
+     ASSERT_EQ(0, log_index_parse_time("2026-03-01 00:00:00.250", 23, &b));
+     ASSERT_EQ(0, log_index_parse_time("2026-02-28T23:59:59", 19, &c));
+     EXPECT_EQ(1250, b - c);
+     EXPECT_EQ(-1, log_index_parse_time("2026-13-01 00:00:00", 19, &a));
+     EXPECT_EQ(-1, log_index_parse_time("2026-01-01 00:00", 16, &a));
+     EXPECT_EQ(-1, log_index_parse_time("2026-01-01 00:00:00,123", 23, &a));
+ }
+ 
+ // 测试按时间范围和级别查询，与逐条比较的结果一致
+ TEST(LogIndexTest, RangeQuery) {
+     const char *filename = "test_index.log";
+     std::vector<IndexRecord> records = write_indexed_log(filename, 30000);
+     long long base;
+     ASSERT_EQ(0, log_index_parse_time("2026-01-01 00:00:00", 19, &base));
+     
+     log_index_t *idx = log_index_open(filename);
+     ASSERT_NE(nullptr, idx);
+     EXPECT_GT(log_index_entries(idx), 10u);
+     
+     const long long ranges[][2] = { { 0, 1000 }, { 123456, 150000 }, { 299000, 400000 }, { 55555, 55555 }, { 500000, 600000 } };
+     for (const auto &range : ranges) {
+         for (int min_level = LOG_LEVEL_DEBUG; min_level <= LOG_LEVEL_FATAL; min_level += 2) {
+             std::string expected, actual;
+             size_t expected_count = 0;
+             for (const auto &rec : records) {
+                 if (rec.offset_ms >= range[0] && rec.offset_ms <= range[1] && rec.level >= min_level) {
+                     expected += rec.text;
+                     expected_count++;
+                 }
+             }
+             size_t count = log_index_query(idx, base + range[0], base + range[1], (log_level_t)min_level,
+                                            collect_record, &actual);
+             EXPECT_EQ(expected_count, count) << range[0] << "-" << range[1] << " level " << min_level;
+             EXPECT_EQ(expected, actual) << range[0] << "-" << range[1] << " level " << min_level;
+         }
+     }
+     
+     log_index_close(idx);
+     remove(filename);
+ }
+ 
+ // 测试 JSON Lines 格式和空文件
+ TEST(LogIndexTest, JsonAndEmpty) {
+     const char *filename = "test_index.log";
+     std::string actual;
+     long long from, to;
+     {
+         std::ofstream out(filename);
+         out << "{\"time\":\"2026-01-01 10:00:00.000\",\"level\":\"INFO\",\"msg\":\"a\"}\n";
+         out << "{\"time\":\"2026-01-01 10:00:01.000\",\"level\":\"ERROR\",\"msg\":\"b\"}\n";
+         out << "{\"time\":\"2026-01-01 10:00:02.000\",\"level\":\"DEBUG\",\"msg\":\"c\"}\n";
+     }
+     ASSERT_EQ(0, log_index_parse_time("2026-01-01 10:00:00.500", 23, &from));
+     ASSERT_EQ(0, log_index_parse_time("2026-01-01 10:00:02.000", 23, &to));
+     
+     log_index_t *idx = log_index_open(filename);
+     ASSERT_NE(nullptr, idx);
+     EXPECT_EQ(2u, log_index_query(idx, from, to, LOG_LEVEL_DEBUG, collect_record, &actual));
+     EXPECT_THAT(actual, ::testing::HasSubstr("\"msg\":\"b\""));
+     EXPECT_THAT(actual, ::testing::HasSubstr("\"msg\":\"c\""));
+     actual.clear();
+     EXPECT_EQ(1u, log_index_query(idx, from, to, LOG_LEVEL_WARN, collect_record, &actual));
+     EXPECT_THAT(actual, ::testing::Not(::testing::HasSubstr("\"msg\":\"c\"")));
+     log_index_close(idx);
+     
+     { std::ofstream out(filename, std::ios::trunc); }
+     idx = log_index_open(filename);
+     ASSERT_NE(nullptr, idx);
+     EXPECT_EQ(0u, log_index_entries(idx));
+     EXPECT_EQ(0u, log_index_query(idx, from, to, LOG_LEVEL_DEBUG, collect_record, &actual));
+     log_index_close(idx);
+     remove(filename);
+     
+     EXPECT_EQ(nullptr, log_index_open("test_index_missing.log"));
+ }
+ 
  // 模拟时间函数，用于测试过滤器重置功能
  class FilterResetTest : public ::testing::Test {
  protected: